@@ -517,12 +517,18 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// decode JPEG images at 1/2, 1/4 or 1/8 of their size (shift 1, 2 or 3) by
+// running a reduced-size IDCT on every block; 0 decodes at full size. the
+// output size is the full size divided by 2^shift, rounded up
+STBIDEF void stbi_set_jpeg_scale_shift(int shift);
+
 // as above, but only applies to images loaded on the thread that calls the function
 // this function is only available if your compiler supports thread-local variables;
 // calling it will fail to link if your compiler doesn't
 STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpremultiply);
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
+STBIDEF void stbi_set_jpeg_scale_shift_thread(int shift);
 
 // ZLIB client - used by PNG, available for other purposes
 
@@ -1134,6 +1140,29 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+static int stbi__jpeg_scale_shift_global = 0;
+
+STBIDEF void stbi_set_jpeg_scale_shift(int shift)
+{
+   stbi__jpeg_scale_shift_global = shift;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_scale_shift  stbi__jpeg_scale_shift_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_scale_shift_local, stbi__jpeg_scale_shift_set;
+
+STBIDEF void stbi_set_jpeg_scale_shift_thread(int shift)
+{
+   stbi__jpeg_scale_shift_local = shift;
+   stbi__jpeg_scale_shift_set = 1;
+}
+
+#define stbi__jpeg_scale_shift  (stbi__jpeg_scale_shift_set        \
+                                 ? stbi__jpeg_scale_shift_local   \
+                                 : stbi__jpeg_scale_shift_global)
+#endif // STBI_THREAD_LOCAL
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1993,6 +2022,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift; // reduced-size decode, output blocks are (8 >> scale_shift) pixels wide
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2523,6 +2553,54 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced-size IDCT for scaled decoding: only the lowest n*n frequencies of
+// the block are used and transformed with an n-point IDCT, which gives the
+// block downscaled to n*n pixels (same idea as libjpeg's jidctred.c).
+// the tables hold c(u) * cos((2x+1)*u*pi/2n) / 2, c(0) = 1/sqrt(2)
+static const float stbi__idct4_table[4][4] = {
+   { 0.35355339f,  0.46193977f,  0.35355339f,  0.19134172f },
+   { 0.35355339f,  0.19134172f, -0.35355339f, -0.46193977f },
+   { 0.35355339f, -0.19134172f, -0.35355339f,  0.46193977f },
+   { 0.35355339f, -0.46193977f,  0.35355339f, -0.19134172f },
+};
+
+static const float stbi__idct2_table[2][2] = {
+   { 0.35355339f,  0.35355339f },
+   { 0.35355339f, -0.35355339f },
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], int n)
+{
+   int u,v,x,y;
+   float tmp[4][4];
+   const float *table = n == 4 ? &stbi__idct4_table[0][0] : &stbi__idct2_table[0][0];
+
+   if (n == 1) {
+      // DC only: the block average
+      out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+      return;
+   }
+
+   // rows: horizontal frequencies to pixels
+   for (v=0; v < n; ++v) {
+      for (x=0; x < n; ++x) {
+         float sum = 0;
+         for (u=0; u < n; ++u)
+            sum += table[x*n+u] * data[v*8+u];
+         tmp[v][x] = sum;
+      }
+   }
+   // columns: vertical frequencies to pixels, then level shift
+   for (y=0; y < n; ++y, out += out_stride) {
+      for (x=0; x < n; ++x) {
+         float sum = 128.5f;
+         for (v=0; v < n; ++v)
+            sum += table[y*n+v] * tmp[v][x];
+         out[x] = stbi__clamp(sum > 0 ? (int) sum : 0);
+      }
+   }
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2946,6 +3024,19 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// transforms the block at pixel (x,y) of component n into its data plane;
+// with a scale shift the plane and the block are smaller by 2^scale_shift
+static void stbi__jpeg_idct(stbi__jpeg *z, int n, int x, int y, short data[64])
+{
+   int shift = z->scale_shift;
+   int stride = z->img_comp[n].w2 >> shift;
+   stbi_uc *out = z->img_comp[n].data + stride*(y >> shift) + (x >> shift);
+   if (shift == 0)
+      z->idct_block_kernel(out, stride, data);
+   else
+      stbi__idct_reduced(out, stride, data, 8 >> shift);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2964,7 +3055,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i*8, j*8, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2992,7 +3083,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_idct(z, n, x2, y2, data);
                      }
                   }
                }
@@ -3089,7 +3180,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i*8, j*8, data);
             }
          }
       }
@@ -3334,7 +3425,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      // scaled decoding only stores the reduced blocks
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2 >> z->scale_shift, z->img_comp[i].h2 >> z->scale_shift, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3873,6 +3965,19 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // scaled decoding: from here on the image is the reduced one
+   if (z->scale_shift) {
+      int k, shift = z->scale_shift;
+      z->s->img_x = (z->s->img_x + (1 << shift) - 1) >> shift;
+      z->s->img_y = (z->s->img_y + (1 << shift) - 1) >> shift;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].x = (z->s->img_x * z->img_comp[k].h + z->img_h_max-1) / z->img_h_max;
+         z->img_comp[k].y = (z->s->img_y * z->img_comp[k].v + z->img_v_max-1) / z->img_v_max;
+         z->img_comp[k].w2 >>= shift;
+         z->img_comp[k].h2 >>= shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -4033,6 +4138,8 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    memset(j, 0, sizeof(stbi__jpeg));
    STBI_NOTUSED(ri);
    j->s = s;
+   j->scale_shift = stbi__jpeg_scale_shift;
+   if (j->scale_shift < 0 || j->scale_shift > 3) j->scale_shift = 0;
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
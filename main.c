@@ -7,34 +7,58 @@
  * - Median filter
  * - Image rotation
  * - Gaussian blur
- * - Bicubic resizing
+ * - Resizing (box, triangle, bicubic or Lanczos3 filter) by scale or to a target box
+ * - Thumbnail ladders (several sizes from one decode)
  * - Edge detection
  * - Sharpening
  * - Grayscale conversion
  * - Histogram equalization
+ * - Contrast-limited adaptive histogram equalization
+ * - Point operations (gamma, levels, contrast, threshold, invert)
+ * - Affine and perspective warp
+ * - Lens correction and warp maps applied with precomputed remap tables
  */
 
 #include "src/functions.h"
 
 /**
- * @brief Main function for image processing application
- * @param argc Argument count
- * @param argv Argument vector
- * @return 0 on success, -1 on error
- * 
- * @details Command syntax:
- * Basic: ./program input_path mode output_path
- * With 1 parameter: ./program input_path mode value output_path
- * With 2 parameters: ./program input_path mode val1 val2 output_path
+ * @brief Checks whether the file name of a path has the .map extension
+ * @note Like the output formats, only the last extension of the file name
+ *       counts: "maps/out.png" and "out.map.png" are not maps.
  */
-int main(int argc, char* argv[]) {
-    // Validate argument count (3-6 arguments expected)
-    if(argc < 3 || argc > 6)
+static int is_map_path(const char* path)
+{
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    const char* backslash = strrchr(path, '\\');
+    return dot && (!slash || slash < dot) && (!backslash || backslash < dot) && strcmp(dot + 1, "map") == 0;
+}
+
+/**
+ * @brief Runs one command on one image
+ * @param argc Argument count (already checked for the command)
+ * @param argv Arguments as given to main(), encoder options removed
+ * @return 0 on success, non-zero on error (the error is printed)
+ */
+static int run_command(int argc, char* argv[])
+{
+    if (strcmp(argv[2], "-warp") == 0)
     {
-        printf("Invalid command format!\n");
-        return -1;
+        // Rows of the forward matrix, the last row defaults to 0 0 1 (affine)
+        double matrix[9] = {0, 0, 0, 0, 0, 0, 0, 0, 1};
+        for (int i = 0; i < argc - 7; i++)
+        {
+            matrix[i] = atof(argv[6 + i]);
+        }
+
+        // A .map output saves the transform for -remap instead of applying it
+        if (is_map_path(argv[argc - 1]))
+        {
+            return warp_map(argv[1], argv[argc - 1], matrix, atoi(argv[4]), atoi(argv[5]));
+        }
+        return warp_image(argv[1], argv[argc - 1], matrix, atoi(argv[4]), atoi(argv[5]), atoi(argv[3]));
     }
-    
+
     // Extract required arguments
     char* input_path = argv[1];  // Input image file path
     char* mode = argv[2];       // Processing mode flag
@@ -42,6 +66,10 @@ int main(int argc, char* argv[]) {
     // Result flag (0 indicates success)
     int res = 1;
 
+    // -rotate_shear takes the same parameters as -rotate but uses three shears
+    int rotate_mode = strcmp(mode, "-rotate") == 0 || strcmp(mode, "-rotate_shear") == 0;
+    int rotate_method = strcmp(mode, "-rotate_shear") == 0 ? ROTATE_SHEAR : ROTATE_DIRECT;
+
     // Handle commands with 1 numeric parameter (4 total args)
     if (argc == 5)
     {
@@ -53,10 +81,25 @@ int main(int argc, char* argv[]) {
             // Apply median filter with window size = val
             res = median_filter(input_path, output_path, (int)val);
         }
-        else if (strcmp(mode, "-rotate") == 0)
+        else if (rotate_mode)
+        {
+            // Rotate image by val degrees with bilinear interpolation
+            res = rotate_image(input_path, output_path, val, INTERP_BILINEAR, NULL, rotate_method);
+        }
+        else if (strcmp(mode, "-point") == 0)
+        {
+            // Apply chain of point operations given as text
+            res = point_operations(input_path, output_path, argv[3]);
+        }
+        else if (strcmp(mode, "-resize") == 0)
+        {
+            // Resize to target box argv[3] ("WxH[:fit|:fill|:exact]"), bicubic filter
+            res = resize_to_box(input_path, output_path, argv[3], FILTER_CATMULL_ROM);
+        }
+        else if (strcmp(mode, "-thumbs") == 0)
         {
-            // Rotate image by val degrees
-            res = rotate_image(input_path, output_path, val);
+            // Save every size of the list argv[3] ("WxH[:mode],..."), bicubic filter
+            res = thumbnail_ladder(input_path, output_path, argv[3], FILTER_CATMULL_ROM, 1);
         }
         else
         {
@@ -75,10 +118,73 @@ int main(int argc, char* argv[]) {
             // Apply Gaussian blur with kernel size=val1, sigma=val2
             res = gaussian_blur(input_path, output_path, (int)val1, val2);
         }
+        else if((strcmp(mode, "-resize") == 0 || strcmp(mode, "-thumbs") == 0) && parse_filter(argv[4]) >= 0)
+        {
+            // Resize to box(es) argv[3] with filter argv[4]
+            if (strcmp(mode, "-resize") == 0)
+            {
+                res = resize_to_box(input_path, output_path, argv[3], parse_filter(argv[4]));
+            }
+            else
+            {
+                res = thumbnail_ladder(input_path, output_path, argv[3], parse_filter(argv[4]), 1);
+            }
+        }
         else if(strcmp(mode, "-resize") == 0)
         {
-            // Resize image with scale factors val1(x), val2(y)
-            res = resize_bicubic(input_path, output_path, val1, val2);
+            // Resize image with scale factors val1(x), val2(y), bicubic filter
+            res = resize_image(input_path, output_path, val1, val2, FILTER_CATMULL_ROM);
+        }
+        else if(rotate_mode)
+        {
+            // Rotate image by val1 degrees, val2 selects interpolation
+            // (0 - nearest, 1 - bilinear, 2 - bicubic)
+            res = rotate_image(input_path, output_path, val1, (int)val2, NULL, rotate_method);
+        }
+        else if(strcmp(mode, "-clahe") == 0)
+        {
+            // Apply CLAHE with val1 x val1 tiles and clip limit val2
+            res = clahe_equ(input_path, output_path, (int)val1, val2);
+        }
+        else if(strcmp(mode, "-lensmap") == 0)
+        {
+            // Save lens correction map with coefficients k1=val1, k2=val2
+            // for images of the input size
+            res = lens_map(input_path, output_path, val1, val2);
+        }
+        else if(strcmp(mode, "-remap") == 0)
+        {
+            // Apply map file argv[3] with interpolation val2
+            res = remap_image(input_path, output_path, argv[3], (int)val2);
+        }
+        else
+        {
+            printf("Invalid command!\n");
+        }
+    }
+    // Handle commands with 3 parameters (6 total args)
+    else if (argc == 7)
+    {
+        char* output_path = argv[6]; // Output file path
+
+        if (rotate_mode)
+        {
+            // Rotate by argv[3] degrees with interpolation argv[4] on a canvas
+            // fitting the whole result, background argv[5] (color or "transparent")
+            res = rotate_image(input_path, output_path, atof(argv[3]), atoi(argv[4]), argv[5], rotate_method);
+        }
+        else if (strcmp(mode, "-resize") == 0)
+        {
+            // Resize with scale factors argv[3](x), argv[4](y) and filter argv[5]
+            int filter = parse_filter(argv[5]);
+            if (filter < 0)
+            {
+                printf("Error: Unknown filter! Use box, triangle, bicubic or lanczos3\n");
+            }
+            else
+            {
+                res = resize_image(input_path, output_path, atof(argv[3]), atof(argv[4]), filter);
+            }
         }
         else
         {
@@ -120,6 +226,72 @@ int main(int argc, char* argv[]) {
         printf("Invalid command format!\n");
     }
 
+    return res;
+}
+
+/**
+ * @brief Main function for image processing application
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @return 0 on success, -1 on error
+ * 
+ * @details Command syntax:
+ * Basic: ./program input_path mode output_path
+ * With 1 parameter: ./program input_path mode value output_path
+ * With 2 parameters: ./program input_path mode val1 val2 output_path
+ * With 3 parameters: ./program input_path mode val1 val2 val3 output_path
+ * Warp: ./program input_path -warp interpolation width height m00 m01 m02 m10 m11 m12 [m20 m21 m22] output_path
+ * Encoder options (--quality=N, --subsampling=420|444|auto, --png-level=N)
+ * may appear anywhere and apply to the saved image
+ * "-" as input_path reads the image from stdin, "-" as output_path writes it
+ * to stdout in the format given with --format=png|jpg|qoi|pnm|... (messages
+ * then go to stderr)
+ * Batch: a directory as input_path runs the command on every image in it,
+ * output_path is then a directory (created if missing) that receives the
+ * results under the input names (extension changed by --format)
+ */
+int main(int argc, char* argv[]) {
+    // Take encoder options out of the argument list, the rest keeps its positions
+    int count = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (i > 0 && strncmp(argv[i], "--", 2) == 0)
+        {
+            if (parse_write_option(argv[i]) != 0)
+            {
+                return -1;
+            }
+            continue;
+        }
+        argv[count++] = argv[i];
+    }
+    argc = count;
+
+    // Warp takes a 2x3 or 3x3 matrix, so it has its own argument counts
+    int warp = argc >= 3 && strcmp(argv[2], "-warp") == 0;
+    if (warp ? argc != 13 && argc != 16 : argc < 3 || argc > 7)
+    {
+        printf("Invalid command format!\n");
+        return -1;
+    }
+
+    int res;
+    if (argc >= 4 && is_directory(argv[1]))
+    {
+        // A directory as input runs the command on every image in it
+        res = batch_run(argc, argv, run_command);
+    }
+    else
+    {
+        // Image data on stdout must not mix with messages, those go to stderr from now on
+        if (strcmp(argv[argc - 1], "-") == 0 && !image_stdout())
+        {
+            printf("Error: Cannot write to stdout!\n");
+            return -1;
+        }
+        res = run_command(argc, argv);
+    }
+
     // Output final status message
     if(res == 0)
     {
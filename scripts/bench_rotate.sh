@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Переход в директорию проекта (на уровень выше скрипта)
+cd "$(dirname "$0")/.."
+
+# Сравнение прямого поворота (-rotate) и поворота тремя сдвигами (-rotate_shear)
+# Использование: scripts/bench_rotate.sh [входное изображение] [угол]
+INPUT=${1:-inputs/snow.jpg}
+ANGLE=${2:-30}
+OUT_DIR=$(mktemp -d)
+TIMEFORMAT="%R s"
+
+for INTERP in 0 1 2; do
+    for MODE in -rotate -rotate_shear; do
+        echo -n "$MODE interpolation $INTERP: "
+        time ./imgproc.exe "$INPUT" $MODE "$ANGLE" $INTERP 000000 "$OUT_DIR/bench.png" > /dev/null
+    done
+done
+
+rm -rf "$OUT_DIR"
@@ -14,7 +14,25 @@ gcc -o imgproc.exe ^
     src\histogram.c ^
     src\rotation.c ^
     src\resize.c ^
-    -Iinclude
+    src\clahe.c ^
+    src\lut.c ^
+    src\warp.c ^
+    src\remap.c ^
+    src\image_loader.c ^
+    src\thumbnails.c ^
+    src\image_writer.c ^
+    src\png_writer.c ^
+    src\jpeg_writer.c ^
+    src\qoi.c ^
+    src\raw_image.c ^
+    src\file_mapping.c ^
+    src\pnm.c ^
+    src\std_streams.c ^
+    src\prefetch.c ^
+    src\batch.c ^
+    -Iinclude ^
+    -fopenmp ^
+    -lm
 
 REM Проверка успешности компиляции
 if %errorlevel% equ 0 (
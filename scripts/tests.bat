@@ -7,6 +7,22 @@ REM Проверка resize
 imgproc inputs/snow.jpg -resize 0.5 0.5 tests/resize_0.png
 imgproc inputs/forestcat.jpg -resize 2 2 tests/resize_1.png
 imgproc inputs/pole.jpg -resize 6 1 tests/resize_2.jpg
+imgproc inputs/town.jpg -resize 0.1 0.1 lanczos3 tests/resize_3.png
+imgproc inputs/snow.jpg -resize 0.2 0.2 box tests/resize_4.png
+imgproc inputs/town.jpg -resize 500x500:fill tests/resize_5.png
+imgproc inputs/train.jpg -resize 300 lanczos3 tests/resize_6.jpg
+imgproc --quality=75 inputs/snow.jpg -resize 0.5 0.5 tests/resize_7.jpg
+imgproc inputs/town.jpg -resize 0.5 0.5 --subsampling=444 tests/resize_8.JPEG
+imgproc inputs/forestcat.jpg -resize 0.25 0.25 tests/resize_9.bmp
+imgproc inputs/bnw1.jpg -resize 0.5 0.5 --png-level=9 tests/resize_10.png
+imgproc --png-level=1 inputs/town.jpg -resize 1 1 tests/resize_11.png
+imgproc --png-level=3 inputs/bnw1.jpg -resize 4 4 tests/resize_12.png
+imgproc --quality=95 inputs/train.jpg -resize 2 2 tests/resize_13.jpg
+imgproc inputs/bnw0.png -resize 0.25 0.25 box tests/resize_14.png
+imgproc inputs/snp1.png -resize 256x256 tests/resize_15.png
+
+REM проверка thumbnails
+imgproc inputs/town.jpg -thumbs 1024,512x512:fill,256,128x128:fill,64 tests/thumb.jpg
 
 REM проверка median filter
 imgproc inputs/snp0.jpg -median 3 tests/median_0.jpg
@@ -22,6 +38,11 @@ REM проверка rotation
 imgproc inputs/birb.jfif -rotate 45 tests/rotate_0.png
 imgproc inputs/pole.jpg -rotate 90 tests/rotate_1.png
 imgproc inputs/cats_.jfif -rotate 270 tests/rotate_2.png
+imgproc inputs/town.jpg -rotate 30 2 tests/rotate_3.png
+imgproc inputs/birb.jfif -rotate 45 1 transparent tests/rotate_4.png
+imgproc inputs/train.jpg -rotate -20 2 FFFFFF tests/rotate_5.jpg
+imgproc inputs/town.jpg -rotate_shear 30 2 tests/rotate_6.png
+imgproc inputs/birb.jfif -rotate_shear 45 1 transparent tests/rotate_7.png
 
 REM проверка grayscale conversion
 imgproc inputs/town.jpg -gray tests/gray_0.png
@@ -36,6 +57,27 @@ imgproc inputs/bnw0.png -hist tests/hist_0.png
 imgproc inputs/bnw1.jpg -hist tests/hist_1.png
 imgproc inputs/bnw2.jfif -hist tests/hist_2.png
 
+REM проверка CLAHE
+imgproc inputs/bnw0.png -clahe 8 2 tests/clahe_0.png
+imgproc inputs/bnw3.jpg -clahe 8 3 tests/clahe_1.png
+imgproc inputs/town.jpg -clahe 4 2 tests/clahe_2.jpg
+
+REM проверка point operations
+imgproc inputs/forest.jpg -point gamma:2.2 tests/point_0.png
+imgproc inputs/bnw1.jpg -point levels:30:220,contrast:1.5,invert tests/point_1.png
+imgproc inputs/bnw2.jfif -point equalize,threshold:128 tests/point_2.png
+
+REM проверка warp
+imgproc inputs/town.jpg -warp 1 0 0 0.7 0.3 -20 -0.3 0.7 80 tests/warp_0.png
+imgproc inputs/forestcat.jpg -warp 2 400 300 0.5 0 0 0 0.5 0 tests/warp_1.png
+imgproc inputs/train.jpg -warp 1 0 0 1 0.2 0 0 1 0 0.0005 0 1 tests/warp_2.png
+
+REM проверка remap
+imgproc inputs/town.jpg -lensmap -0.2 0.05 tests/lens.map
+imgproc inputs/town.jpg -remap tests/lens.map 2 tests/remap_0.png
+imgproc inputs/train.jpg -warp 1 0 0 1 0.2 0 0 1 0 0.0005 0 1 tests/warp.map
+imgproc inputs/train.jpg -remap tests/warp.map 1 tests/remap_1.png
+
 REM проверка Edge detection(просто на фото)
 imgproc inputs/town.jpg -edge tests/edge_0.png
 imgproc inputs/bnw3.jpg -edge tests/edge_1.png
@@ -52,3 +94,15 @@ imgproc tests/hist_4.png -edge tests/edge_hist_1.png
 
 imgproc inputs/snow.jpg -hist tests/hist_4.png
 imgproc tests/hist_4.png -edge tests/edge_hist_2.png
+
+imgproc inputs/forestcat.jpg -hist tests/hist_5.qoi
+imgproc tests/hist_5.qoi -edge tests/edge_hist_3.png
+imgproc inputs/snow.jpg -rotate 30 0 transparent tests/rotate_qoi.qoi
+imgproc tests/rotate_qoi.qoi -resize 0.5 0.5 tests/rotate_qoi.png
+imgproc inputs/train.jpg -hist tests/hist_6.raw
+imgproc tests/hist_6.raw -edge tests/edge_hist_4.png
+imgproc inputs/snow.jpg -gray tests/gray_pnm.pgm
+imgproc tests/gray_pnm.pgm -edge tests/edge_pnm.pam
+imgproc inputs/town.jpg -gray - --format=ppm > tests/gray_pipe.ppm
+imgproc - -edge tests/edge_pipe.png < tests/gray_pipe.ppm
+imgproc inputs -resize 256x256 tests/batch --format=jpg
@@ -0,0 +1,323 @@
+/**
+ * @file batch.c
+ * @brief Implementation of batch mode: one command run on every image of a directory
+ *
+ * @details The files go through a pipeline. A few workers each run the whole
+ *          command on one file, so while one of them decodes file i + 1,
+ *          another processes file i and a third encodes file i - 1; the
+ *          filters and encoders inside use nested OpenMP threads as usual.
+ *          Next to the workers the prefetcher reads the following files from
+ *          disk (see prefetch.c), and the decoder takes their bytes from
+ *          memory. Files are taken in name order, results keep their names.
+ */
+#include "functions.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <omp.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#define BATCH_PIPELINE_DEPTH 3 ///< Files in flight: decoding, processing, encoding
+#define BATCH_PREFETCH_FILES 4 ///< Files read ahead of the workers
+#define BATCH_MAX_ARGS 16      ///< Longest command (-warp with a 3x3 matrix)
+
+/// Extensions of the files a batch picks up: everything the loader reads
+static const char* const input_extensions[] = {"jpg", "jpeg", "jfif", "png", "bmp", "tga", "gif", "psd", "hdr",
+                                               "pic", "pbm", "pgm", "ppm", "pnm", "pam", "qoi", "raw"};
+
+/**
+ * @brief Checks whether a path names a directory
+ * @param path Path
+ * @return Non-zero for a directory
+ */
+int is_directory(const char* path)
+{
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/**
+ * @brief Checks whether a file name has the extension of a readable image
+ */
+static int is_image_name(const char* name)
+{
+    const char* dot = strrchr(name, '.');
+    if (!dot || dot == name)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(input_extensions) / sizeof(input_extensions[0]); i++)
+    {
+        const char* a = dot + 1;
+        const char* b = input_extensions[i];
+        while (*a && tolower((unsigned char)*a) == *b)
+        {
+            a++;
+            b++;
+        }
+        if (!*a && !*b)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * @brief Lists the images of a directory in name order
+ * @param directory Directory path
+ * @param count Output: number of names
+ * @return Names released with free_names(), NULL if the directory cannot be
+ *         read or memory allocation fails
+ */
+static char** list_images(const char* directory, int* count)
+{
+    DIR* dir = opendir(directory);
+    if (!dir)
+    {
+        return NULL;
+    }
+    char** names = NULL;
+    int used = 0, capacity = 0;
+    int ok = 1;
+    struct dirent* entry;
+    while (ok && (entry = readdir(dir)) != NULL)
+    {
+        if (!is_image_name(entry->d_name))
+        {
+            continue;
+        }
+        if (used == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            char** grown = (char**)realloc(names, capacity * sizeof(char*));
+            if (!grown)
+            {
+                ok = 0;
+                break;
+            }
+            names = grown;
+        }
+        size_t length = strlen(entry->d_name) + 1;
+        names[used] = (char*)malloc(length);
+        ok = names[used] != NULL;
+        if (ok)
+        {
+            memcpy(names[used++], entry->d_name, length);
+        }
+    }
+    closedir(dir);
+
+    if (!ok)
+    {
+        for (int i = 0; i < used; i++)
+        {
+            free(names[i]);
+        }
+        free(names);
+        return NULL;
+    }
+    if (used > 1)
+    {
+        qsort(names, used, sizeof(char*), compare_names);
+    }
+    *count = used;
+    return names ? names : (char**)calloc(1, sizeof(char*));
+}
+
+/**
+ * @brief Releases a list of strings and the strings in it
+ */
+static void free_names(char** names, int count)
+{
+    for (int i = 0; names && i < count; i++)
+    {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/**
+ * @brief Builds the path of a file in a directory
+ * @param directory Directory path
+ * @param name File name
+ * @param extension New extension without the dot, NULL or empty to keep the name's
+ * @return Path released with free(), NULL if memory allocation fails
+ */
+static char* join_path(const char* directory, const char* name, const char* extension)
+{
+    size_t dir_length = strlen(directory);
+    size_t name_length = strlen(name);
+    if (extension && *extension)
+    {
+        // is_image_name() has checked there is an extension
+        name_length = (size_t)(strrchr(name, '.') - name);
+    }
+    size_t extension_length = extension && *extension ? strlen(extension) + 1 : 0;
+    int separator = dir_length > 0 && directory[dir_length - 1] != '/' && directory[dir_length - 1] != '\\';
+
+    char* path = (char*)malloc(dir_length + separator + name_length + extension_length + 1);
+    if (!path)
+    {
+        return NULL;
+    }
+    char* p = path;
+    memcpy(p, directory, dir_length);
+    p += dir_length;
+    if (separator)
+    {
+        *p++ = '/';
+    }
+    memcpy(p, name, name_length);
+    p += name_length;
+    if (extension_length)
+    {
+        *p++ = '.';
+        memcpy(p, extension, extension_length - 1);
+        p += extension_length - 1;
+    }
+    *p = '\0';
+    return path;
+}
+
+/**
+ * @brief Creates a directory unless it exists
+ * @return 0 on success, -1 on error
+ */
+static int make_directory(const char* path)
+{
+    if (is_directory(path))
+    {
+        return 0;
+    }
+#ifdef _WIN32
+    return _mkdir(path) == 0 ? 0 : -1;
+#else
+    return mkdir(path, 0777) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Runs a command on every image of a directory
+ * @param argc Argument count
+ * @param argv Arguments of one command, argv[1] is the input directory and
+ *             argv[argc - 1] the output directory
+ * @param command Function running the command on one file
+ * @return 0 if every file was processed, -1 otherwise (errors are printed)
+ *
+ * @details The output directory is created if missing. Results are saved
+ *          under the input names, with the extension set by --format if
+ *          given (.png for input formats that cannot be written). A file that
+ *          fails does not stop the others.
+ */
+int batch_run(int argc, char* argv[], batch_command command)
+{
+    const char* input_dir = argv[1];
+    const char* output_dir = argv[argc - 1];
+    if (argc > BATCH_MAX_ARGS || strcmp(output_dir, "-") == 0)
+    {
+        printf("Error: Batch output must be a directory!\n");
+        return -1;
+    }
+    if (make_directory(output_dir) != 0)
+    {
+        printf("Error: Cannot create directory %s!\n", output_dir);
+        return -1;
+    }
+
+    int count = 0;
+    char** names = list_images(input_dir, &count);
+    if (!names)
+    {
+        printf("Error: Cannot read directory %s!\n", input_dir);
+        return -1;
+    }
+    if (count == 0)
+    {
+        printf("Error: No images in %s!\n", input_dir);
+        free_names(names, count);
+        return -1;
+    }
+
+    char** inputs = (char**)calloc(count, sizeof(char*));
+    char** outputs = (char**)calloc(count, sizeof(char*));
+    int ok = inputs && outputs;
+    for (int i = 0; ok && i < count; i++)
+    {
+        inputs[i] = join_path(input_dir, names[i], NULL);
+        outputs[i] = join_path(output_dir, names[i], output_format());
+        if (outputs[i] && !has_output_format(outputs[i]))
+        {
+            // Formats that are only read (.gif, .psd, .jfif, ...) are saved as PNG
+            free(outputs[i]);
+            outputs[i] = join_path(output_dir, names[i], "png");
+        }
+        ok = inputs[i] && outputs[i];
+    }
+    prefetch_queue queue;
+    if (!ok || prefetch_open(&queue, inputs, count, BATCH_PREFETCH_FILES) != 0)
+    {
+        printf("Error: Memory allocation failed!\n");
+        free_names(inputs, count);
+        free_names(outputs, count);
+        free_names(names, count);
+        return -1;
+    }
+
+    // The workers are the first level of threads, the filters inside them the second
+    int levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(levels > 2 ? levels : 2);
+
+    int failed = 0;
+    #pragma omp parallel num_threads(queue.readers + BATCH_PIPELINE_DEPTH)
+    {
+        // A team cut short (OMP_THREAD_LIMIT) has no readers, the workers read the files themselves
+        int readers = omp_get_num_threads() > queue.readers ? queue.readers : 0;
+        if (omp_get_thread_num() < readers)
+        {
+            prefetch_run(&queue);
+        }
+        else
+        {
+            char* args[BATCH_MAX_ARGS];
+            int i;
+            while ((i = prefetch_next(&queue)) >= 0)
+            {
+                size_t size = 0;
+                unsigned char* data = prefetch_take(&queue, i, &size);
+                use_prefetched_input(data ? inputs[i] : NULL, data, size);
+
+                memcpy(args, argv, argc * sizeof(char*));
+                args[1] = inputs[i];
+                args[argc - 1] = outputs[i];
+                if (command(argc, args) != 0)
+                {
+                    printf("Error: Processing %s failed!\n", inputs[i]);
+                    #pragma omp atomic
+                    failed++;
+                }
+
+                use_prefetched_input(NULL, NULL, 0);
+                free(data);
+            }
+        }
+    }
+
+    omp_set_max_active_levels(levels);
+    printf("%d of %d images processed\n", count - failed, count);
+
+    prefetch_close(&queue);
+    free_names(inputs, count);
+    free_names(outputs, count);
+    free_names(names, count);
+    return failed ? -1 : 0;
+}
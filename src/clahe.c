@@ -0,0 +1,267 @@
+/**
+ * @file clahe.c
+ * @brief Implementation of contrast-limited adaptive histogram equalization
+ */
+#include "functions.h"
+
+/**
+ * @brief Builds equalization lookup tables for one row of tiles
+ * @param image Image data (intensity is taken from the first channel)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param tile_w Tile width in pixels
+ * @param tile_h Tile height in pixels
+ * @param tiles_x Number of tiles along the x axis
+ * @param ty Index of the tile row
+ * @param clip Clip limit as a multiple of the average bin count
+ * @param luts Output tables, tiles_x * 256 entries
+ *
+ * @details For every tile of the row:
+ * 1. Computes the intensity histogram of the tile
+ * 2. Clips bins above the limit and redistributes the excess evenly
+ * 3. Turns the cumulative histogram into a 0..255 mapping
+ *
+ * @note Tiles are independent, so they are processed in parallel
+ */
+static void build_tile_row_luts(const unsigned char* image, int width, int height, int channels,
+                                int tile_w, int tile_h, int tiles_x, int ty, double clip,
+                                unsigned char* luts)
+{
+    int y_start = ty * tile_h;
+    int y_end = y_start + tile_h < height ? y_start + tile_h : height;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tx = 0; tx < tiles_x; tx++)
+    {
+        int x_start = tx * tile_w;
+        int x_end = x_start + tile_w < width ? x_start + tile_w : width;
+        size_t histogram[256] = {0};
+
+        // Count intensities inside the tile
+        for (int y = y_start; y < y_end; y++)
+        {
+            const unsigned char* row = image + ((size_t)y * width + x_start) * channels;
+            for (int x = x_start; x < x_end; x++)
+            {
+                histogram[*row]++;
+                row += channels;
+            }
+        }
+
+        // Clip the histogram and redistribute the excess over all bins
+        size_t pixels = (size_t)(x_end - x_start) * (size_t)(y_end - y_start);
+        size_t limit = (size_t)(clip * pixels / 256.0);
+        if (limit < 1)
+        {
+            limit = 1;
+        }
+
+        size_t excess = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            if (histogram[i] > limit)
+            {
+                excess += histogram[i] - limit;
+                histogram[i] = limit;
+            }
+        }
+
+        size_t increment = excess / 256;
+        size_t remainder = excess % 256;
+        for (int i = 0; i < 256; i++)
+        {
+            histogram[i] += increment;
+        }
+        // Spread the remainder with a uniform step so no intensity range is favoured
+        if (remainder > 0)
+        {
+            size_t step = 256 / remainder;
+            for (size_t i = 0; i < 256 && remainder > 0; i += step, remainder--)
+            {
+                histogram[i]++;
+            }
+        }
+
+        // Convert the cumulative histogram into a lookup table
+        unsigned char* lut = luts + tx * 256;
+        unsigned long long cdf = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            cdf += histogram[i];
+            unsigned long long value = (cdf * 255 + pixels / 2) / pixels;
+            lut[i] = (unsigned char)(value > 255 ? 255 : value);
+        }
+    }
+}
+
+/**
+ * @brief Performs contrast-limited adaptive histogram equalization (CLAHE)
+ * @param input_path Path to the input image file
+ * @param output_path Path to save the processed image
+ * @param tiles Number of tiles along each axis
+ * @param clip Clip limit as a multiple of the average histogram bin count
+ * @return 0 on success, -1 on error
+ *
+ * @details This function:
+ *          1. Loads the input image and converts color images to grayscale
+ *          2. Splits the image into tiles x tiles regions
+ *          3. Builds a clipped equalization table for every tile
+ *          4. Maps every pixel by bilinear interpolation between the tables
+ *             of the four nearest tile centers
+ *          5. Saves the result image
+ *
+ * @note The image is processed in bands lying between two rows of tile centers.
+ *       Only the tables of those two tile rows are kept, so working memory stays
+ *       proportional to the image width, not to the number of tiles.
+ * @note Lower clip values limit noise amplification, clip = 1 gives almost
+ *       no contrast enhancement
+ */
+int clahe_equ(char* input_path, char* output_path, int tiles, double clip)
+{
+    // Validate parameters
+    if (tiles <= 0)
+    {
+        printf("Error: Number of tiles must be positive!\n");
+        return -1;
+    }
+    if (clip <= 0)
+    {
+        printf("Error: Clip limit must be positive!\n");
+        return -1;
+    }
+
+    // Load image
+    int width, height, channels;
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
+    if (!image)
+    {
+        printf("Error loading image\n");
+        return -1;
+    }
+
+    // Equalization works on intensity, so color images are converted to grayscale first
+    if (channels >= 3 && !gradation_gray(image, height, width, channels))
+    {
+        free_image(image);
+        return -1;
+    }
+
+    // Tile geometry (tiles cannot be smaller than one pixel)
+    int tile_w = (width + tiles - 1) / tiles;
+    int tile_h = (height + tiles - 1) / tiles;
+    int tiles_x = (width + tile_w - 1) / tile_w;
+    int tiles_y = (height + tile_h - 1) / tile_h;
+
+    // Two rows of lookup tables plus per-column interpolation parameters
+    unsigned char* luts_top = (unsigned char*)malloc((size_t)tiles_x * 256);
+    unsigned char* luts_bottom = (unsigned char*)malloc((size_t)tiles_x * 256);
+    int* col_tile = (int*)malloc((size_t)width * sizeof(int));
+    int* col_weight = (int*)malloc((size_t)width * sizeof(int));
+    if (!luts_top || !luts_bottom || !col_tile || !col_weight)
+    {
+        free(luts_top);
+        free(luts_bottom);
+        free(col_tile);
+        free(col_weight);
+        free_image(image);
+        printf("Error: Memory allocation failed!\n");
+        return -1;
+    }
+
+    // Horizontal interpolation is the same for every row: left tile index and
+    // weight of the right tile in 1/256 units
+    for (int x = 0; x < width; x++)
+    {
+        double fx = (x + 0.5) / tile_w - 0.5;
+        int tx = (int)floor(fx);
+        int weight = (int)((fx - tx) * 256 + 0.5);
+        if (tx < 0)
+        {
+            tx = 0;
+            weight = 0;
+        }
+        else if (tx >= tiles_x - 1)
+        {
+            tx = tiles_x - 1;
+            weight = 0;
+        }
+        col_tile[x] = tx;
+        col_weight[x] = weight;
+    }
+
+    // Band -1 lies above the first row of tile centers and only uses tile row 0
+    build_tile_row_luts(image, width, height, channels, tile_w, tile_h, tiles_x, 0, clip, luts_bottom);
+
+    for (int band = -1; band < tiles_y; band++)
+    {
+        // Rows between the centers of tile rows band and band + 1
+        int y_start = band < 0 ? 0 : band * tile_h + tile_h / 2;
+        int y_end = band + 1 >= tiles_y ? height : (band + 1) * tile_h + tile_h / 2;
+        if (y_end > height)
+        {
+            y_end = height;
+        }
+
+        // Shift the tables down one tile row. Rows of the next tile row are only
+        // modified from this band on, so its histogram still sees original data.
+        unsigned char* swap = luts_top;
+        luts_top = luts_bottom;
+        luts_bottom = swap;
+        if (band + 1 < tiles_y && band >= 0)
+        {
+            build_tile_row_luts(image, width, height, channels, tile_w, tile_h, tiles_x, band + 1, clip, luts_bottom);
+        }
+        else
+        {
+            memcpy(luts_bottom, luts_top, (size_t)tiles_x * 256);
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (int y = y_start; y < y_end; y++)
+        {
+            // Vertical weight of the lower tile row in 1/256 units
+            int wy = 0;
+            if (band >= 0 && band + 1 < tiles_y)
+            {
+                double fy = (y + 0.5) / tile_h - 0.5 - band;
+                wy = (int)(fy * 256 + 0.5);
+                if (wy < 0) wy = 0;
+                else if (wy > 256) wy = 256;
+            }
+
+            unsigned char* row = image + (size_t)y * width * channels;
+            for (int x = 0; x < width; x++)
+            {
+                unsigned char* pixel = row + (size_t)x * channels;
+                int value = pixel[0];
+                int tx = col_tile[x];
+                int tx_next = tx + 1 < tiles_x ? tx + 1 : tx;
+                int wx = col_weight[x];
+
+                // Bilinear blend of the four surrounding tile mappings
+                int top = luts_top[tx * 256 + value] * (256 - wx) + luts_top[tx_next * 256 + value] * wx;
+                int bottom = luts_bottom[tx * 256 + value] * (256 - wx) + luts_bottom[tx_next * 256 + value] * wx;
+                unsigned char result = (unsigned char)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+
+                pixel[0] = result;
+                // Keep color images gray, alpha stays untouched
+                if (channels >= 3)
+                {
+                    pixel[1] = result;
+                    pixel[2] = result;
+                }
+            }
+        }
+    }
+
+    free(luts_top);
+    free(luts_bottom);
+    free(col_tile);
+    free(col_weight);
+
+    // Save processed image
+    int res = save_image(output_path, width, height, channels, image, 0);
+    free_image(image);
+    return res;
+}
@@ -30,7 +30,7 @@ int matrix_convolution(char* input_path, char* output_path, int mode)
 {
     /* Load input image using stb_image library */
     int width, height, channels;
-    unsigned char* image = stbi_load(input_path, &width, &height, &channels, 0);
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
     if (!image) 
     {
         printf("Error loading image\n");
@@ -38,10 +38,10 @@ int matrix_convolution(char* input_path, char* output_path, int mode)
     }
 
     /* Allocate temporary buffer for processed image */
-    unsigned char* temp = (unsigned char*)malloc(width * height * channels);
+    unsigned char* temp = alloc_image(width, height, channels);
     if (!temp) 
     {
-        stbi_image_free(image);
+        free_image(image);
         printf("Error: Memory allocation failed!\n");
         return -1;
     }
@@ -69,7 +69,7 @@ int matrix_convolution(char* input_path, char* output_path, int mode)
     if (!matrix) 
     {
         free(temp);
-        stbi_image_free(image);
+        free_image(image);
         printf("Error: Memory allocation failed!\n");
         return -1;
     }
@@ -83,7 +83,7 @@ int matrix_convolution(char* input_path, char* output_path, int mode)
             /* Cleanup already allocated rows if allocation fails */
             for(int k = 0; k < i; k++) free(matrix[k]);
             free(temp);
-            stbi_image_free(image);
+            free_image(image);
             free(matrix);
             printf("Error: Memory allocation failed!\n");
             return -1;
@@ -121,45 +121,25 @@ int matrix_convolution(char* input_path, char* output_path, int mode)
                         int y = get_cord(i + dy, height);
                         int x = get_cord(j + dx, width);
                         /* Weighted sum using matrix values */
-                        sum += image[(y * width + x) * channels + k] * matrix[dy + 1][dx + 1];
+                        sum += image[((size_t)y * width + x) * channels + k] * matrix[dy + 1][dx + 1];
                     }
                 }
                 /* Clamp result to valid pixel range [0,255] */
                 if (sum > 255) sum = 255;
                 else if (sum < 0) sum = 0;
-                temp[(i * width + j) * channels + k] = sum;    
+                temp[((size_t)i * width + j) * channels + k] = sum;    
             }
         }
     }
 
-    /* Save processed image in appropriate format */
-    int res;
-    if (strstr(output_path, ".png")) 
-    {
-        res = stbi_write_png(output_path, width, height, channels, temp, width * channels);
-    }
-    else if (strstr(output_path, ".jpg"))
-    {
-        res = stbi_write_jpg(output_path, width, height, channels, temp, 100);
-    } 
-    else 
-    {
-        printf("Unsupported format. Use .png or .jpg\n");
-        res = 0; // Indicate failure
-    }
+    /* Save processed image in the format given by the extension */
+    int res = save_image(output_path, width, height, channels, temp, 0);
 
     /* Free all allocated resources */
     for(int i = 0; i < 3; i++) free(matrix[i]);
     free(matrix);
     free(temp);
-    stbi_image_free(image);
+    free_image(image);
 
-    /* Check if save operation was successful */
-    if(!res)
-    {
-        printf("Error writing image\n");
-        return -1;
-    }
-    
-    return 0;
+    return res;
 }
\ No newline at end of file
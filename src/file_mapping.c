@@ -0,0 +1,292 @@
+/**
+ * @file file_mapping.c
+ * @brief Implementation of memory-mapped file access
+ *
+ * @details Thin layer over mmap() (POSIX) and file mapping objects (Windows)
+ *          so the rest of the code maps files without platform checks.
+ *          Mapped images handed out by the loader are tracked here, which
+ *          lets free_image() tell them from heap buffers.
+ */
+#include "functions.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define MAX_MAPPED_IMAGES 64 ///< Images that can be mapped at the same time
+
+/**
+ * @brief Image handed out as a pointer into a mapped file
+ */
+typedef struct
+{
+    const unsigned char* pixels; ///< Pointer given to the caller
+    unsigned char* base;         ///< Start of the mapping
+    size_t size;                 ///< Length of the mapping
+} mapped_image;
+
+static mapped_image mapped_images[MAX_MAPPED_IMAGES];
+
+/**
+ * @brief Maps a whole file for reading
+ * @param path Path to the file
+ * @param size Output: file size in bytes
+ * @return Start of the mapping, NULL if the file cannot be opened or mapped
+ *         (empty files, pipes and devices are not mapped)
+ *
+ * @note The mapping is private and writable: pages the caller modifies are
+ *       copied on write, the file itself never changes
+ */
+unsigned char* map_file(const char* path, size_t* size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+    LARGE_INTEGER length;
+    unsigned char* data = NULL;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &length) && length.QuadPart > 0 &&
+        (unsigned long long)length.QuadPart <= SIZE_MAX)
+    {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping)
+        {
+            data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = (size_t)length.QuadPart;
+    }
+    CloseHandle(file);
+    return data;
+#else
+    // Without O_NONBLOCK opening a named pipe would wait for a writer
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat info;
+    unsigned char* data = NULL;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && (unsigned long long)info.st_size <= SIZE_MAX)
+    {
+        void* p = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            data = (unsigned char*)p;
+            *size = (size_t)info.st_size;
+        }
+    }
+    close(fd);
+    return data;
+#endif
+}
+
+/**
+ * @brief Maps a whole file read-only for one pass from start to end
+ * @param path Path to the file
+ * @param size Output: file size in bytes
+ * @return Start of the mapping, NULL if the file cannot be opened or mapped
+ *         (empty files, pipes and devices are not mapped, the caller reads
+ *         them with stdio instead)
+ *
+ * @details Meant for encoded inputs a decoder reads once: the kernel is told
+ *          the access is sequential, so it reads ahead aggressively and can
+ *          drop pages behind the decoder.
+ */
+unsigned char* map_file_sequential(const char* path, size_t* size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+    LARGE_INTEGER length;
+    unsigned char* data = NULL;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &length) && length.QuadPart > 0 &&
+        (unsigned long long)length.QuadPart <= SIZE_MAX)
+    {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+            data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = (size_t)length.QuadPart;
+    }
+    CloseHandle(file);
+    return data;
+#else
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat info;
+    unsigned char* data = NULL;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+        (unsigned long long)info.st_size <= SIZE_MAX)
+    {
+        void* p = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            data = (unsigned char*)p;
+            *size = (size_t)info.st_size;
+            madvise(p, *size, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+    return data;
+#endif
+}
+
+/**
+ * @brief Creates (or truncates) a file of a given size and maps it for writing
+ * @param path Path to the file
+ * @param size File size in bytes (must be positive)
+ * @return Start of the mapping, NULL on error; the data reaches the file
+ *         when it is unmapped with unmap_file()
+ */
+unsigned char* map_new_file(const char* path, size_t size)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+    unsigned long long length = size;
+    unsigned char* data = NULL;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(length >> 32), (DWORD)length, NULL);
+    if (mapping)
+    {
+        data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return data;
+#else
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    unsigned char* data = NULL;
+    if ((off_t)size > 0 && (size_t)(off_t)size == size && ftruncate(fd, (off_t)size) == 0)
+    {
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            data = (unsigned char*)p;
+        }
+    }
+    close(fd);
+    return data;
+#endif
+}
+
+/**
+ * @brief Unmaps a file mapped with map_file(), map_file_sequential() or map_new_file()
+ * @param data Start of the mapping
+ * @param size Length of the mapping
+ * @return 0 on success, -1 on error
+ */
+int unmap_file(unsigned char* data, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    return UnmapViewOfFile(data) ? 0 : -1;
+#else
+    return munmap(data, size) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Renames a file, replacing the target if it exists
+ * @param from Current path
+ * @param to New path
+ * @return 0 on success, -1 on error
+ *
+ * @note A target that is mapped (e.g. the input of the running command) keeps
+ *       its old contents in the mapping on POSIX systems; Windows refuses to
+ *       replace a mapped file
+ */
+int replace_file(const char* from, const char* to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to) == 0 ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Remembers that an image handed to the caller lies inside a mapping
+ * @param pixels Image data given to the caller
+ * @param base Start of the mapping
+ * @param size Length of the mapping
+ * @return 0 on success, -1 if too many images are mapped (the caller should
+ *         copy the pixels and unmap instead)
+ */
+int track_mapped_image(const unsigned char* pixels, unsigned char* base, size_t size)
+{
+    int res = -1;
+    #pragma omp critical(mapped_images)
+    {
+        for (int i = 0; i < MAX_MAPPED_IMAGES; i++)
+        {
+            if (!mapped_images[i].pixels)
+            {
+                mapped_images[i].pixels = pixels;
+                mapped_images[i].base = base;
+                mapped_images[i].size = size;
+                res = 0;
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief Unmaps an image registered with track_mapped_image()
+ * @param pixels Image data
+ * @return 1 if the image was mapped and is now released, 0 if it is not a
+ *         mapped image
+ */
+int release_mapped_image(const unsigned char* pixels)
+{
+    mapped_image found = {NULL, NULL, 0};
+    #pragma omp critical(mapped_images)
+    {
+        for (int i = 0; i < MAX_MAPPED_IMAGES; i++)
+        {
+            if (mapped_images[i].pixels && mapped_images[i].pixels == pixels)
+            {
+                found = mapped_images[i];
+                mapped_images[i].pixels = NULL;
+                break;
+            }
+        }
+    }
+    if (!found.pixels)
+    {
+        return 0;
+    }
+    unmap_file(found.base, found.size);
+    return 1;
+}
@@ -12,6 +12,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <math.h>
 #include "../libs/stb_image.h"
@@ -19,6 +22,31 @@
 
 #define PI 3.1415926535 ///< Pi constant for mathematical calculations
 
+#define INTERP_NEAREST 0  ///< Nearest-neighbor sampling
+#define INTERP_BILINEAR 1 ///< Bilinear sampling
+#define INTERP_BICUBIC 2  ///< Bicubic (Catmull-Rom) sampling
+
+#define ROTATE_DIRECT 0 ///< Rotation by inverse mapping of every pixel
+#define ROTATE_SHEAR 1  ///< Rotation by three 1D shears (Paeth)
+
+#define FILTER_BOX 0         ///< Box filter (area average when downscaling)
+#define FILTER_TRIANGLE 1    ///< Triangle (bilinear) filter
+#define FILTER_CATMULL_ROM 2 ///< Catmull-Rom bicubic filter
+#define FILTER_LANCZOS3 3    ///< Lanczos filter with 3 lobes
+
+#define PNM_AUTO 0 ///< PGM for 1-2 channels, PPM for 3-4
+#define PNM_PGM 5  ///< Raw graymap (P5)
+#define PNM_PPM 6  ///< Raw pixmap (P6)
+#define PNM_PAM 7  ///< Portable arbitrary map (P7), keeps alpha
+
+#define REMAP_FRACTION_BITS 8   ///< Fractional bits of remap table coordinates
+#define REMAP_OUTSIDE INT32_MIN ///< Remap table entry without source pixel
+
+/// SSE2 code paths, disabled by compiling with -DIMGPROC_NO_SIMD
+#if defined(__SSE2__) && !defined(IMGPROC_NO_SIMD)
+#define USE_SSE2
+#endif
+
 /**
  * @brief Applies median filter to an image
  * @param input_path Path to the input image file
@@ -28,6 +56,394 @@
  */
 int median_filter(char* input_path, char* output_path, int size);
 
+/**
+ * @brief Loads an image and turns it upright according to its EXIF orientation
+ * @param path Path to the image file, "-" for stdin
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free_image(), NULL on error
+ */
+unsigned char* load_image(const char* path, int* width, int* height, int* channels);
+
+/**
+ * @brief Loads an image reduced during decoding when it is larger than needed
+ * @param path Path to the image file, "-" for stdin
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @param min_width Smallest upright width the caller needs, 0 for any
+ * @param min_height Smallest upright height the caller needs, 0 for any
+ * @param area Output (may be NULL): rectangle {x, y, width, height} of the
+ *             returned pixels covered by the image
+ * @return Image data released with free_image(), NULL on error
+ */
+unsigned char* load_image_scaled(const char* path, int* width, int* height, int* channels,
+                                 int min_width, int min_height, double* area);
+
+/**
+ * @brief Releases an image returned by load_image() or load_image_scaled()
+ * @param image Image data (may be NULL)
+ */
+void free_image(unsigned char* image);
+
+/**
+ * @brief Reads the size of an upright image without decoding pixels
+ * @param path Path to the image file, "-" for stdin
+ * @param width Output: image width in pixels after orientation
+ * @param height Output: image height in pixels after orientation
+ * @param channels Output: number of color channels
+ * @return 1 on success, 0 on error
+ */
+int image_info(const char* path, int* width, int* height, int* channels);
+
+/**
+ * @brief Gives the loader the bytes of an input read ahead (batch mode)
+ * @param path Input path the bytes belong to, NULL to stop using them
+ * @param data File contents (kept by the caller until it calls this with NULL)
+ * @param size Number of bytes
+ *
+ * @note Per thread: every batch worker sets the file it is processing
+ */
+void use_prefetched_input(const char* path, const unsigned char* data, size_t size);
+
+/**
+ * @brief Saves an image in the format given by the path extension
+ * @param path Output file path (.png, .jpg/.jpeg, .qoi, .raw, .pgm, .ppm, .pnm, .pam, .bmp, .tga or .hdr),
+ *             "-" for stdout in the format set with --format
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param data Image data
+ * @param stride Distance between rows in bytes, 0 for width * channels
+ * @return 0 on success, -1 on error (the error is printed)
+ */
+int save_image(const char* path, int width, int height, int channels,
+               const unsigned char* data, int stride);
+
+/**
+ * @brief Applies one encoder option given on the command line
+ * @param arg "--quality=1..100", "--subsampling=420|444|auto", "--png-level=0..9" or "--format=extension"
+ * @return 0 on success, -1 on unknown option or invalid value
+ */
+int parse_write_option(const char* arg);
+
+/**
+ * @brief Gives the extension set with --format
+ * @return Extension without the dot, empty if --format was not given
+ */
+const char* output_format(void);
+
+/**
+ * @brief Checks whether save_image() can write a path
+ * @param path Output file path
+ * @return Non-zero if the extension (or --format for "-") names an output format
+ */
+int has_output_format(const char* path);
+
+/**
+ * @brief Writes an image as PNG, filtering and compressing in parallel
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @param level Compression level 0-9 (0 stores, 9 gives the smallest files)
+ * @return Non-zero on success, 0 on error
+ */
+int png_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride,
+              int level);
+
+/**
+ * @brief Writes an image as baseline JPEG, encoding rows of blocks in parallel
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-2 are saved as grayscale, alpha is dropped)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @param quality Quality 1-100
+ * @param subsampling -1 automatic (4:2:0 up to quality 90), 0 - 4:4:4, 1 - 4:2:0
+ * @return Non-zero on success, 0 on error
+ */
+int jpeg_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride,
+               int quality, int subsampling);
+
+/**
+ * @brief Writes an image as QOI, the fast lossless format for intermediate files
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-2 are stored as RGB/RGBA)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @return Non-zero on success, 0 on error
+ */
+int qoi_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride);
+
+/**
+ * @brief Reads the header of a QOI file
+ * @param file File positioned at its start
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels (3 or 4)
+ * @return 1 if the file is a valid QOI image, 0 otherwise
+ */
+int qoi_info(FILE* file, int* width, int* height, int* channels);
+
+/**
+ * @brief Decodes a QOI image
+ * @param file File positioned at its start
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels (3 or 4)
+ * @return Image data released with free(), NULL on error
+ */
+unsigned char* qoi_read(FILE* file, int* width, int* height, int* channels);
+
+/**
+ * @brief Saves an image as a raw pixel container through a mapped file
+ * @param path Output file path
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @return Non-zero on success, 0 on error
+ */
+int raw_write(const char* path, int width, int height, int channels, const unsigned char* data, int stride);
+
+/**
+ * @brief Writes an image as a raw pixel container to a stream (e.g. stdout)
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @return Non-zero on success, 0 on error
+ */
+int raw_write_stream(FILE* file, int width, int height, int channels, const unsigned char* data, int stride);
+
+/**
+ * @brief Reads the header of a raw pixel container
+ * @param file File positioned at its start
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return 1 if the file starts with a valid raw header, 0 otherwise
+ */
+int raw_info(FILE* file, int* width, int* height, int* channels);
+
+/**
+ * @brief Loads a raw pixel container by mapping it, without copying the pixels
+ * @param path Path to the file
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free_image(), NULL on error
+ */
+unsigned char* raw_load(const char* path, int* width, int* height, int* channels);
+
+/**
+ * @brief Netpbm image read or written one row at a time
+ */
+typedef struct pnm_stream
+{
+    FILE* file;             ///< File the rows are read from or written to
+    int width;              ///< Image width in pixels
+    int height;             ///< Image height in pixels
+    int channels;           ///< Channels of the rows passed in or out (1-4)
+    int format;             ///< Netpbm type: 1-7 for P1-P7
+    int maxval;             ///< Largest sample value in the file
+    int row;                ///< Rows transferred so far
+    unsigned char* buffer;  ///< One row in the file layout
+} pnm_stream;
+
+/**
+ * @brief Opens a Netpbm image (P1-P7, plain or raw, any maxval) for reading row by row
+ * @param s Stream to initialize, released with pnm_close()
+ * @param file File positioned at the start of the image (closed by the caller)
+ * @return 0 on success, -1 if the data is not a supported Netpbm image
+ */
+int pnm_open_read(pnm_stream* s, FILE* file);
+
+/**
+ * @brief Reads the next row of an image opened with pnm_open_read()
+ * @param s Stream
+ * @param row Output: width * channels 8-bit samples
+ * @return 0 on success, -1 on truncated or invalid data
+ */
+int pnm_read_row(pnm_stream* s, unsigned char* row);
+
+/**
+ * @brief Opens a Netpbm image for writing row by row and writes its header
+ * @param s Stream to initialize, released with pnm_close()
+ * @param file Output file (closed by the caller)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of channels of the rows passed to pnm_write_row() (1-4)
+ * @param format PNM_AUTO, PNM_PGM, PNM_PPM or PNM_PAM
+ * @return 0 on success, -1 on error
+ */
+int pnm_open_write(pnm_stream* s, FILE* file, int width, int height, int channels, int format);
+
+/**
+ * @brief Writes the next row of an image opened with pnm_open_write()
+ * @param s Stream
+ * @param row width * channels samples
+ * @return 0 on success, -1 on a write error
+ */
+int pnm_write_row(pnm_stream* s, const unsigned char* row);
+
+/**
+ * @brief Releases the row buffer of a stream (the file is not closed)
+ * @param s Stream
+ */
+void pnm_close(pnm_stream* s);
+
+/**
+ * @brief Decodes a whole Netpbm image
+ * @param file File positioned at the start of the image
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free(), NULL on error
+ */
+unsigned char* pnm_load(FILE* file, int* width, int* height, int* channels);
+
+/**
+ * @brief Reads the size of a Netpbm image from its header
+ * @param file File positioned at the start of the image
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return 1 if the file is a supported Netpbm image, 0 otherwise
+ */
+int pnm_info(FILE* file, int* width, int* height, int* channels);
+
+/**
+ * @brief Checks whether data starts with a Netpbm magic number ("P1" to "P7")
+ * @param file File positioned at the start of the data
+ * @return 1 for Netpbm data, valid or not, 0 otherwise
+ */
+int pnm_test(FILE* file);
+
+/**
+ * @brief Writes an image as PGM, PPM or PAM
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @param format PNM_AUTO, PNM_PGM, PNM_PPM or PNM_PAM
+ * @return Non-zero on success, 0 on error
+ */
+int pnm_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride,
+              int format);
+
+/**
+ * @brief Reads a raw pixel container from a stream that cannot be mapped (e.g. stdin)
+ * @param file Stream positioned at the start of the file
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free(), NULL on error
+ */
+unsigned char* raw_read(FILE* file, int* width, int* height, int* channels);
+
+/**
+ * @brief Opens an input image, or stdin for "-"; stdin and named pipes are
+ *        read into memory once, so they can be opened again
+ * @param path Path to the image file, "-" for stdin
+ * @return Seekable stream closed with fclose(), NULL on error
+ */
+FILE* open_image_stream(const char* path);
+
+/**
+ * @brief Gives the stream for image data on stdout; from the first call on,
+ *        messages printed with printf go to stderr
+ * @return Binary stream to the original stdout (not closed by the caller), NULL on error
+ */
+FILE* image_stdout(void);
+
+/**
+ * @brief Maps a whole file for reading (private, copy-on-write pages)
+ * @param path Path to the file
+ * @param size Output: file size in bytes
+ * @return Start of the mapping, NULL on error or for an empty file
+ */
+unsigned char* map_file(const char* path, size_t* size);
+
+/**
+ * @brief Maps a whole file read-only for one pass from start to end
+ * @param path Path to the file
+ * @param size Output: file size in bytes
+ * @return Start of the mapping, NULL on error or for an empty file, a pipe or a device
+ */
+unsigned char* map_file_sequential(const char* path, size_t* size);
+
+/**
+ * @brief Creates (or truncates) a file of a given size and maps it for writing
+ * @param path Path to the file
+ * @param size File size in bytes
+ * @return Start of the mapping, NULL on error
+ */
+unsigned char* map_new_file(const char* path, size_t size);
+
+/**
+ * @brief Unmaps a file mapped with map_file(), map_file_sequential() or map_new_file()
+ * @param data Start of the mapping
+ * @param size Length of the mapping
+ * @return 0 on success, -1 on error
+ */
+int unmap_file(unsigned char* data, size_t size);
+
+/**
+ * @brief Renames a file, replacing the target if it exists
+ * @param from Current path
+ * @param to New path
+ * @return 0 on success, -1 on error
+ */
+int replace_file(const char* from, const char* to);
+
+/**
+ * @brief Remembers that an image handed to the caller lies inside a mapping
+ * @param pixels Image data given to the caller
+ * @param base Start of the mapping
+ * @param size Length of the mapping
+ * @return 0 on success, -1 if too many images are mapped
+ */
+int track_mapped_image(const unsigned char* pixels, unsigned char* base, size_t size);
+
+/**
+ * @brief Unmaps an image registered with track_mapped_image()
+ * @param pixels Image data
+ * @return 1 if the image was mapped and is now released, 0 otherwise
+ */
+int release_mapped_image(const unsigned char* pixels);
+
+/**
+ * @brief Computes the byte size of an image buffer with overflow checking
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @return width * height * channels, or 0 if a dimension is not positive
+ *         or the product does not fit in size_t
+ */
+size_t image_size(int width, int height, int channels);
+
+/**
+ * @brief Allocates an image buffer with overflow checking
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @return Pointer to uninitialized buffer, NULL on overflow or allocation failure
+ */
+unsigned char* alloc_image(int width, int height, int channels);
+
 /**
  * @brief Clamps a coordinate to stay within image boundaries
  * @param coord Input coordinate
@@ -83,23 +499,518 @@ int gray_filter(char* input_path, char* output_path);
  */
 int histogram_equ(char* input_path, char* output_path);
 
+/**
+ * @brief Performs contrast-limited adaptive histogram equalization (CLAHE)
+ * @param input_path Path to the input image file
+ * @param output_path Path to save the processed image
+ * @param tiles Number of tiles along each axis
+ * @param clip Clip limit as a multiple of the average histogram bin count
+ * @return 0 on success, -1 on error
+ */
+int clahe_equ(char* input_path, char* output_path, int tiles, double clip);
+
+/**
+ * @brief Clamps a coordinate to the image by repeating edge pixels
+ * @param coord Input coordinate
+ * @param max_len Length along the corresponding axis
+ * @return Coordinate within [0, max_len-1] range
+ */
+int get_clamped(int coord, int max_len);
+
+/**
+ * @brief Parses a color given as text
+ * @param text "transparent", "RRGGBB" or "RRGGBBAA" (hex digits, optional leading '#')
+ * @param rgba Output color, 4 bytes
+ * @return 0 on success, -1 on invalid text
+ */
+int parse_color(const char* text, unsigned char* rgba);
+
+/**
+ * @brief Converts an RGBA color to a pixel of the given channel layout
+ * @param rgba Color, 4 bytes
+ * @param channels 1 (gray), 2 (gray + alpha), 3 (RGB) or 4 (RGBA)
+ * @param pixel Output pixel, channels bytes
+ */
+void color_to_pixel(const unsigned char* rgba, int channels, unsigned char* pixel);
+
+/**
+ * @brief Creates a copy of an image with an opaque alpha channel appended
+ * @param image Image data with 1 (gray) or 3 (RGB) channels
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels of the input
+ * @return Newly allocated image with channels + 1 channels, NULL on error
+ */
+unsigned char* add_alpha_channel(const unsigned char* image, int width, int height, int channels);
+
 /**
  * @brief Rotates an image by specified angle
  * @param input_path Path to the input image file
  * @param output_path Path to save the processed image
- * @param angle_degrees Rotation angle in degrees
+ * @param angle_degrees Rotation angle in degrees (positive = clockwise)
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param background NULL to keep the original size, otherwise the canvas fits the
+ *                   rotated image and is filled with this color or "transparent"
+ * @param method ROTATE_DIRECT or ROTATE_SHEAR
+ * @return 0 on success, -1 on error
+ */
+int rotate_image(char* input_path, char* output_path, double angle_degrees, int interpolation, char* background,
+                 int method);
+
+/**
+ * @brief Rotates image data by an arbitrary angle using inverse mapping
+ * @param src Source image data
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param angle_degrees Rotation angle in degrees (positive = clockwise)
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param expand Non-zero to fit the canvas to the rotated image
+ * @param fill Background pixel in the source channel layout, NULL for zeros
+ * @param out_width Output: width of the rotated image
+ * @param out_height Output: height of the rotated image
+ * @return Newly allocated rotated image, NULL on error
+ */
+unsigned char* rotate_buffer(const unsigned char* src, int width, int height, int channels,
+                             double angle_degrees, int interpolation, int expand,
+                             const unsigned char* fill, int* out_width, int* out_height);
+
+/**
+ * @brief Rotates image data using three successive shears (Paeth)
+ * @param src Source image data
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param angle_degrees Rotation angle in degrees (positive = clockwise)
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param expand Non-zero to fit the canvas to the rotated image
+ * @param fill Background pixel in the source channel layout, NULL for zeros
+ * @param out_width Output: width of the rotated image
+ * @param out_height Output: height of the rotated image
+ * @return Newly allocated rotated image, NULL on error
+ */
+unsigned char* rotate_shear_buffer(const unsigned char* src, int width, int height, int channels,
+                                   double angle_degrees, int interpolation, int expand,
+                                   const unsigned char* fill, int* out_width, int* out_height);
+
+/**
+ * @brief Rotates an image by a multiple of 90 degrees without resampling
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param quarter_turns Number of clockwise quarter turns (any integer)
+ * @param out_width Output: width of the rotated image
+ * @param out_height Output: height of the rotated image
+ * @return Newly allocated rotated image, NULL on error
+ */
+unsigned char* rotate_orthogonal(const unsigned char* src, int width, int height, int channels,
+                                 int quarter_turns, int* out_width, int* out_height);
+
+/**
+ * @brief Applies an EXIF orientation to image data without resampling
+ * @param src Source image data as stored in the file
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param orientation EXIF orientation tag value (1-8)
+ * @param out_width Output: width of the upright image
+ * @param out_height Output: height of the upright image
+ * @return Newly allocated upright image, NULL on error
+ */
+unsigned char* orient_image(const unsigned char* src, int width, int height, int channels,
+                            int orientation, int* out_width, int* out_height);
+
+/**
+ * @brief Computes Catmull-Rom weights for the 4 taps around a sample
+ * @param t Fractional position between tap 1 and tap 2, in [0,1)
+ * @param w Output weights for taps at distances 1+t, t, 1-t, 2-t
+ */
+void cubic_weights(float t, float* w);
+
+/**
+ * @brief Fills consecutive pixels with one color
+ * @param dst First pixel to fill
+ * @param count Number of pixels
+ * @param channels Number of color channels
+ * @param fill Pixel value
+ */
+void fill_pixels(unsigned char* dst, int count, int channels, const unsigned char* fill);
+
+/**
+ * @brief Inverts a 3x3 matrix
+ * @param m Matrix in row-major order
+ * @param inverse Output matrix in row-major order
+ * @return 0 on success, -1 if the matrix is singular
+ */
+int invert_matrix3(const double* m, double* inverse);
+
+/**
+ * @brief Warps image data through a projective transform
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param matrix 3x3 row-major matrix mapping destination pixel (x, y, 1)
+ *               to homogeneous source coordinates (inverse mapping)
+ * @param dst_width Destination width in pixels
+ * @param dst_height Destination height in pixels
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Background pixel for areas outside the source, NULL to repeat edge pixels
+ * @return Newly allocated warped image, NULL on error
+ */
+unsigned char* warp_buffer(const unsigned char* src, int width, int height, int channels,
+                           const double* matrix, int dst_width, int dst_height,
+                           int interpolation, const unsigned char* fill);
+
+/**
+ * @brief Warps an image through an affine or perspective transform
+ * @param input_path Path to input image file
+ * @param output_path Path to save warped image
+ * @param matrix 3x3 row-major forward matrix (source pixel to destination pixel)
+ * @param out_width Output width in pixels, 0 for the input width
+ * @param out_height Output height in pixels, 0 for the input height
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @return 0 on success, -1 on error
+ */
+int warp_image(char* input_path, char* output_path, const double* matrix,
+               int out_width, int out_height, int interpolation);
+
+/**
+ * @brief Resizes an image to fit, fill or match a target box
+ * @param input_path Path to input image
+ * @param output_path Path to save resized image
+ * @param spec Target box: "WxH[:fit|:fill|:exact]", 0 or a missing size follows the aspect ratio
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @return 0 on success, -1 on error
+ */
+int resize_to_box(char* input_path, char* output_path, char* spec, int filter);
+
+/**
+ * @brief Produces several resized versions of an image from a single decode
+ * @param input_path Path to input image
+ * @param output_path Base output path, the size of every level is inserted before the extension
+ * @param specs Comma-separated target boxes, each as accepted by resize_to_box()
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @param add_suffix Non-zero to add the size to the file names, zero to save to output_path as is
+ * @return 0 on success, -1 on error
+ */
+int thumbnail_ladder(char* input_path, char* output_path, char* specs, int filter, int add_suffix);
+
+/**
+ * @brief Precomputed source positions for a geometric transform
+ */
+typedef struct remap_table
+{
+    int width;       ///< Destination width in pixels
+    int height;      ///< Destination height in pixels
+    int src_width;   ///< Source width the table was built for
+    int src_height;  ///< Source height the table was built for
+    int32_t* coords; ///< Source (x, y) per destination pixel, REMAP_FRACTION_BITS fixed point
+} remap_table;
+
+/**
+ * @brief Builds a remap table from a projective transform
+ * @param table Output table, released with remap_free()
+ * @param matrix 3x3 row-major inverse matrix (destination pixel to source)
+ * @param width Destination width in pixels
+ * @param height Destination height in pixels
+ * @param src_width Source width in pixels
+ * @param src_height Source height in pixels
+ * @return 0 on success, -1 on error
+ */
+int remap_from_matrix(remap_table* table, const double* matrix, int width, int height,
+                      int src_width, int src_height);
+
+/**
+ * @brief Builds a remap table that corrects radial lens distortion
+ * @param table Output table, released with remap_free()
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param k1 Second-order radial coefficient
+ * @param k2 Fourth-order radial coefficient
+ * @return 0 on success, -1 on error
+ */
+int remap_from_lens(remap_table* table, int width, int height, double k1, double k2);
+
+/**
+ * @brief Releases the coordinates of a remap table
+ * @param table Remap table
+ */
+void remap_free(remap_table* table);
+
+/**
+ * @brief Saves a remap table to a file
+ * @param table Remap table
+ * @param path Output file path
+ * @return 0 on success, -1 on error
+ */
+int remap_save(const remap_table* table, const char* path);
+
+/**
+ * @brief Loads a remap table saved by remap_save()
+ * @param table Output table, released with remap_free()
+ * @param path Map file path
+ * @return 0 on success, -1 on error
+ */
+int remap_load(remap_table* table, const char* path);
+
+/**
+ * @brief Applies a remap table to image data
+ * @param src Source image data
+ * @param width Source width in pixels (must match the table)
+ * @param height Source height in pixels (must match the table)
+ * @param channels Number of color channels
+ * @param table Remap table
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Background pixel for positions outside the source
+ * @return Newly allocated image of the table size, NULL on error
+ */
+unsigned char* remap_buffer(const unsigned char* src, int width, int height, int channels,
+                            const remap_table* table, int interpolation, const unsigned char* fill);
+
+/**
+ * @brief Saves a lens distortion correction map for images of one size
+ * @param input_path Path to an image from the camera
+ * @param map_path Path to save the map file
+ * @param k1 Second-order radial coefficient
+ * @param k2 Fourth-order radial coefficient
+ * @return 0 on success, -1 on error
+ */
+int lens_map(char* input_path, char* map_path, double k1, double k2);
+
+/**
+ * @brief Saves a projective transform as a map for images of one size
+ * @param input_path Path to an image of the source size
+ * @param map_path Path to save the map file
+ * @param matrix 3x3 row-major forward matrix (source pixel to destination pixel)
+ * @param out_width Output width in pixels, 0 for the input width
+ * @param out_height Output height in pixels, 0 for the input height
+ * @return 0 on success, -1 on error
+ */
+int warp_map(char* input_path, char* map_path, const double* matrix, int out_width, int out_height);
+
+/**
+ * @brief Applies a saved remap table to an image
+ * @param input_path Path to input image file
+ * @param output_path Path to save remapped image
+ * @param map_path Path to a map file created by lens_map() or warp_map()
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @return 0 on success, -1 on error
+ */
+int remap_image(char* input_path, char* output_path, char* map_path, int interpolation);
+
+/**
+ * @brief Resizes image data with a separable filter
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param dst_width Destination width in pixels
+ * @param dst_height Destination height in pixels
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @return Newly allocated resized image, NULL on error
+ */
+unsigned char* resample_buffer(const unsigned char* src, int width, int height, int channels,
+                               int dst_width, int dst_height, int filter);
+
+/**
+ * @brief Resizes a rectangle of image data with a separable filter
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param area Source rectangle {x, y, width, height} in pixels, fractional
+ *             values allowed; NULL for the whole image
+ * @param dst_width Destination width in pixels
+ * @param dst_height Destination height in pixels
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @return Newly allocated resized image, NULL on error
+ */
+unsigned char* resample_area(const unsigned char* src, int width, int height, int channels,
+                             const double* area, int dst_width, int dst_height, int filter);
+
+/**
+ * @brief Parses a resampling filter name
+ * @param name "box", "triangle", "catmullrom" (or "bicubic") or "lanczos3"
+ * @return Filter identifier, -1 for an unknown name
+ */
+int parse_filter(const char* name);
+
+/**
+ * @brief Resizes an image with a selectable resampling filter
+ * @param input_path Path to the input image file
+ * @param output_path Path to save the processed image
+ * @param scale_x Horizontal scale factor (at most 16)
+ * @param scale_y Vertical scale factor (at most 16)
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
  * @return 0 on success, -1 on error
  */
-int rotate_image(char* input_path, char* output_path, double angle_degrees);
+int resize_image(char* input_path, char* output_path, double scale_x, double scale_y, int filter);
+
+/**
+ * @brief Fills table with identity mapping
+ * @param lut Table of 256 entries
+ */
+void lut_identity(unsigned char* lut);
+
+/**
+ * @brief Composes two tables into one
+ * @param first Table applied first
+ * @param second Table applied to the result of the first one
+ * @param out Output table, out[i] = second[first[i]] (may alias either input)
+ */
+void lut_compose(const unsigned char* first, const unsigned char* second, unsigned char* out);
+
+/**
+ * @brief Builds gamma correction table
+ * @param lut Output table
+ * @param gamma Gamma value (values above 1 brighten midtones)
+ */
+void lut_gamma(unsigned char* lut, double gamma);
+
+/**
+ * @brief Builds levels table
+ * @param lut Output table
+ * @param in_black Input level mapped to out_black
+ * @param in_white Input level mapped to out_white
+ * @param out_black Output black level
+ * @param out_white Output white level
+ */
+void lut_levels(unsigned char* lut, int in_black, int in_white, int out_black, int out_white);
+
+/**
+ * @brief Builds contrast table
+ * @param lut Output table
+ * @param factor Contrast factor around middle gray
+ */
+void lut_contrast(unsigned char* lut, double factor);
+
+/**
+ * @brief Builds binary threshold table
+ * @param lut Output table
+ * @param level Values greater or equal to level become 255, others 0
+ */
+void lut_threshold(unsigned char* lut, int level);
 
 /**
- * @brief Resizes an image using bicubic interpolation
+ * @brief Builds negative table
+ * @param lut Output table
+ */
+void lut_invert(unsigned char* lut);
+
+/**
+ * @brief Builds histogram equalization table
+ * @param lut Output table
+ * @param histogram Histogram of 256 bins
+ */
+void lut_equalize(unsigned char* lut, const unsigned long long* histogram);
+
+/**
+ * @brief Applies lookup tables to an image in place
+ * @param image Image data
+ * @param pixels Number of pixels
+ * @param channels Number of color channels
+ * @param luts channels * 256 entries, or 256 entries when same_lut is non-zero
+ * @param same_lut Non-zero if the same table is used for every channel
+ */
+void lut_apply(unsigned char* image, size_t pixels, int channels, const unsigned char* luts, int same_lut);
+
+/**
+ * @brief Applies a table to color channels only, leaving alpha unchanged
+ * @param image Image data
+ * @param pixels Number of pixels
+ * @param channels Number of color channels
+ * @param lut Table of 256 entries
+ */
+void lut_apply_color(unsigned char* image, size_t pixels, int channels, const unsigned char* lut);
+
+/**
+ * @brief Applies a chain of point operations composed into one lookup table
  * @param input_path Path to the input image file
  * @param output_path Path to save the processed image
- * @param scale_x Horizontal scale factor
- * @param scale_y Vertical scale factor
+ * @param spec Comma separated operations, e.g. "gamma:2.2,contrast:1.3,invert"
+ * @return 0 on success, -1 on error
+ */
+int point_operations(char* input_path, char* output_path, char* spec);
+
+/**
+ * @brief Input files read ahead of the workers of a batch
+ */
+typedef struct prefetch_queue
+{
+    char** paths;          ///< Files in the order the workers take them (owned by the caller)
+    int count;             ///< Number of files
+    int window;            ///< Files read ahead of the first one no worker has taken
+    int next;              ///< Next file handed to a worker
+    int readers;           ///< Threads to run prefetch_run() on (1 with io_uring)
+    unsigned char** data;  ///< Bytes of every file read and not taken yet
+    size_t* sizes;         ///< Their lengths
+    int* states;           ///< Read state of every file
+    void* ring;            ///< io_uring instance, NULL when reading with threads
+} prefetch_queue;
+
+/**
+ * @brief Prepares reading a list of files ahead
+ * @param queue Queue to initialize, released with prefetch_close()
+ * @param paths Files in the order the workers take them (kept by the caller)
+ * @param count Number of files
+ * @param window Files read ahead of the first one no worker has taken
+ * @return 0 on success, -1 if memory allocation fails
+ */
+int prefetch_open(prefetch_queue* queue, char** paths, int count, int window);
+
+/**
+ * @brief Reads files ahead until every file is read or taken; run on
+ *        queue->readers threads next to the workers
+ * @param queue Queue
+ */
+void prefetch_run(prefetch_queue* queue);
+
+/**
+ * @brief Gives a worker the next file to process
+ * @param queue Queue
+ * @return Index of the file, -1 when all files are taken
+ */
+int prefetch_next(prefetch_queue* queue);
+
+/**
+ * @brief Takes the bytes of a file, waiting if its read is in progress
+ * @param queue Queue
+ * @param index File index from prefetch_next()
+ * @param size Output: number of bytes
+ * @return File contents released with free(), NULL if the file was not read
+ *         ahead (the caller loads it from disk)
+ */
+unsigned char* prefetch_take(prefetch_queue* queue, int index, size_t* size);
+
+/**
+ * @brief Releases a queue and the bytes no worker has taken
+ * @param queue Queue
+ */
+void prefetch_close(prefetch_queue* queue);
+
+/**
+ * @brief Command run on one file of a batch, with the same arguments as main()
  * @return 0 on success, -1 on error
  */
-int resize_bicubic(char* input_path, char* output_path, double scale_x, double scale_y);
+typedef int (*batch_command)(int argc, char* argv[]);
+
+/**
+ * @brief Checks whether a path names a directory
+ * @param path Path
+ * @return Non-zero for a directory
+ */
+int is_directory(const char* path);
+
+/**
+ * @brief Runs a command on every image of a directory
+ * @param argc Argument count
+ * @param argv Arguments of one command, argv[1] is the input directory and
+ *             argv[argc - 1] the output directory
+ * @param command Function running the command on one file
+ * @return 0 if every file was processed, -1 otherwise
+ */
+int batch_run(int argc, char* argv[], batch_command command);
 
 #endif
\ No newline at end of file
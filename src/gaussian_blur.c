@@ -28,7 +28,7 @@ int gaussian_blur(char* input_path, char* output_path, int size, double sigma)
 
     // Load image using stb_image library
     int width, height, channels;
-    unsigned char* image = stbi_load(input_path, &width, &height, &channels, 0);
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
     if (!image) 
     {
         printf("Error loading image\n");
@@ -38,7 +38,7 @@ int gaussian_blur(char* input_path, char* output_path, int size, double sigma)
     // Check if kernel size is larger than image dimensions
     if (size > height || size > width) 
     {
-        stbi_image_free(image);
+        free_image(image);
         printf("Error: Filter size exceeds image dimensions!\n");
         return -1;
     }
@@ -47,16 +47,16 @@ int gaussian_blur(char* input_path, char* output_path, int size, double sigma)
     double** kernel = (double**) malloc (size * sizeof(double*));
     if (!kernel) 
     {
-        stbi_image_free(image);
+        free_image(image);
         printf("Error: Memory allocation failed!\n");
         return -1;
     }
 
     // Allocate temporary buffer for processed image
-    unsigned char* temp = (unsigned char*) malloc (width * height * channels * sizeof(unsigned char));
+    unsigned char* temp = alloc_image(width, height, channels);
     if (!temp) 
     {
-        stbi_image_free(image);
+        free_image(image);
         free(kernel);
         printf("Error: Memory allocation failed!\n");
         return -1;
@@ -79,7 +79,7 @@ int gaussian_blur(char* input_path, char* output_path, int size, double sigma)
                 free(kernel[k]);
             }
             free(temp);
-            stbi_image_free(image);
+            free_image(image);
             printf("Error: Memory allocation failed!\n");
             return -1;
         }
@@ -124,32 +124,19 @@ int gaussian_blur(char* input_path, char* output_path, int size, double sigma)
                         int y = get_cord(i + dy, height);
                         int x = get_cord(j + dx, width);
                         // Weighted sum using kernel values
-                        sum += image[(y * width + x) * channels + k] * kernel[dy + radius][dx + radius];
+                        sum += image[((size_t)y * width + x) * channels + k] * kernel[dy + radius][dx + radius];
                     }
                 }
 
                 // Clamp result to valid pixel value range [0,255]
                 if (sum > 255) sum = 255;
-                temp[(i * width + j) * channels + k] = sum;
+                temp[((size_t)i * width + j) * channels + k] = sum;
             }
         }
     }
 
-    // Save processed image in appropriate format
-    int res;
-    if (strstr(output_path, ".png")) 
-    {
-        res = stbi_write_png(output_path, width, height, channels, temp, width * channels);
-    }
-    else if (strstr(output_path, ".jpg"))
-    {
-        res = stbi_write_jpg(output_path, width, height, channels, temp, 100);
-    } 
-    else 
-    {
-        printf("Unsupported format. Use .png or .jpg\n");
-        res = 1;
-    }
+    // Save processed image in the format given by the extension
+    int res = save_image(output_path, width, height, channels, temp, 0);
 
     // Free allocated memory
     for(int i = 0; i < size; i++)
@@ -158,16 +145,7 @@ int gaussian_blur(char* input_path, char* output_path, int size, double sigma)
     }
     free(kernel);
     free(temp);
-    stbi_image_free(image);
+    free_image(image);
 
-    // Check if image was saved successfully
-    if(!res)
-    {
-        printf("Error writing image\n");
-        return -1;
-    }
-    else
-    {
-        return 0;    
-    }
+    return res;
 }
\ No newline at end of file
@@ -15,7 +15,7 @@ int gray_filter(char* input_path, char* output_path)
 {
     // Load image
     int width, height, channels;
-    unsigned char* image = stbi_load(input_path, &width, &height, &channels, 0);
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
     if (!image) 
     {
         printf("Error loading image\n");
@@ -28,40 +28,14 @@ int gray_filter(char* input_path, char* output_path)
     if(!image)
     {   
         // Free resources before returning error
-        stbi_image_free(image);
+        free_image(image);
         return -1;
     }
     
-    // Save processed image in specified format
-    int res;
-    if (strstr(output_path, ".png")) 
-    {
-        // Save as PNG format
-        // Parameters: path, dimensions, channels, data, stride
-        res = stbi_write_png(output_path, width, height, channels, image, width * channels);
-    }
-    else if (strstr(output_path, ".jpg"))
-    {
-        // Save as JPG format with maximum quality (100)
-        res = stbi_write_jpg(output_path, width, height, channels, image, 100);
-    } 
-    else 
-    {
-        // Unsupported format - only PNG/JPG allowed
-        printf("Unsupported format. Use .png or .jpg\n");
-        stbi_image_free(image);
-        return -1;
-    }
+    // Save processed image in the format given by the extension
+    int res = save_image(output_path, width, height, channels, image, 0);
 
-    // Check if image was saved successfully
-    if(!res)
-    {
-        stbi_image_free(image);
-        printf("Error writing image\n");
-        return -1;
-    }
-    
     // Free image resources
-    stbi_image_free(image);
-    return 0;
+    free_image(image);
+    return res;
 }
\ No newline at end of file
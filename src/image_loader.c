@@ -0,0 +1,490 @@
+/**
+ * @file image_loader.c
+ * @brief Implementation of image loading with EXIF orientation support
+ *
+ * @details Cameras and phones store photos as captured and record how to turn
+ *          them upright in the EXIF orientation tag. The loader reads that tag
+ *          from the JPEG header before decoding and applies the exact
+ *          90/180/270 degree turn or mirror to the decoded pixels.
+ *          Large JPEGs can also be decoded directly at a reduced size when
+ *          only a smaller version is needed (thumbnails, downscaling).
+ *          QOI intermediates are recognized by their magic bytes and decoded
+ *          by qoi_read(), raw pixel containers are mapped without decoding,
+ *          Netpbm images are read by pnm_load(), all other formats are
+ *          decoded by stb_image from a sequentially read mapping of the file.
+ */
+#include "functions.h"
+
+#define EXIF_ORIENTATION_TAG 0x0112 ///< TIFF tag holding the orientation
+#define EXIF_READ_LIMIT 4096        ///< Bytes of the EXIF segment searched for the tag
+#define JPEG_MAX_SCALE_SHIFT 3      ///< Deepest DCT-domain reduction (1/8)
+
+#define SOURCE_STB 0 ///< Any format stb_image decodes
+#define SOURCE_RAW 1 ///< Raw pixel container, mapped
+#define SOURCE_QOI 2 ///< QOI
+#define SOURCE_PNM 3 ///< Netpbm (P1-P7)
+
+static const char* prefetched_path;         ///< Input whose bytes were read ahead, NULL for none
+static const unsigned char* prefetched_data; ///< Those bytes
+static size_t prefetched_size;              ///< Their number
+#pragma omp threadprivate(prefetched_path, prefetched_data, prefetched_size)
+
+/**
+ * @brief Reads a 16-bit value from a TIFF block
+ * @param p Pointer to the value
+ * @param big_endian Non-zero for Motorola ("MM") byte order
+ * @return Value
+ */
+static unsigned read_u16(const unsigned char* p, int big_endian)
+{
+    return big_endian ? (unsigned)(p[0] << 8 | p[1]) : (unsigned)(p[1] << 8 | p[0]);
+}
+
+/**
+ * @brief Reads a 32-bit value from a TIFF block
+ * @param p Pointer to the value
+ * @param big_endian Non-zero for Motorola ("MM") byte order
+ * @return Value
+ */
+static unsigned long read_u32(const unsigned char* p, int big_endian)
+{
+    return big_endian ? ((unsigned long)read_u16(p, 1) << 16 | read_u16(p + 2, 1))
+                      : ((unsigned long)read_u16(p + 2, 0) << 16 | read_u16(p, 0));
+}
+
+/**
+ * @brief Finds the orientation tag in an EXIF block
+ * @param exif APP1 segment payload starting with "Exif\0\0"
+ * @param length Number of payload bytes available
+ * @return Orientation (1-8), 1 if the tag is missing or invalid,
+ *         0 if the segment is not EXIF
+ */
+static int parse_exif_orientation(const unsigned char* exif, size_t length)
+{
+    if (length < 6 || memcmp(exif, "Exif\0\0", 6) != 0)
+    {
+        return 0;
+    }
+    if (length < 14)
+    {
+        return 1;
+    }
+
+    // TIFF header: byte order, magic 42, offset of the first IFD
+    const unsigned char* tiff = exif + 6;
+    size_t size = length - 6;
+    int big_endian;
+    if (tiff[0] == 'M' && tiff[1] == 'M')
+    {
+        big_endian = 1;
+    }
+    else if (tiff[0] == 'I' && tiff[1] == 'I')
+    {
+        big_endian = 0;
+    }
+    else
+    {
+        return 1;
+    }
+    if (read_u16(tiff + 2, big_endian) != 42)
+    {
+        return 1;
+    }
+
+    unsigned long ifd = read_u32(tiff + 4, big_endian);
+    if (ifd > size - 2)
+    {
+        return 1;
+    }
+
+    // IFD0 entries: tag, type, count, value (12 bytes each)
+    unsigned entries = read_u16(tiff + ifd, big_endian);
+    for (unsigned i = 0; i < entries; i++)
+    {
+        size_t entry = ifd + 2 + (size_t)i * 12;
+        if (entry + 12 > size)
+        {
+            break;
+        }
+        if (read_u16(tiff + entry, big_endian) == EXIF_ORIENTATION_TAG)
+        {
+            unsigned orientation = read_u16(tiff + entry + 8, big_endian);
+            return orientation >= 1 && orientation <= 8 ? (int)orientation : 1;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Reads the EXIF orientation of a JPEG file
+ * @param file Open image file positioned at its start
+ * @return Orientation (1-8), 1 if the file is not a JPEG or has no tag
+ *
+ * @note Only the application segments in front of the image data are
+ *       looked at. Other formats are recognized by their first two bytes,
+ *       so files without EXIF cost a couple of reads. The file position is
+ *       undefined afterwards.
+ */
+static int read_orientation(FILE* file)
+{
+    unsigned char marker[4];
+    if (fread(marker, 1, 2, file) != 2 || marker[0] != 0xFF || marker[1] != 0xD8)
+    {
+        return 1;
+    }
+
+    for (;;)
+    {
+        if (fread(marker, 1, 4, file) != 4 || marker[0] != 0xFF)
+        {
+            return 1;
+        }
+
+        // EXIF lives in APP1, application segments come before everything else
+        int type = marker[1];
+        size_t length = (size_t)(marker[2] << 8 | marker[3]);
+        if (type < 0xE0 || type > 0xEF || length < 2)
+        {
+            return 1;
+        }
+        length -= 2;
+
+        // The orientation is in IFD0 right after the TIFF header, so only the
+        // start of the segment is read (the rest is mostly the thumbnail)
+        if (type == 0xE1)
+        {
+            unsigned char exif[EXIF_READ_LIMIT];
+            size_t count = length < EXIF_READ_LIMIT ? length : EXIF_READ_LIMIT;
+            if (fread(exif, 1, count, file) != count)
+            {
+                return 1;
+            }
+            int orientation = parse_exif_orientation(exif, count);
+            // Another APP1 block (XMP) may come first, keep looking if not EXIF
+            if (orientation)
+            {
+                return orientation;
+            }
+            length -= count;
+        }
+
+        if (fseek(file, (long)length, SEEK_CUR) != 0)
+        {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief Moves a rectangle of decoded pixels to where orient_image() puts it
+ * @param area Rectangle {x, y, width, height}, updated in place
+ * @param width Decoded image width in pixels
+ * @param height Decoded image height in pixels
+ * @param orientation EXIF orientation (1-8)
+ */
+static void orient_area(double* area, int width, int height, int orientation)
+{
+    // Mirrors first, in decoded coordinates (same table as orient_image())
+    int flip_x = orientation == 2 || orientation == 3 || orientation == 7 || orientation == 8;
+    int flip_y = orientation == 3 || orientation == 4 || orientation == 6 || orientation == 7;
+    if (flip_x)
+    {
+        area[0] = width - area[0] - area[2];
+    }
+    if (flip_y)
+    {
+        area[1] = height - area[1] - area[3];
+    }
+
+    // Orientations 5-8 swap the axes
+    if (orientation >= 5)
+    {
+        double swap = area[0];
+        area[0] = area[1];
+        area[1] = swap;
+        swap = area[2];
+        area[2] = area[3];
+        area[3] = swap;
+    }
+}
+
+/**
+ * @brief Recognizes the formats read without stb_image by their header
+ * @param file File positioned at its start, rewound on return
+ * @return SOURCE_RAW, SOURCE_QOI, SOURCE_PNM, or SOURCE_STB for all other data
+ */
+static int detect_source(FILE* file)
+{
+    int width, height, channels;
+    int source = SOURCE_STB;
+    if (raw_info(file, &width, &height, &channels))
+    {
+        source = SOURCE_RAW;
+    }
+    rewind(file);
+    if (source == SOURCE_STB && qoi_info(file, &width, &height, &channels))
+    {
+        source = SOURCE_QOI;
+    }
+    rewind(file);
+    // A Netpbm header pnm_info() rejects (maxval 0, huge size) must fail
+    // rather than go to stb_image, which is more lenient
+    if (source == SOURCE_STB && pnm_test(file))
+    {
+        source = SOURCE_PNM;
+    }
+    rewind(file);
+    return source;
+}
+
+/**
+ * @brief Loads an image and turns it upright according to its EXIF orientation
+ * @param path Path to the image file, "-" for stdin
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free_image(), NULL on error
+ *
+ * @details The orientation is read from the header of the opened file, then
+ *          stb_image decodes the file from a read-only mapping (or from the
+ *          rewound stream for stdin and files that cannot be mapped). Images
+ *          without the tag (or with orientation 1) are returned as decoded.
+ */
+unsigned char* load_image(const char* path, int* width, int* height, int* channels)
+{
+    return load_image_scaled(path, width, height, channels, 0, 0, NULL);
+}
+
+/**
+ * @brief Loads an image reduced during decoding when it is larger than needed
+ * @param path Path to the image file, "-" for stdin
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @param min_width Smallest upright width the caller needs, 0 for any
+ * @param min_height Smallest upright height the caller needs, 0 for any
+ * @param area Output (may be NULL): rectangle {x, y, width, height} of the
+ *             returned pixels covered by the image, see the note below
+ * @return Image data released with free_image(), NULL on error
+ *
+ * @details JPEG images are decoded at 1/2, 1/4 or 1/8 of their size when the
+ *          result still covers min_width x min_height. The reduction happens
+ *          in the DCT domain (a smaller IDCT per 8x8 block), so the full-size
+ *          image is never produced. Other formats (including QOI) are decoded
+ *          at full size.
+ *
+ * @note The returned size is the full size divided by the chosen power of two,
+ *       rounded up: when the full size is not a multiple of it, the last
+ *       column or row only partly lies inside the image. area gives the exact
+ *       extent (the full size divided by the reduction, after orientation it
+ *       may start at a fraction of a pixel), so resampling from it with
+ *       resample_area() keeps the geometry of a full-size decode.
+ */
+unsigned char* load_image_scaled(const char* path, int* width, int* height, int* channels,
+                                 int min_width, int min_height, double* area)
+{
+    FILE* file = open_image_stream(path);
+    if (!file)
+    {
+        return NULL;
+    }
+
+    int orientation = 1;
+    int shift = 0;
+    int full_width, full_height, full_channels;
+    unsigned char* image;
+    int source = detect_source(file);
+    if (source == SOURCE_RAW)
+    {
+        // Raw pixels are used straight from the mapped file, stdin and pipes are copied
+        image = strcmp(path, "-") != 0 ? raw_load(path, width, height, channels) : NULL;
+        if (!image)
+        {
+            image = raw_read(file, width, height, channels);
+        }
+    }
+    else if (source == SOURCE_QOI)
+    {
+        // QOI has no EXIF block and is always decoded at full size
+        image = qoi_read(file, width, height, channels);
+    }
+    else if (source == SOURCE_PNM)
+    {
+        // Netpbm in all its variants (stb_image only reads raw 8-bit P5/P6)
+        image = pnm_load(file, width, height, channels);
+    }
+    else
+    {
+        // Only the JPEG decoder can reduce while decoding, it starts with the SOI marker
+        unsigned char soi[2];
+        int jpeg = fread(soi, 1, 2, file) == 2 && soi[0] == 0xFF && soi[1] == 0xD8;
+        rewind(file);
+        orientation = read_orientation(file);
+        rewind(file);
+
+        // Regular files are decoded straight from a mapping (or from the bytes
+        // a batch read ahead) instead of being copied through stdio into the
+        // decoder's buffer; stb_image takes the length as an int, larger files
+        // and stdin keep using the stream
+        size_t size = 0;
+        unsigned char* mapping = NULL;
+        const unsigned char* data = NULL;
+        if (prefetched_path && strcmp(prefetched_path, path) == 0)
+        {
+            data = prefetched_data;
+            size = prefetched_size;
+        }
+        else if (strcmp(path, "-") != 0)
+        {
+            data = mapping = map_file_sequential(path, &size);
+        }
+        if (data && size > INT_MAX)
+        {
+            if (mapping)
+            {
+                unmap_file(mapping, size);
+            }
+            data = mapping = NULL;
+        }
+
+        // Largest reduction that keeps the image at least as large as required
+        if (jpeg && (min_width > 0 || min_height > 0) &&
+            (data ? stbi_info_from_memory(data, (int)size, &full_width, &full_height, &full_channels)
+                  : stbi_info_from_file(file, &full_width, &full_height, &full_channels)))
+        {
+            // Decoding happens before orientation, 5-8 swap the axes
+            int need_width = orientation >= 5 ? min_height : min_width;
+            int need_height = orientation >= 5 ? min_width : min_height;
+            while (shift < JPEG_MAX_SCALE_SHIFT)
+            {
+                int next = shift + 1;
+                int reduced_width = (int)(((long long)full_width + (1 << next) - 1) >> next);
+                int reduced_height = (int)(((long long)full_height + (1 << next) - 1) >> next);
+                if (reduced_width < need_width || reduced_height < need_height)
+                {
+                    break;
+                }
+                shift = next;
+            }
+        }
+
+        stbi_set_jpeg_scale_shift_thread(shift);
+        image = data ? stbi_load_from_memory(data, (int)size, width, height, channels, 0)
+                     : stbi_load_from_file(file, width, height, channels, 0);
+        stbi_set_jpeg_scale_shift_thread(0);
+        if (mapping)
+        {
+            unmap_file(mapping, size);
+        }
+    }
+    fclose(file);
+    if (!image)
+    {
+        return NULL;
+    }
+
+    // Covered extent as decoded, the partial pixels are on the right and bottom;
+    // the size actually decoded decides, in case the decoder did not reduce
+    if (shift && *width == full_width && *height == full_height)
+    {
+        shift = 0;
+    }
+    if (area)
+    {
+        area[0] = 0;
+        area[1] = 0;
+        area[2] = shift ? (double)full_width / (1 << shift) : *width;
+        area[3] = shift ? (double)full_height / (1 << shift) : *height;
+        orient_area(area, *width, *height, orientation);
+    }
+    if (orientation == 1)
+    {
+        return image;
+    }
+
+    int upright_width, upright_height;
+    unsigned char* upright = orient_image(image, *width, *height, *channels, orientation,
+                                          &upright_width, &upright_height);
+    stbi_image_free(image);
+    if (!upright)
+    {
+        return NULL;
+    }
+
+    *width = upright_width;
+    *height = upright_height;
+    return upright;
+}
+
+/**
+ * @brief Gives the loader the bytes of an input read ahead (batch mode)
+ * @param path Input path the bytes belong to, NULL to stop using them
+ * @param data File contents (kept by the caller until it calls this with NULL)
+ * @param size Number of bytes
+ *
+ * @details The setting is per thread, so every batch worker hands over the
+ *          file it is processing. Only formats decoded by stb_image use the
+ *          bytes; the header is still probed through the file, which the
+ *          read ahead has brought into the page cache.
+ */
+void use_prefetched_input(const char* path, const unsigned char* data, size_t size)
+{
+    prefetched_path = path;
+    prefetched_data = data;
+    prefetched_size = size;
+}
+
+/**
+ * @brief Releases an image returned by load_image() or load_image_scaled()
+ * @param image Image data (may be NULL)
+ *
+ * @details Mapped raw images are unmapped, decoded images are freed.
+ */
+void free_image(unsigned char* image)
+{
+    if (image && !release_mapped_image(image))
+    {
+        stbi_image_free(image);
+    }
+}
+
+/**
+ * @brief Reads the size of an upright image without decoding pixels
+ * @param path Path to the image file, "-" for stdin
+ * @param width Output: image width in pixels after orientation
+ * @param height Output: image height in pixels after orientation
+ * @param channels Output: number of color channels
+ * @return 1 on success, 0 on error (same convention as stbi_info)
+ */
+int image_info(const char* path, int* width, int* height, int* channels)
+{
+    FILE* file = open_image_stream(path);
+    if (!file)
+    {
+        return 0;
+    }
+
+    int source = detect_source(file);
+    if (source != SOURCE_STB)
+    {
+        int ok = source == SOURCE_RAW   ? raw_info(file, width, height, channels)
+                 : source == SOURCE_QOI ? qoi_info(file, width, height, channels)
+                                        : pnm_info(file, width, height, channels);
+        fclose(file);
+        return ok;
+    }
+    int orientation = read_orientation(file);
+    rewind(file);
+    int ok = stbi_info_from_file(file, width, height, channels);
+    fclose(file);
+
+    // Orientations 5-8 swap the axes
+    if (ok && orientation >= 5)
+    {
+        int swap = *width;
+        *width = *height;
+        *height = swap;
+    }
+    return ok;
+}
@@ -0,0 +1,428 @@
+/**
+ * @file image_writer.c
+ * @brief Implementation of image saving through a registry of output formats
+ *
+ * @details Every operation saves its result with save_image(). The format is
+ *          chosen by the extension of the output path (case-insensitive), or
+ *          by --format for "-" (stdout); the encoder settings come from the
+ *          write options, which are set once from the command line.
+ */
+#include "functions.h"
+
+#define DEFAULT_JPEG_QUALITY 90 ///< Visually lossless for photos, a third of the size of 100
+#define DEFAULT_PNG_LEVEL 6     ///< Same default as zlib
+
+/**
+ * @brief Encoder settings used by save_image()
+ */
+static struct
+{
+    int jpeg_quality;     ///< JPEG quality 1-100
+    int jpeg_subsampling; ///< -1 automatic (4:2:0 up to quality 90), 0 - 4:4:4, 1 - 4:2:0
+    int png_level;        ///< PNG compression level 0-9
+    char format[8];       ///< Extension of the format written to stdout, empty if not given
+} options = {DEFAULT_JPEG_QUALITY, -1, DEFAULT_PNG_LEVEL, ""};
+
+/**
+ * @brief Encoder of one output format
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param data Image data
+ * @param stride Distance between rows in bytes (width * channels unless the
+ *               format entry accepts strided rows)
+ * @return Non-zero on success, 0 on error (stb_image_write convention)
+ */
+typedef int (*format_writer)(FILE* file, int width, int height, int channels,
+                             const unsigned char* data, int stride);
+
+/**
+ * @brief Encoder that creates the output file itself (e.g. through a mapping)
+ * @param path Output file path
+ * @return Non-zero on success, 0 on error
+ */
+typedef int (*path_writer)(const char* path, int width, int height, int channels,
+                           const unsigned char* data, int stride);
+
+/**
+ * @brief Output format known to save_image()
+ */
+typedef struct
+{
+    const char* extension; ///< Lowercase extension without the dot
+    format_writer write;    ///< Encoder
+    int strided;            ///< Non-zero if the encoder accepts any row stride
+    path_writer write_path; ///< Encoder used instead of write for files, NULL if none
+} image_format;
+
+/**
+ * @brief Forwards stb_image_write output to a stream
+ */
+static void write_to_stream(void* context, void* data, int size)
+{
+    fwrite(data, 1, (size_t)size, (FILE*)context);
+}
+
+static int write_png(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    return png_write(file, width, height, channels, data, stride, options.png_level);
+}
+
+static int write_jpg(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    return jpeg_write(file, width, height, channels, data, stride, options.jpeg_quality,
+                      options.jpeg_subsampling);
+}
+
+static int write_pgm(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    return pnm_write(file, width, height, channels, data, stride, PNM_PGM);
+}
+
+static int write_ppm(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    return pnm_write(file, width, height, channels, data, stride, PNM_PPM);
+}
+
+static int write_pnm(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    return pnm_write(file, width, height, channels, data, stride, PNM_AUTO);
+}
+
+static int write_pam(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    return pnm_write(file, width, height, channels, data, stride, PNM_PAM);
+}
+
+static int write_bmp(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    (void)stride;
+    return stbi_write_bmp_to_func(write_to_stream, file, width, height, channels, data);
+}
+
+static int write_tga(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    (void)stride;
+    return stbi_write_tga_to_func(write_to_stream, file, width, height, channels, data);
+}
+
+/**
+ * @brief Saves Radiance HDR, converting 8-bit values to linear light
+ *
+ * @note Color channels use the gamma 2.2 curve stb_image applies when it
+ *       loads 8-bit images as float, so a saved image loads back the same
+ */
+static int write_hdr(FILE* file, int width, int height, int channels,
+                     const unsigned char* data, int stride)
+{
+    (void)stride;
+    size_t size = image_size(width, height, channels);
+    float* linear = size ? (float*)malloc(size * sizeof(float)) : NULL;
+    if (!linear)
+    {
+        return 0;
+    }
+
+    // Alpha (the last channel of 2 and 4 channel images) stays linear
+    int color = channels % 2 ? channels : channels - 1;
+    float curve[256];
+    for (int v = 0; v < 256; v++)
+    {
+        curve[v] = (float)pow(v / 255.0, 2.2);
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        linear[i] = (int)(i % channels) < color ? curve[data[i]] : data[i] / 255.0f;
+    }
+
+    int res = stbi_write_hdr_to_func(write_to_stream, file, width, height, channels, linear);
+    free(linear);
+    return res;
+}
+
+static const image_format formats[] = {
+    {"png", write_png, 1, NULL},
+    {"jpg", write_jpg, 1, NULL},
+    {"jpeg", write_jpg, 1, NULL},
+    {"qoi", qoi_write, 1, NULL},
+    {"raw", raw_write_stream, 1, raw_write},
+    {"pgm", write_pgm, 1, NULL},
+    {"ppm", write_ppm, 1, NULL},
+    {"pnm", write_pnm, 1, NULL},
+    {"pam", write_pam, 1, NULL},
+    {"bmp", write_bmp, 0, NULL},
+    {"tga", write_tga, 0, NULL},
+    {"hdr", write_hdr, 0, NULL},
+};
+
+/**
+ * @brief Compares two strings ignoring ASCII case
+ * @param a First string
+ * @param b Second string (lowercase)
+ * @return Non-zero if equal
+ */
+static int equal_ignore_case(const char* a, const char* b)
+{
+    for (; *a && *b; a++, b++)
+    {
+        char c = *a >= 'A' && *a <= 'Z' ? (char)(*a - 'A' + 'a') : *a;
+        if (c != *b)
+        {
+            return 0;
+        }
+    }
+    return *a == *b;
+}
+
+/**
+ * @brief Finds an output format by its extension
+ * @param extension Extension without the dot, any case
+ * @return Format entry, NULL if unknown
+ */
+static const image_format* find_extension(const char* extension)
+{
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        if (equal_ignore_case(extension, formats[i].extension))
+        {
+            return &formats[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds the output format of a path
+ * @param path Output file path, "-" for stdout
+ * @return Format entry, NULL if the extension is missing or unknown
+ *
+ * @note Only the extension of the file name counts: "out.png/result.jpg"
+ *       is a JPEG, "photo.png.bak" is unknown. stdout uses --format.
+ */
+static const image_format* find_format(const char* path)
+{
+    if (strcmp(path, "-") == 0)
+    {
+        return find_extension(options.format);
+    }
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    const char* backslash = strrchr(path, '\\');
+    if (!dot || (slash && slash > dot) || (backslash && backslash > dot))
+    {
+        return NULL;
+    }
+    return find_extension(dot + 1);
+}
+
+/**
+ * @brief Prints the list of output formats
+ * @param prefix Text in front of every name ("." or "")
+ */
+static void print_formats(const char* prefix)
+{
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        printf("%s%s%s", i == 0 ? "" : i + 1 == sizeof(formats) / sizeof(formats[0]) ? " or " : ", ", prefix,
+               formats[i].extension);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Runs the encoder of a format on a file or on stdout
+ * @return Non-zero on success, 0 on error
+ *
+ * @details A file that could not be written completely is removed, so a
+ *          failed command does not leave a truncated image behind.
+ */
+static int write_output(const image_format* format, const char* path, int width, int height, int channels,
+                        const unsigned char* data, int stride)
+{
+    int to_stdout = strcmp(path, "-") == 0;
+    if (!to_stdout && format->write_path)
+    {
+        return format->write_path(path, width, height, channels, data, stride);
+    }
+
+    FILE* file = to_stdout ? image_stdout() : fopen(path, "wb");
+    if (!file)
+    {
+        return 0;
+    }
+    int res = format->write(file, width, height, channels, data, stride) && !ferror(file);
+    if (to_stdout)
+    {
+        return fflush(file) == 0 && res;
+    }
+    res = fclose(file) == 0 && res;
+    if (!res)
+    {
+        remove(path);
+    }
+    return res;
+}
+
+/**
+ * @brief Saves an image in the format given by the path extension
+ * @param path Output file path (.png, .jpg/.jpeg, .qoi, .raw, .pgm, .ppm, .pnm, .pam, .bmp, .tga
+ *             or .hdr), "-" to write to stdout in the format set with --format
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param data Image data
+ * @param stride Distance between rows in bytes, 0 for width * channels
+ * @return 0 on success, -1 on error (the error is printed)
+ *
+ * @details Strided data (e.g. a crop inside a larger image) is passed as is
+ *          to formats that support it, other formats get a packed copy.
+ */
+int save_image(const char* path, int width, int height, int channels,
+               const unsigned char* data, int stride)
+{
+    const image_format* format = find_format(path);
+    if (!format)
+    {
+        if (strcmp(path, "-") == 0)
+        {
+            printf("Output to stdout needs --format=FORMAT, one of ");
+            print_formats("");
+        }
+        else
+        {
+            printf("Unsupported format. Use ");
+            print_formats(".");
+        }
+        return -1;
+    }
+
+    int packed = width * channels;
+    if (stride == 0)
+    {
+        stride = packed;
+    }
+
+    int res;
+    if (stride == packed || format->strided)
+    {
+        res = write_output(format, path, width, height, channels, data, stride);
+    }
+    else
+    {
+        unsigned char* copy = alloc_image(width, height, channels);
+        if (!copy)
+        {
+            printf("Error: Memory allocation failed!\n");
+            return -1;
+        }
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(copy + (size_t)y * packed, data + (size_t)y * stride, (size_t)packed);
+        }
+        res = write_output(format, path, width, height, channels, copy, packed);
+        free(copy);
+    }
+
+    if (!res)
+    {
+        printf("Error writing image\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Applies one encoder option given on the command line
+ * @param arg "--quality=1..100", "--subsampling=420|444|auto", "--png-level=0..9" or
+ *            "--format=extension" (format of images written to stdout)
+ * @return 0 on success, -1 on unknown option or invalid value (the error is printed)
+ */
+int parse_write_option(const char* arg)
+{
+    const char* value = strchr(arg, '=');
+    if (!value)
+    {
+        printf("Error: Option %s needs a value (--name=value)!\n", arg);
+        return -1;
+    }
+    size_t name_length = (size_t)(value - arg);
+    value++;
+
+    char* end;
+    long number = strtol(value, &end, 10);
+    int is_number = *value && !*end;
+
+    if (name_length == 9 && strncmp(arg, "--quality", 9) == 0)
+    {
+        if (!is_number || number < 1 || number > 100)
+        {
+            printf("Error: JPEG quality must be 1-100!\n");
+            return -1;
+        }
+        options.jpeg_quality = (int)number;
+    }
+    else if (name_length == 13 && strncmp(arg, "--subsampling", 13) == 0)
+    {
+        if (strcmp(value, "420") == 0) options.jpeg_subsampling = 1;
+        else if (strcmp(value, "444") == 0) options.jpeg_subsampling = 0;
+        else if (strcmp(value, "auto") == 0) options.jpeg_subsampling = -1;
+        else
+        {
+            printf("Error: Subsampling must be 420, 444 or auto!\n");
+            return -1;
+        }
+    }
+    else if (name_length == 11 && strncmp(arg, "--png-level", 11) == 0)
+    {
+        if (!is_number || number < 0 || number > 9)
+        {
+            printf("Error: PNG level must be 0-9!\n");
+            return -1;
+        }
+        options.png_level = (int)number;
+    }
+    else if (name_length == 8 && strncmp(arg, "--format", 8) == 0)
+    {
+        if (!find_extension(value))
+        {
+            printf("Error: Unknown format %s, use ", value);
+            print_formats("");
+            return -1;
+        }
+        strcpy(options.format, find_extension(value)->extension);
+    }
+    else
+    {
+        printf("Error: Unknown option %.*s!\n", (int)name_length, arg);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Gives the extension set with --format
+ * @return Extension without the dot, empty if --format was not given
+ */
+const char* output_format(void)
+{
+    return options.format;
+}
+
+/**
+ * @brief Checks whether save_image() can write a path
+ * @param path Output file path
+ * @return Non-zero if the extension (or --format for "-") names an output format
+ */
+int has_output_format(const char* path)
+{
+    return find_format(path) != NULL;
+}
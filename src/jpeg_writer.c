@@ -0,0 +1,680 @@
+/**
+ * @file jpeg_writer.c
+ * @brief Implementation of a multithreaded baseline JPEG encoder
+ *
+ * @details Every row of MCUs (8 or 16 pixel rows) is a restart interval: the
+ *          DC predictions restart at its beginning and its entropy coded data
+ *          ends on a byte boundary. Rows are therefore independent and are
+ *          color converted, transformed, quantized and Huffman coded in
+ *          parallel into separate buffers, which are joined with RST markers.
+ */
+#include "functions.h"
+
+#define CONST_BITS 13   ///< Fixed point precision of the DCT constants
+#define INPUT_SHIFT 2   ///< Fractional bits of the samples (color conversion and DCT input)
+#define MIN_BLOCK_SPACE 512 ///< Output bytes that always fit one block, including stuffing
+
+#define FIX(x) ((int)((x) * (1 << CONST_BITS) + 0.5))
+#define MULTIPLY(v, c) (((v) * (c) + (1 << (CONST_BITS - 1))) >> CONST_BITS)
+
+/// Natural order index of every zigzag position
+static const unsigned char zigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+/// Example quantization tables of the JPEG standard (Annex K), natural order
+static const unsigned char luma_quant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+static const unsigned char chroma_quant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+/// Typical Huffman tables of the JPEG standard: code counts per length 1-16, then symbols
+static const unsigned char dc_luma_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const unsigned char dc_chroma_bits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const unsigned char dc_values[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char ac_luma_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const unsigned char ac_luma_values[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+static const unsigned char ac_chroma_bits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const unsigned char ac_chroma_values[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+
+/// AAN output scale of every frequency (cos(k * pi / 16) * sqrt(2), 1 for k = 0) times sqrt(8)
+static const double aan_scale[8] = {
+    1.0 * 2.828427125, 1.387039845 * 2.828427125, 1.306562965 * 2.828427125, 1.175875602 * 2.828427125,
+    1.0 * 2.828427125, 0.785694958 * 2.828427125, 0.541196100 * 2.828427125, 0.275899379 * 2.828427125};
+
+/**
+ * @brief Huffman code and length of every symbol
+ */
+typedef struct
+{
+    unsigned short code[256];
+    unsigned char size[256];
+} huffman_table;
+
+/**
+ * @brief Per-component coding tables
+ */
+typedef struct
+{
+    float quant[64];          ///< Reciprocal quantizer with the AAN scale folded in, natural order
+    const huffman_table* dc;  ///< DC Huffman table
+    const huffman_table* ac;  ///< AC Huffman table
+} component_tables;
+
+/**
+ * @brief Builds the canonical Huffman codes of a table given as counts per length
+ */
+static void build_huffman(const unsigned char* bits, const unsigned char* values, huffman_table* table)
+{
+    int code = 0, k = 0;
+    memset(table, 0, sizeof(*table));
+    for (int length = 1; length <= 16; length++)
+    {
+        for (int i = 0; i < bits[length - 1]; i++, k++)
+        {
+            table->code[values[k]] = (unsigned short)code++;
+            table->size[values[k]] = (unsigned char)length;
+        }
+        code <<= 1;
+    }
+}
+
+/**
+ * @brief Scales a standard quantization table to a quality (libjpeg formula)
+ * @param base Standard table, natural order
+ * @param quality Quality 1-100
+ * @param table Receives the scaled table, natural order
+ */
+static void scale_quant(const unsigned char* base, int quality, unsigned char* table)
+{
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; i++)
+    {
+        int q = (base[i] * scale + 50) / 100;
+        table[i] = (unsigned char)(q < 1 ? 1 : q > 255 ? 255 : q);
+    }
+}
+
+/**
+ * @brief Forward DCT of one block, integer AAN algorithm
+ * @param block Samples centered on 0 on input, AAN scaled coefficients on output
+ *
+ * @note The outputs still carry the AAN scale factors (and the input shift),
+ *       which are folded into the quantizer reciprocals
+ */
+static void forward_dct(int* block)
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // First pass over rows (step 1 between samples), second over columns
+        int step = pass == 0 ? 1 : 8;
+        int next = pass == 0 ? 8 : 1;
+        for (int line = 0; line < 8; line++)
+        {
+            int* d = block + line * next;
+            int tmp0 = d[0] + d[7 * step], tmp7 = d[0] - d[7 * step];
+            int tmp1 = d[step] + d[6 * step], tmp6 = d[step] - d[6 * step];
+            int tmp2 = d[2 * step] + d[5 * step], tmp5 = d[2 * step] - d[5 * step];
+            int tmp3 = d[3 * step] + d[4 * step], tmp4 = d[3 * step] - d[4 * step];
+
+            // Even part
+            int tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+            int tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+            d[0] = tmp10 + tmp11;
+            d[4 * step] = tmp10 - tmp11;
+            int z1 = MULTIPLY(tmp12 + tmp13, FIX(0.707106781));
+            d[2 * step] = tmp13 + z1;
+            d[6 * step] = tmp13 - z1;
+
+            // Odd part
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+            int z5 = MULTIPLY(tmp10 - tmp12, FIX(0.382683433));
+            int z2 = MULTIPLY(tmp10, FIX(0.541196100)) + z5;
+            int z4 = MULTIPLY(tmp12, FIX(1.306562965)) + z5;
+            int z3 = MULTIPLY(tmp11, FIX(0.707106781));
+            int z11 = tmp7 + z3, z13 = tmp7 - z3;
+            d[5 * step] = z13 + z2;
+            d[3 * step] = z13 - z2;
+            d[step] = z11 + z4;
+            d[7 * step] = z11 - z4;
+        }
+    }
+}
+
+/**
+ * @brief Entropy coded output of one restart interval
+ */
+typedef struct
+{
+    unsigned char* data;     ///< Bytes with 0xFF stuffing applied
+    size_t size;             ///< Bytes written
+    size_t capacity;         ///< Allocated bytes
+    unsigned long long bits; ///< Pending bits, most significant first
+    int count;               ///< Number of pending bits
+} jpeg_segment;
+
+/**
+ * @brief Makes sure a whole block fits without further checks
+ * @return 0 on success, -1 on allocation failure
+ */
+static int reserve_block(jpeg_segment* s)
+{
+    if (s->size + MIN_BLOCK_SPACE <= s->capacity)
+    {
+        return 0;
+    }
+    size_t capacity = s->capacity * 2 + MIN_BLOCK_SPACE;
+    unsigned char* data = (unsigned char*)realloc(s->data, capacity);
+    if (!data)
+    {
+        return -1;
+    }
+    s->data = data;
+    s->capacity = capacity;
+    return 0;
+}
+
+static void put_bits(jpeg_segment* s, unsigned int value, int n)
+{
+    s->bits = (s->bits << n) | value;
+    s->count += n;
+    if (s->count >= 32)
+    {
+        unsigned int word = (unsigned int)(s->bits >> (s->count - 32));
+        unsigned char* out = s->data + s->size;
+        // Fast path: no 0xFF byte in the word (no zero byte in its complement), nothing to stuff
+        if ((((~word) - 0x01010101u) & word & 0x80808080u) == 0)
+        {
+            out[0] = (unsigned char)(word >> 24);
+            out[1] = (unsigned char)(word >> 16);
+            out[2] = (unsigned char)(word >> 8);
+            out[3] = (unsigned char)word;
+            s->size += 4;
+            s->count -= 32;
+            return;
+        }
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            unsigned char byte = (unsigned char)(word >> shift);
+            s->data[s->size++] = byte;
+            if (byte == 0xFF)
+            {
+                s->data[s->size++] = 0;
+            }
+        }
+        s->count -= 32;
+    }
+}
+
+/**
+ * @brief Pads the segment with 1 bits to a byte boundary and writes out all pending bits
+ */
+static void flush_segment(jpeg_segment* s)
+{
+    int pad = (8 - s->count % 8) % 8;
+    s->bits = (s->bits << pad) | ((1u << pad) - 1);
+    s->count += pad;
+    while (s->count > 0)
+    {
+        unsigned char byte = (unsigned char)(s->bits >> (s->count - 8));
+        s->data[s->size++] = byte;
+        if (byte == 0xFF)
+        {
+            s->data[s->size++] = 0;
+        }
+        s->count -= 8;
+    }
+}
+
+/**
+ * @brief Number of bits of the magnitude of a value (JPEG category)
+ */
+static int magnitude_bits(int v)
+{
+    unsigned int a = (unsigned int)(v < 0 ? -v : v);
+    int n = 0;
+    while (a)
+    {
+        n++;
+        a >>= 1;
+    }
+    return n;
+}
+
+/**
+ * @brief Transforms, quantizes and codes one 8x8 block
+ * @param s Output segment
+ * @param block Samples centered on 0 (shifted by INPUT_SHIFT), destroyed
+ * @param tables Tables of the component
+ * @param dc_pred Previous DC value of the component, updated
+ * @return 0 on success, -1 on allocation failure
+ */
+static int encode_block(jpeg_segment* s, int* block, const component_tables* tables, int* dc_pred)
+{
+    if (reserve_block(s) != 0)
+    {
+        return -1;
+    }
+    forward_dct(block);
+
+    // Quantize in natural order (the loop vectorizes), then read in zigzag order.
+    // Rounding may push an AC value past the 10 bits the Huffman tables cover.
+    int quantized[64];
+    for (int i = 0; i < 64; i++)
+    {
+        float v = (float)block[i] * tables->quant[i];
+        int q = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+        quantized[i] = q < -1023 ? -1023 : q > 1023 ? 1023 : q;
+    }
+    quantized[0] = (int)(block[0] * tables->quant[0] + (block[0] < 0 ? -0.5f : 0.5f));
+
+    int diff = quantized[0] - *dc_pred;
+    *dc_pred = quantized[0];
+    int n = magnitude_bits(diff);
+    put_bits(s, tables->dc->code[n], tables->dc->size[n]);
+    if (n)
+    {
+        put_bits(s, (unsigned int)(diff < 0 ? diff - 1 : diff) & ((1u << n) - 1), n);
+    }
+
+    int run = 0;
+    for (int k = 1; k < 64; k++)
+    {
+        int v = quantized[zigzag[k]];
+        if (v == 0)
+        {
+            run++;
+            continue;
+        }
+        while (run >= 16)
+        {
+            put_bits(s, tables->ac->code[0xF0], tables->ac->size[0xF0]);
+            run -= 16;
+        }
+        n = magnitude_bits(v);
+        int symbol = (run << 4) | n;
+        put_bits(s, tables->ac->code[symbol], tables->ac->size[symbol]);
+        put_bits(s, (unsigned int)(v < 0 ? v - 1 : v) & ((1u << n) - 1), n);
+        run = 0;
+    }
+    if (run)
+    {
+        put_bits(s, tables->ac->code[0x00], tables->ac->size[0x00]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies an 8x8 block out of a sample plane
+ */
+static void load_block(const short* plane, int plane_width, int x, int* block)
+{
+    for (int y = 0; y < 8; y++)
+    {
+        const short* row = plane + (size_t)y * plane_width + x;
+        for (int i = 0; i < 8; i++)
+        {
+            block[y * 8 + i] = row[i];
+        }
+    }
+}
+
+/**
+ * @brief Encodes one row of MCUs as a restart interval
+ * @param data Image data
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param stride Distance between rows in bytes
+ * @param mcu_row Index of the MCU row
+ * @param mcu_size MCU size in pixels (8, or 16 for 4:2:0)
+ * @param planes Scratch: Y, Cb and Cr planes of mcu_size rows of the padded width,
+ *               samples centered on 0 with INPUT_SHIFT fractional bits
+ * @param tables Luma and chroma tables
+ * @param s Output segment
+ * @return 0 on success, -1 on allocation failure
+ *
+ * @details Pixels beyond the right and bottom edges repeat the last column
+ *          and row. Colors are converted with fixed point BT.601 (JFIF)
+ *          coefficients; 4:2:0 chroma is the average of 2x2 pixels.
+ */
+static int encode_mcu_row(const unsigned char* data, int width, int height, int channels, int stride,
+                          int mcu_row, int mcu_size, short* planes, const component_tables* tables,
+                          jpeg_segment* s)
+{
+    enum
+    {
+        SAMPLE_SHIFT = 16 - INPUT_SHIFT,
+        ROUND = 1 << (SAMPLE_SHIFT - 1),
+        CENTER = 128 << INPUT_SHIFT,
+        OFFSET = 128 << 16
+    };
+    int padded = (width + mcu_size - 1) / mcu_size * mcu_size;
+    short* plane_y = planes;
+    short* plane_cb = planes + (size_t)mcu_size * padded;
+    short* plane_cr = plane_cb + (size_t)mcu_size * padded;
+    int color = channels >= 3;
+
+    for (int y = 0; y < mcu_size; y++)
+    {
+        int source_y = mcu_row * mcu_size + y;
+        if (source_y >= height)
+        {
+            source_y = height - 1;
+        }
+        const unsigned char* row = data + (size_t)source_y * stride;
+        short* out_y = plane_y + (size_t)y * padded;
+        short* out_cb = plane_cb + (size_t)y * padded;
+        short* out_cr = plane_cr + (size_t)y * padded;
+        for (int x = 0; x < width; x++)
+        {
+            const unsigned char* p = row + (size_t)x * channels;
+            if (color)
+            {
+                // 16-bit fixed point coefficients, the offset keeps the sums positive for the shift
+                int r = p[0], g = p[1], b = p[2];
+                out_y[x] = (short)(((19595 * r + 38470 * g + 7471 * b + ROUND) >> SAMPLE_SHIFT) - CENTER);
+                out_cb[x] = (short)(((-11059 * r - 21709 * g + 32768 * b + OFFSET + ROUND) >> SAMPLE_SHIFT) - CENTER);
+                out_cr[x] = (short)(((32768 * r - 27439 * g - 5329 * b + OFFSET + ROUND) >> SAMPLE_SHIFT) - CENTER);
+            }
+            else
+            {
+                out_y[x] = (short)((p[0] - 128) * (1 << INPUT_SHIFT));
+            }
+        }
+        for (int x = width; x < padded; x++)
+        {
+            out_y[x] = out_y[width - 1];
+            if (color)
+            {
+                out_cb[x] = out_cb[width - 1];
+                out_cr[x] = out_cr[width - 1];
+            }
+        }
+    }
+
+    // 4:2:0: average 2x2 chroma into the top-left quarter of the planes
+    if (color && mcu_size == 16)
+    {
+        for (int y = 0; y < 8; y++)
+        {
+            for (int x = 0; x < padded / 2; x++)
+            {
+                const short* cb = plane_cb + (size_t)(2 * y) * padded + 2 * x;
+                const short* cr = plane_cr + (size_t)(2 * y) * padded + 2 * x;
+                plane_cb[(size_t)y * padded + x] = (short)((cb[0] + cb[1] + cb[padded] + cb[padded + 1] + 2) >> 2);
+                plane_cr[(size_t)y * padded + x] = (short)((cr[0] + cr[1] + cr[padded] + cr[padded + 1] + 2) >> 2);
+            }
+        }
+    }
+
+    int dc[3] = {0, 0, 0};
+    int block[64];
+    for (int x = 0; x < padded; x += mcu_size)
+    {
+        for (int by = 0; by < mcu_size; by += 8)
+        {
+            for (int bx = 0; bx < mcu_size; bx += 8)
+            {
+                load_block(plane_y + (size_t)by * padded, padded, x + bx, block);
+                if (encode_block(s, block, &tables[0], &dc[0]) != 0)
+                {
+                    return -1;
+                }
+            }
+        }
+        if (color)
+        {
+            int chroma_x = mcu_size == 16 ? x / 2 : x;
+            load_block(plane_cb, padded, chroma_x, block);
+            if (encode_block(s, block, &tables[1], &dc[1]) != 0)
+            {
+                return -1;
+            }
+            load_block(plane_cr, padded, chroma_x, block);
+            if (encode_block(s, block, &tables[1], &dc[2]) != 0)
+            {
+                return -1;
+            }
+        }
+    }
+    flush_segment(s);
+    return 0;
+}
+
+/**
+ * @brief Appends a marker segment header (marker and length) to a buffer
+ */
+static unsigned char* put_marker(unsigned char* p, int marker, int length)
+{
+    *p++ = 0xFF;
+    *p++ = (unsigned char)marker;
+    *p++ = (unsigned char)(length >> 8);
+    *p++ = (unsigned char)length;
+    return p;
+}
+
+/**
+ * @brief Writes an image as baseline JPEG using all threads
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4, alpha is dropped, 1 and 2
+ *                 channel images are saved as grayscale)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @param quality Quality 1-100
+ * @param subsampling Chroma subsampling: -1 automatic (4:2:0 up to quality
+ *                    90, 4:4:4 above), 0 - 4:4:4, 1 - 4:2:0
+ * @return Non-zero on success, 0 on error
+ *
+ * @details Uses the quantization and Huffman tables of the JPEG standard
+ *          scaled like libjpeg, so files match the previous encoder in size.
+ *          Each MCU row is a restart interval encoded by its own thread; the
+ *          rows are written in order with RST0-RST7 markers between them.
+ */
+int jpeg_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride,
+               int quality, int subsampling)
+{
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535 || channels < 1 || channels > 4)
+    {
+        return 0;
+    }
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+
+    int color = channels >= 3;
+    int subsample = subsampling >= 0 ? subsampling != 0 : quality <= 90;
+    int mcu_size = color && subsample ? 16 : 8;
+    int mcu_rows = (height + mcu_size - 1) / mcu_size;
+    int mcus_per_row = (width + mcu_size - 1) / mcu_size;
+    int padded = mcus_per_row * mcu_size;
+
+    // Tables: quantizers are written in zigzag order, reciprocals stay in natural order
+    unsigned char quant[2][64];
+    scale_quant(luma_quant, quality, quant[0]);
+    scale_quant(chroma_quant, quality, quant[1]);
+    huffman_table dc_luma, ac_luma, dc_chroma, ac_chroma;
+    build_huffman(dc_luma_bits, dc_values, &dc_luma);
+    build_huffman(ac_luma_bits, ac_luma_values, &ac_luma);
+    build_huffman(dc_chroma_bits, dc_values, &dc_chroma);
+    build_huffman(ac_chroma_bits, ac_chroma_values, &ac_chroma);
+    component_tables tables[2] = {{{0}, &dc_luma, &ac_luma}, {{0}, &dc_chroma, &ac_chroma}};
+    for (int t = 0; t < 2; t++)
+    {
+        for (int v = 0; v < 8; v++)
+        {
+            for (int u = 0; u < 8; u++)
+            {
+                tables[t].quant[v * 8 + u] =
+                    (float)(1.0 / (quant[t][v * 8 + u] * aan_scale[v] * aan_scale[u] * (1 << INPUT_SHIFT)));
+            }
+        }
+    }
+
+    jpeg_segment* segments = (jpeg_segment*)calloc((size_t)mcu_rows, sizeof(jpeg_segment));
+    if (!segments)
+    {
+        return 0;
+    }
+
+    int failed = 0;
+    #pragma omp parallel
+    {
+        short* planes = (short*)malloc((size_t)3 * mcu_size * padded * sizeof(short));
+        if (!planes)
+        {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int row = 0; row < mcu_rows; row++)
+        {
+            if (planes && encode_mcu_row(data, width, height, channels, stride, row, mcu_size, planes, tables,
+                                         &segments[row]) != 0)
+            {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        free(planes);
+    }
+
+    int ok = !failed;
+    if (ok)
+    {
+        int components = color ? 3 : 1;
+        unsigned char header[1024];
+        unsigned char* p = header;
+
+        // SOI and JFIF APP0 (version 1.1, aspect ratio 1:1, no thumbnail)
+        static const unsigned char jfif[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+        *p++ = 0xFF;
+        *p++ = 0xD8;
+        p = put_marker(p, 0xE0, 2 + (int)sizeof(jfif));
+        memcpy(p, jfif, sizeof(jfif));
+        p += sizeof(jfif);
+
+        // DQT
+        p = put_marker(p, 0xDB, color ? 2 + 2 * 65 : 2 + 65);
+        for (int t = 0; t < (color ? 2 : 1); t++)
+        {
+            *p++ = (unsigned char)t;
+            for (int k = 0; k < 64; k++)
+            {
+                *p++ = quant[t][zigzag[k]];
+            }
+        }
+
+        // SOF0: 8-bit samples, Y then Cb and Cr (chroma at quarter resolution for 4:2:0)
+        p = put_marker(p, 0xC0, 8 + 3 * components);
+        *p++ = 8;
+        *p++ = (unsigned char)(height >> 8);
+        *p++ = (unsigned char)height;
+        *p++ = (unsigned char)(width >> 8);
+        *p++ = (unsigned char)width;
+        *p++ = (unsigned char)components;
+        for (int c = 0; c < components; c++)
+        {
+            *p++ = (unsigned char)(c + 1);
+            *p++ = c == 0 && mcu_size == 16 ? 0x22 : 0x11;
+            *p++ = (unsigned char)(c == 0 ? 0 : 1);
+        }
+
+        // DHT
+        const unsigned char* bits[4] = {dc_luma_bits, ac_luma_bits, dc_chroma_bits, ac_chroma_bits};
+        const unsigned char* values[4] = {dc_values, ac_luma_values, dc_values, ac_chroma_values};
+        static const unsigned char classes[4] = {0x00, 0x10, 0x01, 0x11};
+        int tables_count = color ? 4 : 2;
+        int dht_length = 2;
+        for (int t = 0; t < tables_count; t++)
+        {
+            int symbols = 0;
+            for (int i = 0; i < 16; i++) symbols += bits[t][i];
+            dht_length += 17 + symbols;
+        }
+        p = put_marker(p, 0xC4, dht_length);
+        for (int t = 0; t < tables_count; t++)
+        {
+            int symbols = 0;
+            *p++ = classes[t];
+            for (int i = 0; i < 16; i++)
+            {
+                *p++ = bits[t][i];
+                symbols += bits[t][i];
+            }
+            memcpy(p, values[t], (size_t)symbols);
+            p += symbols;
+        }
+
+        // DRI: one MCU row per restart interval
+        p = put_marker(p, 0xDD, 4);
+        *p++ = (unsigned char)(mcus_per_row >> 8);
+        *p++ = (unsigned char)mcus_per_row;
+
+        // SOS: all components, full spectral range
+        p = put_marker(p, 0xDA, 6 + 2 * components);
+        *p++ = (unsigned char)components;
+        for (int c = 0; c < components; c++)
+        {
+            *p++ = (unsigned char)(c + 1);
+            *p++ = c == 0 ? 0x00 : 0x11;
+        }
+        *p++ = 0;
+        *p++ = 63;
+        *p++ = 0;
+
+        ok = fwrite(header, 1, (size_t)(p - header), file) == (size_t)(p - header);
+        for (int row = 0; ok && row < mcu_rows; row++)
+        {
+            ok = fwrite(segments[row].data, 1, segments[row].size, file) == segments[row].size;
+            if (ok && row + 1 < mcu_rows)
+            {
+                unsigned char restart[2] = {0xFF, (unsigned char)(0xD0 + row % 8)};
+                ok = fwrite(restart, 1, 2, file) == 2;
+            }
+        }
+        unsigned char eoi[2] = {0xFF, 0xD9};
+        ok = ok && fwrite(eoi, 1, 2, file) == 2;
+    }
+
+    for (int row = 0; row < mcu_rows; row++)
+    {
+        free(segments[row].data);
+    }
+    free(segments);
+    return ok;
+}
@@ -0,0 +1,455 @@
+/**
+ * @file lut.c
+ * @brief Implementation of lookup table engine for point operations
+ *
+ * @details Point operations map every 8-bit sample independently, so any of them
+ *          can be stored as a 256-entry table. Chains of such operations are
+ *          composed into a single table and applied in one pass over the image.
+ */
+#include "functions.h"
+
+/**
+ * @brief Clamps and rounds a value to the 8-bit range
+ * @param value Input value
+ * @return Value rounded to nearest integer and clamped to [0,255]
+ */
+static unsigned char clamp_byte(double value)
+{
+    if (value <= 0)
+    {
+        return 0;
+    }
+    if (value >= 255)
+    {
+        return 255;
+    }
+    return (unsigned char)(value + 0.5);
+}
+
+/**
+ * @brief Fills table with identity mapping
+ * @param lut Table of 256 entries
+ */
+void lut_identity(unsigned char* lut)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        lut[i] = (unsigned char)i;
+    }
+}
+
+/**
+ * @brief Composes two tables into one
+ * @param first Table applied first
+ * @param second Table applied to the result of the first one
+ * @param out Output table, out[i] = second[first[i]] (may alias either input)
+ */
+void lut_compose(const unsigned char* first, const unsigned char* second, unsigned char* out)
+{
+    unsigned char temp[256];
+    for (int i = 0; i < 256; i++)
+    {
+        temp[i] = second[first[i]];
+    }
+    memcpy(out, temp, 256);
+}
+
+/**
+ * @brief Builds gamma correction table
+ * @param lut Output table
+ * @param gamma Gamma value (values above 1 brighten midtones)
+ */
+void lut_gamma(unsigned char* lut, double gamma)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        lut[i] = clamp_byte(255.0 * pow(i / 255.0, 1.0 / gamma));
+    }
+}
+
+/**
+ * @brief Builds levels table
+ * @param lut Output table
+ * @param in_black Input level mapped to out_black
+ * @param in_white Input level mapped to out_white
+ * @param out_black Output black level
+ * @param out_white Output white level
+ *
+ * @details Values outside [in_black, in_white] are clipped
+ */
+void lut_levels(unsigned char* lut, int in_black, int in_white, int out_black, int out_white)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        double t;
+        if (in_white <= in_black)
+        {
+            t = i >= in_white ? 1.0 : 0.0;
+        }
+        else
+        {
+            t = (double)(i - in_black) / (in_white - in_black);
+            if (t < 0) t = 0;
+            else if (t > 1) t = 1;
+        }
+        lut[i] = clamp_byte(out_black + t * (out_white - out_black));
+    }
+}
+
+/**
+ * @brief Builds contrast table
+ * @param lut Output table
+ * @param factor Contrast factor around middle gray (1 keeps the image unchanged)
+ */
+void lut_contrast(unsigned char* lut, double factor)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        lut[i] = clamp_byte((i - 127.5) * factor + 127.5);
+    }
+}
+
+/**
+ * @brief Builds binary threshold table
+ * @param lut Output table
+ * @param level Values greater or equal to level become 255, others 0
+ */
+void lut_threshold(unsigned char* lut, int level)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        lut[i] = i >= level ? 255 : 0;
+    }
+}
+
+/**
+ * @brief Builds negative table
+ * @param lut Output table
+ */
+void lut_invert(unsigned char* lut)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        lut[i] = (unsigned char)(255 - i);
+    }
+}
+
+/**
+ * @brief Builds histogram equalization table
+ * @param lut Output table
+ * @param histogram Histogram of 256 bins
+ *
+ * @details new_value = round((cdf[value] - cdf_min) * 255 / (N - cdf_min)),
+ *          where N is the total count and cdf_min the first non-zero CDF value
+ */
+void lut_equalize(unsigned char* lut, const unsigned long long* histogram)
+{
+    unsigned long long cdf[256];
+    unsigned long long total = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        total += histogram[i];
+        cdf[i] = total;
+    }
+
+    // Find minimum non-zero value in CDF for normalization
+    unsigned long long cdf_min = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        if (cdf[i] != 0)
+        {
+            cdf_min = cdf[i];
+            break;
+        }
+    }
+
+    // Single-valued image: nothing to spread
+    if (total == cdf_min)
+    {
+        lut_identity(lut);
+        return;
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        lut[i] = cdf[i] < cdf_min ? 0 : (unsigned char)((cdf[i] - cdf_min) * 255 / (total - cdf_min));
+    }
+}
+
+/**
+ * @brief Applies one table to a contiguous run of samples
+ * @param data Samples to transform in place
+ * @param count Number of samples
+ * @param lut Table of 256 entries
+ *
+ * @note Unrolled by 8 so that independent loads and stores can overlap
+ */
+static void lut_apply_flat(unsigned char* data, size_t count, const unsigned char* lut)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        unsigned char a0 = lut[data[i]];
+        unsigned char a1 = lut[data[i + 1]];
+        unsigned char a2 = lut[data[i + 2]];
+        unsigned char a3 = lut[data[i + 3]];
+        unsigned char a4 = lut[data[i + 4]];
+        unsigned char a5 = lut[data[i + 5]];
+        unsigned char a6 = lut[data[i + 6]];
+        unsigned char a7 = lut[data[i + 7]];
+        data[i] = a0;
+        data[i + 1] = a1;
+        data[i + 2] = a2;
+        data[i + 3] = a3;
+        data[i + 4] = a4;
+        data[i + 5] = a5;
+        data[i + 6] = a6;
+        data[i + 7] = a7;
+    }
+    for (; i < count; i++)
+    {
+        data[i] = lut[data[i]];
+    }
+}
+
+/**
+ * @brief Applies lookup tables to an image in place
+ * @param image Image data
+ * @param pixels Number of pixels
+ * @param channels Number of color channels
+ * @param luts One table of 256 entries per channel (channels * 256 entries),
+ *             or a single table when same_lut is non-zero
+ * @param same_lut Non-zero if the same table is used for every channel
+ *
+ * @details The same-table case treats the image as a flat array of samples.
+ *          Per-channel tables are applied pixel by pixel with the common
+ *          channel counts unrolled.
+ * @note Work is split into chunks processed in parallel
+ */
+void lut_apply(unsigned char* image, size_t pixels, int channels, const unsigned char* luts, int same_lut)
+{
+    const size_t chunk = 1 << 16; // pixels per parallel work item
+    long long chunks = (long long)((pixels + chunk - 1) / chunk);
+
+    #pragma omp parallel for schedule(static)
+    for (long long c = 0; c < chunks; c++)
+    {
+        size_t start = (size_t)c * chunk;
+        size_t count = pixels - start < chunk ? pixels - start : chunk;
+        unsigned char* p = image + start * channels;
+
+        if (same_lut)
+        {
+            lut_apply_flat(p, count * channels, luts);
+            continue;
+        }
+
+        switch (channels)
+        {
+        case 1:
+            lut_apply_flat(p, count, luts);
+            break;
+        case 3:
+            for (size_t i = 0; i < count; i++, p += 3)
+            {
+                p[0] = luts[p[0]];
+                p[1] = luts[256 + p[1]];
+                p[2] = luts[512 + p[2]];
+            }
+            break;
+        case 4:
+            for (size_t i = 0; i < count; i++, p += 4)
+            {
+                p[0] = luts[p[0]];
+                p[1] = luts[256 + p[1]];
+                p[2] = luts[512 + p[2]];
+                p[3] = luts[768 + p[3]];
+            }
+            break;
+        default:
+            for (size_t i = 0; i < count; i++)
+            {
+                for (int k = 0; k < channels; k++, p++)
+                {
+                    *p = luts[k * 256 + *p];
+                }
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Applies a table to color channels only, leaving alpha unchanged
+ * @param image Image data
+ * @param pixels Number of pixels
+ * @param channels Number of color channels (alpha expected for 2 and 4)
+ * @param lut Table of 256 entries
+ */
+void lut_apply_color(unsigned char* image, size_t pixels, int channels, const unsigned char* lut)
+{
+    // No alpha: every sample goes through the same table
+    if (channels == 1 || channels == 3)
+    {
+        lut_apply(image, pixels, channels, lut, 1);
+        return;
+    }
+
+    unsigned char luts[4 * 256];
+    for (int k = 0; k < channels; k++)
+    {
+        if (k == channels - 1)
+        {
+            lut_identity(luts + k * 256);
+        }
+        else
+        {
+            memcpy(luts + k * 256, lut, 256);
+        }
+    }
+    lut_apply(image, pixels, channels, luts, 0);
+}
+
+/**
+ * @brief Applies a chain of point operations to an image
+ * @param input_path Path to the input image file
+ * @param output_path Path to save the processed image
+ * @param spec Comma separated operations, parameters separated by ':'
+ * @return 0 on success, -1 on error
+ *
+ * @details Supported operations:
+ * - gamma:g                 gamma correction
+ * - levels:lo:hi[:olo:ohi]  input range lo..hi stretched to olo..ohi (0..255)
+ * - contrast:f              contrast factor around middle gray
+ * - threshold:t             binarization
+ * - invert                  negative
+ * - equalize                histogram equalization of the samples reaching this step
+ *
+ * All operations are composed into one table, so the image is traversed once
+ * (plus one histogram pass when equalize is used). Alpha is left unchanged.
+ *
+ * Example: gamma:2.2,contrast:1.3,invert
+ */
+int point_operations(char* input_path, char* output_path, char* spec)
+{
+    // Load image
+    int width, height, channels;
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
+    if (!image)
+    {
+        printf("Error loading image\n");
+        return -1;
+    }
+    size_t pixels = (size_t)width * height;
+    int color_channels = (channels == 2 || channels == 4) ? channels - 1 : channels;
+
+    // Working copy of the specification for strtok
+    char* ops = (char*)malloc(strlen(spec) + 1);
+    if (!ops)
+    {
+        free_image(image);
+        printf("Error: Memory allocation failed!\n");
+        return -1;
+    }
+    strcpy(ops, spec);
+
+    // Histogram of color samples, computed only when an equalize step needs it
+    unsigned long long source_histogram[256];
+    int have_histogram = 0;
+
+    unsigned char chain[256];
+    unsigned char step[256];
+    lut_identity(chain);
+
+    int ok = 1;
+    for (char* op = strtok(ops, ","); op && ok; op = strtok(NULL, ","))
+    {
+        // Split operation name and up to four numeric parameters; a parameter
+        // that is not a number, or a fifth one, matches no operation below
+        double args[4] = {0};
+        int argn = 0;
+        char* colon = strchr(op, ':');
+        while (colon)
+        {
+            *colon = '\0';
+            char* end;
+            double value = strtod(colon + 1, &end);
+            if (argn == 4 || end == colon + 1 || (*end != '\0' && *end != ':'))
+            {
+                argn = -1;
+                break;
+            }
+            args[argn++] = value;
+            colon = strchr(colon + 1, ':');
+        }
+
+        if (strcmp(op, "gamma") == 0 && argn == 1 && args[0] > 0)
+        {
+            lut_gamma(step, args[0]);
+        }
+        else if (strcmp(op, "levels") == 0 && (argn == 2 || argn == 4))
+        {
+            if (argn == 2)
+            {
+                args[2] = 0;
+                args[3] = 255;
+            }
+            lut_levels(step, (int)args[0], (int)args[1], (int)args[2], (int)args[3]);
+        }
+        else if (strcmp(op, "contrast") == 0 && argn == 1)
+        {
+            lut_contrast(step, args[0]);
+        }
+        else if (strcmp(op, "threshold") == 0 && argn == 1)
+        {
+            lut_threshold(step, (int)args[0]);
+        }
+        else if (strcmp(op, "invert") == 0 && argn == 0)
+        {
+            lut_invert(step);
+        }
+        else if (strcmp(op, "equalize") == 0 && argn == 0)
+        {
+            if (!have_histogram)
+            {
+                memset(source_histogram, 0, sizeof(source_histogram));
+                for (size_t i = 0; i < pixels; i++)
+                {
+                    for (int k = 0; k < color_channels; k++)
+                    {
+                        source_histogram[image[i * channels + k]]++;
+                    }
+                }
+                have_histogram = 1;
+            }
+            // Histogram of the values produced by the chain so far
+            unsigned long long histogram[256] = {0};
+            for (int i = 0; i < 256; i++)
+            {
+                histogram[chain[i]] += source_histogram[i];
+            }
+            lut_equalize(step, histogram);
+        }
+        else
+        {
+            printf("Invalid point operation: %s\n", op);
+            ok = 0;
+            break;
+        }
+        lut_compose(chain, step, chain);
+    }
+    free(ops);
+
+    if (!ok)
+    {
+        free_image(image);
+        return -1;
+    }
+
+    lut_apply_color(image, pixels, channels, chain);
+
+    // Save processed image
+    int res = save_image(output_path, width, height, channels, image, 0);
+    free_image(image);
+    return res;
+}
@@ -51,7 +51,7 @@ int median_filter(char* input_path, char* output_path, int size)
 
     // Load image using stb_image
     int width, height, channels;
-    unsigned char* image = stbi_load(input_path, &width, &height, &channels, 0);
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
     if (!image) 
     {
         printf("Error loading image\n");
@@ -61,7 +61,7 @@ int median_filter(char* input_path, char* output_path, int size)
     // Check if filter size is appropriate for image dimensions
     if (size > height || size > width) 
     {
-        stbi_image_free(image);
+        free_image(image);
         printf("Error: Filter size exceeds image dimensions!\n");
         return -1;
     }
@@ -71,7 +71,7 @@ int median_filter(char* input_path, char* output_path, int size)
     unsigned char* zone = malloc(size * size * sizeof(unsigned char));
     if (!zone) 
     {
-        stbi_image_free(image);
+        free_image(image);
         printf("Error: Memory allocation failed!\n");
         return -1;
     }
@@ -91,49 +91,24 @@ int median_filter(char* input_path, char* output_path, int size)
                     {
                         int y = get_cord(i + dy, height);
                         int x = get_cord(j + dx, width);
-                        zone[count] = image[(y * width + x) * channels + k];
+                        zone[count] = image[((size_t)y * width + x) * channels + k];
                         count++;
                     }
                 }
 
                 // Sort pixels and take median value
                 qsort(zone, count, sizeof(unsigned char), compare);
-                image[(i * width + j) * channels + k] = zone[count / 2];
+                image[((size_t)i * width + j) * channels + k] = zone[count / 2];
             }
         }
     }
 
     // Save processed image
-    int res;
-    const char* ext = strrchr(output_path, '.');
-    if (ext) {
-        if (strcmp(ext, ".png") == 0) 
-        {
-            res = stbi_write_png(output_path, width, height, channels, image, width * channels);
-        }
-        else if (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0)
-        {
-            res = stbi_write_jpg(output_path, width, height, channels, image, 100);
-        } 
-        else 
-        {
-            printf("Unsupported format. Use .png or .jpg\n");
-            res = 0;
-        }
-    } else {
-        printf("Output path missing extension\n");
-        res = 0;
-    }
+    int res = save_image(output_path, width, height, channels, image, 0);
 
     // Clean up resources
     free(zone);
-    stbi_image_free(image);
+    free_image(image);
 
-    if(!res)
-    {
-        printf("Error writing image\n");
-        return -1;
-    }
-    
-    return 0;
+    return res;
 }
\ No newline at end of file
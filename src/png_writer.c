@@ -0,0 +1,1187 @@
+/**
+ * @file png_writer.c
+ * @brief Implementation of a multithreaded PNG encoder
+ *
+ * @details Rows are filtered in parallel, then the filtered data is split into
+ *          chunks which are deflated concurrently. Every chunk is primed with
+ *          the 32 KB preceding it as dictionary, so matches may reach back
+ *          into the previous chunk, and ends on a byte boundary (empty stored
+ *          block), so the compressed chunks join into one zlib stream. Each
+ *          chunk is written as its own IDAT with a CRC computed by its thread.
+ */
+#include "functions.h"
+
+#define PNG_CHUNK_SIZE (256 * 1024) ///< Filtered bytes compressed by one task
+#define WINDOW_SIZE 32768           ///< Deflate window
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define FILTER_BAND 16       ///< Rows sharing the filter chosen on their first row (fast levels)
+#define BLOCK_TOKENS 32768   ///< Tokens per deflate block
+#define MAX_STORED 65535     ///< Largest stored block
+#define TOO_FAR 4096         ///< Farthest distance worth a minimum length match
+#define LITLEN_CODES 286
+#define DIST_CODES 30
+#define CODELEN_CODES 19
+#define ADLER_BASE 65521
+
+#define FILTER_NONE 0    ///< No filtering (stored output gains nothing from it)
+#define FILTER_SAMPLED 1 ///< Best filter of the first row of a band applied to the whole band
+#define FILTER_ROWS 2    ///< Best filter of every row
+
+#define MATCH_STORED 0 ///< No compression
+#define MATCH_RLE 1    ///< Only repeats of the previous byte (distance 1), no hash chains
+#define MATCH_CHAIN 2  ///< Hash chain search
+
+/**
+ * @brief Filter selection and match search effort of one compression level
+ */
+typedef struct
+{
+    int filter;     ///< Filter selection (FILTER_*)
+    int matcher;    ///< Match finder (MATCH_*)
+    int max_chain;  ///< Hash chain candidates tried per position
+    int nice;       ///< Stop searching once a match this long is found
+    int lazy;       ///< Non-zero to check if the next position has a longer match
+    int max_insert; ///< Greedy levels: longer matches are not indexed inside (0 = always)
+} level_config;
+
+static const level_config levels[10] = {
+    {FILTER_NONE, MATCH_STORED, 0, 0, 0, 0},     // 0: stored
+    {FILTER_SAMPLED, MATCH_RLE, 0, 0, 0, 0},     // 1: fast
+    {FILTER_ROWS, MATCH_RLE, 0, 0, 0, 0},        // 2: fast
+    {FILTER_ROWS, MATCH_CHAIN, 16, 32, 0, 6},    // 3
+    {FILTER_ROWS, MATCH_CHAIN, 16, 32, 1, 0},    // 4
+    {FILTER_ROWS, MATCH_CHAIN, 32, 64, 1, 0},    // 5
+    {FILTER_ROWS, MATCH_CHAIN, 64, 128, 1, 0},   // 6
+    {FILTER_ROWS, MATCH_CHAIN, 128, 258, 1, 0},  // 7
+    {FILTER_ROWS, MATCH_CHAIN, 256, 258, 1, 0},  // 8
+    {FILTER_ROWS, MATCH_CHAIN, 1024, 258, 1, 0}, // 9
+};
+
+/**
+ * @brief Deflate output bit stream (least significant bit first)
+ */
+typedef struct
+{
+    unsigned char* out;      ///< Output buffer, large enough for the chunk
+    size_t pos;              ///< Bytes written
+    unsigned long long bits; ///< Pending bits
+    int count;               ///< Number of pending bits
+} bit_writer;
+
+static void put_bits(bit_writer* w, unsigned int value, int n)
+{
+    w->bits |= (unsigned long long)value << w->count;
+    w->count += n;
+    if (w->count >= 32)
+    {
+        unsigned char* out = w->out + w->pos;
+        out[0] = (unsigned char)w->bits;
+        out[1] = (unsigned char)(w->bits >> 8);
+        out[2] = (unsigned char)(w->bits >> 16);
+        out[3] = (unsigned char)(w->bits >> 24);
+        w->pos += 4;
+        w->bits >>= 32;
+        w->count -= 32;
+    }
+}
+
+/**
+ * @brief Pads the stream to a byte boundary and writes out all pending bits
+ */
+static void align_byte(bit_writer* w)
+{
+    w->count = (w->count + 7) & ~7;
+    while (w->count > 0)
+    {
+        w->out[w->pos++] = (unsigned char)w->bits;
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+/**
+ * @brief LZ77 tokens of one deflate block
+ */
+typedef struct
+{
+    unsigned short* value; ///< Literal byte or match length
+    unsigned short* dist;  ///< Match distance, 0 for literals
+    int count;             ///< Number of tokens
+} token_list;
+
+/// First length of every length code 257-285 and its number of extra bits
+static const unsigned short length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+/// First distance of every distance code 0-29 and its number of extra bits
+static const unsigned short dist_base[DIST_CODES] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char dist_extra[DIST_CODES] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/**
+ * @brief Lookup of length and distance codes
+ */
+typedef struct
+{
+    unsigned char length[MAX_MATCH + 1]; ///< Length code - 257 of every match length
+    unsigned char dist[512];             ///< Distance code of dist - 1 below 256, then of (dist - 1) >> 7
+} code_tables;
+
+static void build_code_tables(code_tables* tables)
+{
+    for (int code = 0; code < 29; code++)
+    {
+        int last = code + 1 < 29 ? length_base[code + 1] : MAX_MATCH + 1;
+        for (int length = length_base[code]; length < last; length++)
+        {
+            tables->length[length] = (unsigned char)code;
+        }
+    }
+
+    for (int code = 0; code < DIST_CODES; code++)
+    {
+        int last = code + 1 < DIST_CODES ? dist_base[code + 1] : WINDOW_SIZE + 1;
+        for (int dist = dist_base[code]; dist < last; dist++)
+        {
+            int x = dist - 1;
+            tables->dist[x < 256 ? x : 256 + (x >> 7)] = (unsigned char)code;
+        }
+    }
+}
+
+static int dist_code(const code_tables* tables, int dist)
+{
+    int x = dist - 1;
+    return tables->dist[x < 256 ? x : 256 + (x >> 7)];
+}
+
+/**
+ * @brief Computes Huffman code lengths limited to a maximum length
+ * @param freq Symbol frequencies
+ * @param n Number of symbols
+ * @param limit Maximum code length
+ * @param lengths Receives the code lengths (0 for unused symbols)
+ *
+ * @details Builds the tree with the two-queue method over leaves sorted by
+ *          frequency. When the tree is too deep the frequencies are halved
+ *          (keeping them non-zero) and the tree is rebuilt, which flattens it.
+ *          Fewer than two used symbols still get two codes, as some decoders
+ *          reject a code with a single symbol (or none at all for distances).
+ */
+static void build_lengths(const unsigned int* freq, int n, int limit, unsigned char* lengths)
+{
+    unsigned int weight[2 * LITLEN_CODES];
+    int symbol[LITLEN_CODES];
+    int parent[2 * LITLEN_CODES];
+    int leaves = 0;
+
+    memset(lengths, 0, (size_t)n);
+    for (int i = 0; i < n; i++)
+    {
+        if (freq[i])
+        {
+            symbol[leaves] = i;
+            weight[leaves++] = freq[i];
+        }
+    }
+    if (leaves < 2)
+    {
+        int used = leaves ? symbol[0] : 0;
+        lengths[used] = 1;
+        lengths[used == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    for (;;)
+    {
+        // Insertion sort of leaves by weight (at most 286 entries)
+        for (int i = 1; i < leaves; i++)
+        {
+            unsigned int w = weight[i];
+            int s = symbol[i];
+            int j = i - 1;
+            while (j >= 0 && weight[j] > w)
+            {
+                weight[j + 1] = weight[j];
+                symbol[j + 1] = symbol[j];
+                j--;
+            }
+            weight[j + 1] = w;
+            symbol[j + 1] = s;
+        }
+
+        // Two queues: sorted leaves [0, leaves) and internal nodes appended
+        // after them in the order they are created (already sorted)
+        int next_leaf = 0, next_node = leaves, nodes = leaves;
+        for (int k = 0; k < leaves - 1; k++)
+        {
+            int pick[2];
+            for (int p = 0; p < 2; p++)
+            {
+                if (next_leaf < leaves && (next_node >= nodes || weight[next_leaf] <= weight[next_node]))
+                {
+                    pick[p] = next_leaf++;
+                }
+                else
+                {
+                    pick[p] = next_node++;
+                }
+            }
+            weight[nodes] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = nodes;
+            parent[pick[1]] = nodes;
+            nodes++;
+        }
+
+        // Depths from the root down (parents are created after their children)
+        int depth[2 * LITLEN_CODES];
+        int max_depth = 0;
+        depth[nodes - 1] = 0;
+        for (int i = nodes - 2; i >= 0; i--)
+        {
+            depth[i] = depth[parent[i]] + 1;
+            if (i < leaves && depth[i] > max_depth)
+            {
+                max_depth = depth[i];
+            }
+        }
+
+        if (max_depth <= limit)
+        {
+            for (int i = 0; i < leaves; i++)
+            {
+                lengths[symbol[i]] = (unsigned char)depth[i];
+            }
+            return;
+        }
+
+        for (int i = 0; i < leaves; i++)
+        {
+            weight[i] = (weight[i] >> 1) | 1;
+        }
+    }
+}
+
+/**
+ * @brief Computes canonical codes, bit-reversed for LSB-first output
+ * @param lengths Code lengths
+ * @param n Number of symbols
+ * @param codes Receives the codes
+ */
+static void build_codes(const unsigned char* lengths, int n, unsigned short* codes)
+{
+    int count[16] = {0};
+    int next[16];
+    for (int i = 0; i < n; i++)
+    {
+        count[lengths[i]]++;
+    }
+    count[0] = 0;
+    int code = 0;
+    for (int len = 1; len < 16; len++)
+    {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        int len = lengths[i];
+        if (len)
+        {
+            int c = next[len]++;
+            int reversed = 0;
+            for (int b = 0; b < len; b++)
+            {
+                reversed = (reversed << 1) | ((c >> b) & 1);
+            }
+            codes[i] = (unsigned short)reversed;
+        }
+    }
+}
+
+/**
+ * @brief Dynamic block header: code lengths run-length coded with symbols 16-18
+ */
+typedef struct
+{
+    int hlit;                          ///< Number of literal/length codes sent
+    int hdist;                         ///< Number of distance codes sent
+    int hclen;                         ///< Number of code length codes sent
+    unsigned char symbols[LITLEN_CODES + DIST_CODES]; ///< Code length symbols
+    unsigned char extra[LITLEN_CODES + DIST_CODES];   ///< Repeat counts of symbols 16-18
+    int count;                         ///< Number of symbols
+    unsigned char cl_lengths[CODELEN_CODES];
+    unsigned short cl_codes[CODELEN_CODES];
+} dynamic_header;
+
+/// Order in which code length code lengths are sent
+static const unsigned char codelen_order[CODELEN_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/**
+ * @brief Builds the header of a dynamic block
+ * @param lit_lengths Literal/length code lengths
+ * @param dist_lengths Distance code lengths
+ * @param header Receives the header
+ * @return Size of the header in bits
+ */
+static size_t build_header(const unsigned char* lit_lengths, const unsigned char* dist_lengths,
+                           dynamic_header* header)
+{
+    int hlit = LITLEN_CODES, hdist = DIST_CODES;
+    while (hlit > 257 && !lit_lengths[hlit - 1]) hlit--;
+    while (hdist > 1 && !dist_lengths[hdist - 1]) hdist--;
+
+    unsigned char all[LITLEN_CODES + DIST_CODES];
+    memcpy(all, lit_lengths, (size_t)hlit);
+    memcpy(all + hlit, dist_lengths, (size_t)hdist);
+    int total = hlit + hdist;
+
+    // Run-length code the lengths
+    unsigned int cl_freq[CODELEN_CODES] = {0};
+    int count = 0;
+    for (int i = 0; i < total;)
+    {
+        int run = 1;
+        while (i + run < total && all[i + run] == all[i])
+        {
+            run++;
+        }
+        if (all[i] == 0 && run >= 3)
+        {
+            if (run > 138) run = 138;
+            header->symbols[count] = (unsigned char)(run <= 10 ? 17 : 18);
+            header->extra[count++] = (unsigned char)(run <= 10 ? run - 3 : run - 11);
+        }
+        else if (all[i] != 0 && run >= 4)
+        {
+            // The length itself, then repeats of 3-6
+            if (run > 7) run = 7;
+            header->symbols[count] = all[i];
+            header->extra[count++] = 0;
+            header->symbols[count] = 16;
+            header->extra[count++] = (unsigned char)(run - 1 - 3);
+        }
+        else
+        {
+            run = 1;
+            header->symbols[count] = all[i];
+            header->extra[count++] = 0;
+        }
+        i += run;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        cl_freq[header->symbols[i]]++;
+    }
+
+    build_lengths(cl_freq, CODELEN_CODES, 7, header->cl_lengths);
+    build_codes(header->cl_lengths, CODELEN_CODES, header->cl_codes);
+
+    int hclen = CODELEN_CODES;
+    while (hclen > 4 && !header->cl_lengths[codelen_order[hclen - 1]]) hclen--;
+
+    header->hlit = hlit;
+    header->hdist = hdist;
+    header->hclen = hclen;
+    header->count = count;
+
+    size_t bits = 5 + 5 + 4 + 3 * (size_t)hclen;
+    for (int i = 0; i < count; i++)
+    {
+        int s = header->symbols[i];
+        bits += header->cl_lengths[s] + (s == 16 ? 2 : s == 17 ? 3 : s == 18 ? 7 : 0);
+    }
+    return bits;
+}
+
+static void write_header(bit_writer* w, const dynamic_header* header)
+{
+    put_bits(w, (unsigned int)(header->hlit - 257), 5);
+    put_bits(w, (unsigned int)(header->hdist - 1), 5);
+    put_bits(w, (unsigned int)(header->hclen - 4), 4);
+    for (int i = 0; i < header->hclen; i++)
+    {
+        put_bits(w, header->cl_lengths[codelen_order[i]], 3);
+    }
+    for (int i = 0; i < header->count; i++)
+    {
+        int s = header->symbols[i];
+        put_bits(w, header->cl_codes[s], header->cl_lengths[s]);
+        if (s == 16) put_bits(w, header->extra[i], 2);
+        else if (s == 17) put_bits(w, header->extra[i], 3);
+        else if (s == 18) put_bits(w, header->extra[i], 7);
+    }
+}
+
+/**
+ * @brief Writes uncompressed data as stored blocks
+ * @param w Bit stream
+ * @param data Bytes to store
+ * @param length Number of bytes
+ * @param final Non-zero if the last block ends the stream
+ */
+static void write_stored(bit_writer* w, const unsigned char* data, size_t length, int final)
+{
+    do
+    {
+        size_t part = length > MAX_STORED ? MAX_STORED : length;
+        put_bits(w, final && part == length, 1);
+        put_bits(w, 0, 2);
+        align_byte(w);
+        put_bits(w, (unsigned int)part & 0xFF, 8);
+        put_bits(w, (unsigned int)part >> 8, 8);
+        put_bits(w, ~(unsigned int)part & 0xFF, 8);
+        put_bits(w, (~(unsigned int)part >> 8) & 0xFF, 8);
+        memcpy(w->out + w->pos, data, part);
+        w->pos += part;
+        data += part;
+        length -= part;
+    } while (length > 0);
+}
+
+/**
+ * @brief Writes one block with whichever of fixed, dynamic or stored coding is smallest
+ * @param w Bit stream
+ * @param tokens Tokens of the block
+ * @param data Bytes covered by the tokens (for stored coding)
+ * @param length Number of bytes covered
+ * @param final Non-zero for the last block of the stream
+ */
+static void write_block(bit_writer* w, const code_tables* tables, const token_list* tokens,
+                        const unsigned char* data, size_t length, int final)
+{
+    unsigned int lit_freq[LITLEN_CODES] = {0};
+    unsigned int dist_freq[DIST_CODES] = {0};
+
+    for (int i = 0; i < tokens->count; i++)
+    {
+        if (tokens->dist[i] == 0)
+        {
+            lit_freq[tokens->value[i]]++;
+        }
+        else
+        {
+            lit_freq[257 + tables->length[tokens->value[i]]]++;
+            dist_freq[dist_code(tables, tokens->dist[i])]++;
+        }
+    }
+    lit_freq[256] = 1;
+
+    size_t extra_bits = 0;
+    for (int code = 0; code < 29; code++)
+    {
+        extra_bits += (size_t)lit_freq[257 + code] * length_extra[code];
+    }
+    for (int code = 0; code < DIST_CODES; code++)
+    {
+        extra_bits += (size_t)dist_freq[code] * dist_extra[code];
+    }
+
+    unsigned char lit_lengths[LITLEN_CODES], dist_lengths[DIST_CODES];
+    build_lengths(lit_freq, LITLEN_CODES, 15, lit_lengths);
+    build_lengths(dist_freq, DIST_CODES, 15, dist_lengths);
+    dynamic_header header;
+    size_t dynamic_bits = 3 + build_header(lit_lengths, dist_lengths, &header) + extra_bits;
+
+    // Fixed code lengths: literals 0-143 8 bits, 144-255 9, 256-279 7, 280-287 8, distances 5
+    unsigned char fixed_lit[288], fixed_dist[DIST_CODES];
+    for (int i = 0; i < 288; i++)
+    {
+        fixed_lit[i] = (unsigned char)(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+    }
+    memset(fixed_dist, 5, sizeof(fixed_dist));
+    size_t fixed_bits = 3 + extra_bits;
+    for (int i = 0; i < LITLEN_CODES; i++)
+    {
+        dynamic_bits += (size_t)lit_freq[i] * lit_lengths[i];
+        fixed_bits += (size_t)lit_freq[i] * fixed_lit[i];
+    }
+    for (int i = 0; i < DIST_CODES; i++)
+    {
+        dynamic_bits += (size_t)dist_freq[i] * dist_lengths[i];
+        fixed_bits += (size_t)dist_freq[i] * 5;
+    }
+    size_t stored_bits = (length * 8) + ((length + MAX_STORED - 1) / MAX_STORED) * 40 + 8;
+
+    if (stored_bits <= dynamic_bits && stored_bits <= fixed_bits)
+    {
+        write_stored(w, data, length, final);
+        return;
+    }
+
+    const unsigned char* lit_len;
+    const unsigned char* dist_len;
+    unsigned short lit_codes[288], dist_codes[DIST_CODES];
+    put_bits(w, final != 0, 1);
+    if (dynamic_bits < fixed_bits)
+    {
+        put_bits(w, 2, 2);
+        write_header(w, &header);
+        lit_len = lit_lengths;
+        dist_len = dist_lengths;
+        build_codes(lit_lengths, LITLEN_CODES, lit_codes);
+        build_codes(dist_lengths, DIST_CODES, dist_codes);
+    }
+    else
+    {
+        put_bits(w, 1, 2);
+        lit_len = fixed_lit;
+        dist_len = fixed_dist;
+        build_codes(fixed_lit, 288, lit_codes);
+        build_codes(fixed_dist, DIST_CODES, dist_codes);
+    }
+
+    for (int i = 0; i < tokens->count; i++)
+    {
+        if (tokens->dist[i] == 0)
+        {
+            int v = tokens->value[i];
+            put_bits(w, lit_codes[v], lit_len[v]);
+        }
+        else
+        {
+            int value = tokens->value[i];
+            int code = tables->length[value];
+            put_bits(w, lit_codes[257 + code], lit_len[257 + code]);
+            put_bits(w, (unsigned int)(value - length_base[code]), length_extra[code]);
+            int dist = tokens->dist[i];
+            code = dist_code(tables, dist);
+            put_bits(w, dist_codes[code], dist_len[code]);
+            put_bits(w, (unsigned int)(dist - dist_base[code]), dist_extra[code]);
+        }
+    }
+    put_bits(w, lit_codes[256], lit_len[256]);
+}
+
+/**
+ * @brief Hash of the 3 bytes starting at a position
+ */
+static unsigned int hash3(const unsigned char* p)
+{
+    unsigned int v = (unsigned int)p[0] << 16 | (unsigned int)p[1] << 8 | p[2];
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief Match finder state for one chunk
+ */
+typedef struct
+{
+    const unsigned char* window; ///< Start of the dictionary
+    int length;                  ///< Dictionary plus chunk bytes
+    int* head;                   ///< Most recent position of every hash
+    int* prev;                   ///< Previous position with the same hash
+} match_state;
+
+static void insert_position(match_state* m, int pos)
+{
+    if (pos + MIN_MATCH <= m->length)
+    {
+        unsigned int h = hash3(m->window + pos);
+        m->prev[pos] = m->head[h];
+        m->head[h] = pos;
+    }
+}
+
+/**
+ * @brief Finds the longest match for a position along its hash chain
+ * @param m Match finder state (the position is already inserted)
+ * @param pos Position to match
+ * @param best Length to beat
+ * @param config Search effort
+ * @param dist Receives the distance of the match
+ * @return Length of the best match, at most best if none is longer
+ */
+static int longest_match(const match_state* m, int pos, int best, const level_config* config, int* dist)
+{
+    const unsigned char* window = m->window;
+    const unsigned char* current = window + pos;
+    int max_length = m->length - pos < MAX_MATCH ? m->length - pos : MAX_MATCH;
+    int limit = pos > WINDOW_SIZE ? pos - WINDOW_SIZE : 0;
+    int chain = config->max_chain;
+    // A long match is already good enough, search less for a better one
+    if (best >= 32)
+    {
+        chain >>= 2;
+    }
+
+    if (best >= max_length)
+    {
+        return best;
+    }
+
+    for (int candidate = m->prev[pos]; candidate >= limit && chain-- > 0; candidate = m->prev[candidate])
+    {
+        const unsigned char* match = window + candidate;
+        if (match[best] != current[best] || match[0] != current[0] || match[1] != current[1])
+        {
+            continue;
+        }
+        int length = 2;
+        while (length < max_length && match[length] == current[length])
+        {
+            length++;
+        }
+        if (length > best)
+        {
+            best = length;
+            *dist = pos - candidate;
+            if (length >= config->nice || length >= max_length)
+            {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+static void add_token(token_list* tokens, int value, int dist)
+{
+    tokens->value[tokens->count] = (unsigned short)value;
+    tokens->dist[tokens->count] = (unsigned short)dist;
+    tokens->count++;
+}
+
+/**
+ * @brief Scratch buffers for compressing one chunk
+ */
+typedef struct
+{
+    int* head;
+    int* prev;
+    unsigned short* value;
+    unsigned short* dist;
+} deflate_scratch;
+
+/**
+ * @brief Deflates one chunk of the stream
+ * @param data Whole uncompressed stream
+ * @param start Start of the chunk
+ * @param end End of the chunk
+ * @param config Search effort
+ * @param tables Length and distance code lookup
+ * @param scratch Hash chains and token buffers
+ * @param w Bit stream of the chunk
+ * @param final Non-zero for the last chunk
+ *
+ * @details Up to 32 KB before the chunk are inserted into the hash chains
+ *          first, so the chunk compresses as if the stream were continuous.
+ *          A chunk that is not final ends with an empty stored block, which
+ *          pads it to a byte boundary for concatenation.
+ */
+static void deflate_chunk(const unsigned char* data, size_t start, size_t end, const level_config* config,
+                          const code_tables* tables, deflate_scratch* scratch, bit_writer* w, int final)
+{
+    if (config->matcher == MATCH_STORED)
+    {
+        write_stored(w, data + start, end - start, final);
+        return;
+    }
+
+    size_t base = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0;
+    match_state m = {data + base, (int)(end - base), scratch->head, scratch->prev};
+    token_list tokens = {scratch->value, scratch->dist, 0};
+    int pos = (int)(start - base);
+    int block_start = pos;
+
+    // Run-length mode: a byte equal to the one before starts a distance 1 match
+    while (config->matcher == MATCH_RLE && pos < m.length)
+    {
+        if (tokens.count == BLOCK_TOKENS)
+        {
+            write_block(w, tables, &tokens, m.window + block_start, (size_t)(pos - block_start), 0);
+            tokens.count = 0;
+            block_start = pos;
+        }
+
+        int run = 0;
+        if (pos > 0)
+        {
+            const unsigned char* current = m.window + pos;
+            int max_length = m.length - pos < MAX_MATCH ? m.length - pos : MAX_MATCH;
+            while (run < max_length && current[run] == current[-1])
+            {
+                run++;
+            }
+        }
+        if (run >= MIN_MATCH)
+        {
+            add_token(&tokens, run, 1);
+            pos += run;
+        }
+        else
+        {
+            add_token(&tokens, m.window[pos], 0);
+            pos++;
+        }
+    }
+
+    if (config->matcher == MATCH_CHAIN)
+    {
+        for (int i = 0; i < HASH_SIZE; i++)
+        {
+            m.head[i] = -1;
+        }
+        for (int i = 0; i < pos; i++)
+        {
+            insert_position(&m, i);
+        }
+    }
+
+    int prev_length = 0, prev_dist = 0, pending = 0;
+    while (config->matcher == MATCH_CHAIN && pos < m.length)
+    {
+        // Flush a full block (room for two tokens of the lazy step)
+        if (tokens.count >= BLOCK_TOKENS - 2)
+        {
+            int covered = pos - pending;
+            write_block(w, tables, &tokens, m.window + block_start, (size_t)(covered - block_start), 0);
+            tokens.count = 0;
+            block_start = covered;
+        }
+
+        insert_position(&m, pos);
+        int length = 0, dist = 0;
+        if (pos + MIN_MATCH <= m.length && prev_length < config->nice)
+        {
+            length = longest_match(&m, pos, config->lazy ? (prev_length > 2 ? prev_length : 2) : 2,
+                                   config, &dist);
+            // A 3 byte match far back codes longer than three literals
+            if (length == MIN_MATCH && dist > TOO_FAR)
+            {
+                length = 2;
+            }
+            if (config->lazy && length <= prev_length)
+            {
+                length = 0;
+            }
+        }
+
+        if (!config->lazy)
+        {
+            if (length >= MIN_MATCH)
+            {
+                add_token(&tokens, length, dist);
+                if (length <= config->max_insert)
+                {
+                    for (int i = 1; i < length; i++)
+                    {
+                        insert_position(&m, pos + i);
+                    }
+                }
+                pos += length;
+            }
+            else
+            {
+                add_token(&tokens, m.window[pos], 0);
+                pos++;
+            }
+            continue;
+        }
+
+        // Lazy matching: a match found at pos - 1 is only taken if pos has no longer one
+        if (pending && prev_length >= MIN_MATCH && length == 0)
+        {
+            add_token(&tokens, prev_length, prev_dist);
+            int match_end = pos - 1 + prev_length;
+            for (int i = pos + 1; i < match_end; i++)
+            {
+                insert_position(&m, i);
+            }
+            pos = match_end;
+            pending = 0;
+            prev_length = 0;
+        }
+        else
+        {
+            if (pending)
+            {
+                add_token(&tokens, m.window[pos - 1], 0);
+            }
+            pending = 1;
+            prev_length = length;
+            prev_dist = dist;
+            pos++;
+        }
+    }
+    if (pending)
+    {
+        add_token(&tokens, m.window[pos - 1], 0);
+    }
+
+    write_block(w, tables, &tokens, m.window + block_start, (size_t)(m.length - block_start), final);
+    if (final)
+    {
+        align_byte(w);
+    }
+    else
+    {
+        write_stored(w, m.window, 0, 0);
+    }
+}
+
+/**
+ * @brief Applies a PNG filter to one row
+ * @param type Filter type 0-4 (none, sub, up, average, Paeth)
+ * @param row Row pixels
+ * @param above Previous row (zeros for the first row)
+ * @param length Row length in bytes
+ * @param bpp Bytes per pixel
+ * @param out Filtered bytes
+ */
+static void filter_row(int type, const unsigned char* row, const unsigned char* above, int length, int bpp,
+                       unsigned char* out)
+{
+    int i;
+    switch (type)
+    {
+    case 0:
+        memcpy(out, row, (size_t)length);
+        break;
+    case 1:
+        for (i = 0; i < bpp; i++) out[i] = row[i];
+        for (; i < length; i++) out[i] = (unsigned char)(row[i] - row[i - bpp]);
+        break;
+    case 2:
+        for (i = 0; i < length; i++) out[i] = (unsigned char)(row[i] - above[i]);
+        break;
+    case 3:
+        for (i = 0; i < bpp; i++) out[i] = (unsigned char)(row[i] - (above[i] >> 1));
+        for (; i < length; i++) out[i] = (unsigned char)(row[i] - ((row[i - bpp] + above[i]) >> 1));
+        break;
+    default:
+        for (i = 0; i < bpp; i++) out[i] = (unsigned char)(row[i] - above[i]);
+        for (; i < length; i++)
+        {
+            int a = row[i - bpp], b = above[i], c = above[i - bpp];
+            int p = a + b - c;
+            int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+            int predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+            out[i] = (unsigned char)(row[i] - predictor);
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Sum of filtered bytes taken as signed values, the usual estimate of
+ *        how well a filtered row compresses
+ */
+static unsigned long long filter_cost(const unsigned char* filtered, int length)
+{
+    unsigned long long sum = 0;
+    for (int i = 0; i < length; i++)
+    {
+        sum += (unsigned long long)abs((signed char)filtered[i]);
+    }
+    return sum;
+}
+
+/**
+ * @brief Filters one row with the filter giving the lowest cost estimate
+ * @param row Row pixels
+ * @param above Previous row (zeros for the first row)
+ * @param length Row length in bytes
+ * @param bpp Bytes per pixel
+ * @param out Filter type byte followed by the filtered row
+ * @param trial Scratch row
+ */
+static void filter_best(const unsigned char* row, const unsigned char* above, int length, int bpp,
+                        unsigned char* out, unsigned char* trial)
+{
+    unsigned long long best_cost = 0;
+    int best = -1;
+    for (int type = 0; type < 5; type++)
+    {
+        unsigned char* target = best < 0 ? out + 1 : trial;
+        filter_row(type, row, above, length, bpp, target);
+        unsigned long long cost = filter_cost(target, length);
+        if (best < 0 || cost < best_cost)
+        {
+            if (target == trial)
+            {
+                memcpy(out + 1, trial, (size_t)length);
+            }
+            best_cost = cost;
+            best = type;
+        }
+    }
+    out[0] = (unsigned char)best;
+}
+
+/**
+ * @brief Combines Adler-32 checksums of two consecutive parts
+ * @param a Checksum of the first part
+ * @param b Checksum of the second part
+ * @param length_b Length of the second part
+ * @return Checksum of both parts
+ */
+static unsigned int adler32_combine(unsigned int a, unsigned int b, size_t length_b)
+{
+    unsigned int rem = (unsigned int)(length_b % ADLER_BASE);
+    unsigned int sum1 = a & 0xFFFF;
+    unsigned int sum2 = (unsigned int)(((unsigned long long)rem * sum1) % ADLER_BASE);
+    sum1 += (b & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (a >> 16) + (b >> 16) + ADLER_BASE - rem;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum2 >= 2 * ADLER_BASE) sum2 -= 2 * ADLER_BASE;
+    if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+    return sum1 | (sum2 << 16);
+}
+
+static unsigned int adler32(const unsigned char* data, size_t length)
+{
+    unsigned int s1 = 1, s2 = 0;
+    while (length > 0)
+    {
+        // 5552 bytes is the most that can be summed before the 32-bit sums overflow
+        size_t n = length < 5552 ? length : 5552;
+        for (size_t i = 0; i < n; i++)
+        {
+            s1 += data[i];
+            s2 += s1;
+        }
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+        data += n;
+        length -= n;
+    }
+    return s1 | (s2 << 16);
+}
+
+static unsigned int crc32_update(const unsigned int* table, unsigned int crc, const unsigned char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void put_be32(unsigned char* p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/**
+ * @brief Computes the running CRC of a PNG chunk: type and data, not yet inverted
+ */
+static unsigned int chunk_crc(const unsigned int* table, const char* type, const unsigned char* data, size_t length)
+{
+    unsigned int crc = crc32_update(table, 0xFFFFFFFFu, (const unsigned char*)type, 4);
+    return crc32_update(table, crc, data, length);
+}
+
+/**
+ * @brief Writes a complete PNG chunk: length, type, data and CRC
+ * @param crc Running CRC of type and data from chunk_crc()
+ */
+static int write_chunk(FILE* file, const char* type, const unsigned char* data, size_t length, unsigned int crc)
+{
+    unsigned char head[8], tail[4];
+    put_be32(head, (unsigned int)length);
+    memcpy(head + 4, type, 4);
+    put_be32(tail, ~crc);
+    return fwrite(head, 1, 8, file) == 8 && (length == 0 || fwrite(data, 1, length, file) == length) &&
+           fwrite(tail, 1, 4, file) == 4;
+}
+
+/**
+ * @brief Writes an image as PNG using all threads
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @param level Compression level 0-9: 0 stores, higher levels search longer
+ *              for matches (smaller file, slower)
+ * @return Non-zero on success, 0 on error
+ *
+ * @details Rows get the filter with the lowest sum of absolute filtered
+ *          values, computed for all rows in parallel (level 1 only tries the
+ *          filters on the first row of every 16 and uses the winner for the
+ *          whole band). The filtered stream is deflated in 256 KB chunks in
+ *          parallel, every chunk becoming one IDAT. Levels 1 and 2 are the fast
+ *          modes: they only code runs of repeated bytes, which suits filtered
+ *          photos. Level 3 searches hash chains greedily, higher levels search
+ *          longer chains with lazy matching.
+ */
+int png_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride,
+              int level)
+{
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    static const unsigned char color_type[5] = {0, 0, 4, 2, 6};
+
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4)
+    {
+        return 0;
+    }
+    if (level < 0) level = 0;
+    if (level > 9) level = 9;
+    const level_config* config = &levels[level];
+    code_tables tables;
+    build_code_tables(&tables);
+
+    size_t row_length = (size_t)width * channels;
+    int band_rows = config->filter == FILTER_ROWS ? 1 : config->filter == FILTER_SAMPLED ? FILTER_BAND : height;
+    int bands = (height + band_rows - 1) / band_rows;
+    size_t filtered_size = (row_length + 1) * (size_t)height;
+    size_t chunks = (filtered_size + PNG_CHUNK_SIZE - 1) / PNG_CHUNK_SIZE;
+    // Worst case of a chunk: every block stored, plus the zlib header and trailer
+    size_t chunk_capacity = PNG_CHUNK_SIZE + PNG_CHUNK_SIZE / 256 + 64;
+
+    unsigned char* filtered = (unsigned char*)malloc(filtered_size);
+    unsigned char* zeros = (unsigned char*)calloc(row_length, 1);
+    unsigned char* compressed = (unsigned char*)malloc(chunks * chunk_capacity);
+    size_t* compressed_size = (size_t*)malloc(chunks * sizeof(size_t));
+    unsigned int* chunk_adler = (unsigned int*)malloc(chunks * sizeof(unsigned int));
+    unsigned int* idat_crc = (unsigned int*)malloc(chunks * sizeof(unsigned int));
+    if (!filtered || !zeros || !compressed || !compressed_size || !chunk_adler || !idat_crc)
+    {
+        free(filtered);
+        free(zeros);
+        free(compressed);
+        free(compressed_size);
+        free(chunk_adler);
+        free(idat_crc);
+        return 0;
+    }
+
+    unsigned int crc_table[256];
+    for (unsigned int n = 0; n < 256; n++)
+    {
+        unsigned int c = n;
+        for (int k = 0; k < 8; k++)
+        {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+
+    int failed = 0;
+    #pragma omp parallel
+    {
+        unsigned char* trial = (unsigned char*)malloc(row_length);
+        deflate_scratch scratch;
+        scratch.head = (int*)malloc(HASH_SIZE * sizeof(int));
+        scratch.prev = (int*)malloc((WINDOW_SIZE + PNG_CHUNK_SIZE) * sizeof(int));
+        scratch.value = (unsigned short*)malloc(BLOCK_TOKENS * sizeof(unsigned short));
+        scratch.dist = (unsigned short*)malloc(BLOCK_TOKENS * sizeof(unsigned short));
+        if (!trial || !scratch.head || !scratch.prev || !scratch.value || !scratch.dist)
+        {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        // Rows are filtered in bands; with FILTER_ROWS every row is a band
+        #pragma omp for schedule(static)
+        for (int band = 0; band < bands; band++)
+        {
+            int y_start = band * band_rows;
+            int y_end = y_start + band_rows < height ? y_start + band_rows : height;
+            int type = 0;
+            for (int y = y_start; y < y_end && trial; y++)
+            {
+                const unsigned char* row = data + (size_t)y * stride;
+                const unsigned char* above = y > 0 ? row - stride : zeros;
+                unsigned char* out = filtered + (size_t)y * (row_length + 1);
+                if (y == y_start && config->filter != FILTER_NONE)
+                {
+                    filter_best(row, above, (int)row_length, channels, out, trial);
+                    type = out[0];
+                }
+                else
+                {
+                    out[0] = (unsigned char)type;
+                    filter_row(type, row, above, (int)row_length, channels, out + 1);
+                }
+            }
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (long long c = 0; c < (long long)chunks; c++)
+        {
+            int local_failed;
+            #pragma omp atomic read
+            local_failed = failed;
+            if (local_failed)
+            {
+                continue;
+            }
+
+            size_t start = (size_t)c * PNG_CHUNK_SIZE;
+            size_t end = start + PNG_CHUNK_SIZE < filtered_size ? start + PNG_CHUNK_SIZE : filtered_size;
+            bit_writer w = {compressed + (size_t)c * chunk_capacity, 0, 0, 0};
+            if (c == 0)
+            {
+                // zlib header: deflate with 32 KB window, default level flag
+                put_bits(&w, 0x78, 8);
+                put_bits(&w, 0x9C, 8);
+            }
+            deflate_chunk(filtered, start, end, config, &tables, &scratch, &w, end == filtered_size);
+            compressed_size[c] = w.pos;
+            idat_crc[c] = chunk_crc(crc_table, "IDAT", w.out, w.pos);
+            chunk_adler[c] = adler32(filtered + start, end - start);
+        }
+
+        free(trial);
+        free(scratch.head);
+        free(scratch.prev);
+        free(scratch.value);
+        free(scratch.dist);
+    }
+    free(filtered);
+    free(zeros);
+
+    int ok = !failed;
+    if (ok)
+    {
+        // Stream checksum goes after the last chunk
+        unsigned int adler = chunk_adler[0];
+        for (size_t c = 1; c < chunks; c++)
+        {
+            size_t length = c + 1 < chunks ? PNG_CHUNK_SIZE : filtered_size - c * PNG_CHUNK_SIZE;
+            adler = adler32_combine(adler, chunk_adler[c], length);
+        }
+        unsigned char* last = compressed + (chunks - 1) * chunk_capacity;
+        put_be32(last + compressed_size[chunks - 1], adler);
+        idat_crc[chunks - 1] = crc32_update(crc_table, idat_crc[chunks - 1], last + compressed_size[chunks - 1], 4);
+        compressed_size[chunks - 1] += 4;
+
+        unsigned char header[13];
+        put_be32(header, (unsigned int)width);
+        put_be32(header + 4, (unsigned int)height);
+        header[8] = 8;
+        header[9] = color_type[channels];
+        header[10] = 0;
+        header[11] = 0;
+        header[12] = 0;
+
+        ok = fwrite(signature, 1, 8, file) == 8 && write_chunk(file, "IHDR", header, 13, chunk_crc(crc_table, "IHDR", header, 13));
+        for (size_t c = 0; ok && c < chunks; c++)
+        {
+            ok = write_chunk(file, "IDAT", compressed + c * chunk_capacity, compressed_size[c], idat_crc[c]);
+        }
+        ok = ok && write_chunk(file, "IEND", NULL, 0, chunk_crc(crc_table, "IEND", NULL, 0));
+    }
+
+    free(compressed);
+    free(compressed_size);
+    free(chunk_adler);
+    free(idat_crc);
+    return ok;
+}
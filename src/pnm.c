@@ -0,0 +1,514 @@
+/**
+ * @file pnm.c
+ * @brief Implementation of Netpbm (PBM/PGM/PPM/PAM) reading and writing
+ *
+ * @details Images are read and written one row at a time through a
+ *          pnm_stream, so a command can process a file without holding all
+ *          of it and can read from or write to a pipe. Reading accepts every
+ *          Netpbm variant: plain (ASCII) and raw P1-P6, PAM (P7) with 1-4
+ *          channels, and any maxval up to 65535 (samples are scaled to 8 bits).
+ *          Writing produces raw 8-bit P5, P6 or P7.
+ */
+#include "functions.h"
+
+#define PNM_MAX_TOKEN 32            ///< Longest header token kept (longer PAM tuple types are cut)
+#define PNM_PIXELS_MAX 400000000ull ///< Largest image accepted, like the QOI limit
+
+/**
+ * @brief Reads one byte, skipping '#' comments that run to the end of the line
+ * @return The byte, EOF at the end of the file
+ */
+static int read_header_char(FILE* file)
+{
+    int ch = getc(file);
+    if (ch == '#')
+    {
+        do
+        {
+            ch = getc(file);
+        } while (ch != '\n' && ch != '\r' && ch != EOF);
+    }
+    return ch;
+}
+
+static int is_space(int ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+/**
+ * @brief Reads a non-negative decimal number of the header or a plain raster
+ * @param file Input file
+ * @param value Output: the number
+ * @return 0 on success, -1 on a missing or too large number
+ *
+ * @note Exactly one whitespace byte after the number is consumed, which is
+ *       the separator in front of a raw raster
+ */
+static int read_number(FILE* file, int* value)
+{
+    int ch;
+    do
+    {
+        ch = read_header_char(file);
+    } while (is_space(ch));
+    if (ch < '0' || ch > '9')
+    {
+        return -1;
+    }
+    long long v = 0;
+    while (ch >= '0' && ch <= '9')
+    {
+        v = v * 10 + (ch - '0');
+        if (v > INT_MAX)
+        {
+            return -1;
+        }
+        ch = getc(file);
+    }
+    if (ch != EOF && !is_space(ch))
+    {
+        return -1;
+    }
+    *value = (int)v;
+    return 0;
+}
+
+/**
+ * @brief Reads one whitespace-separated word of a PAM header
+ * @param file Input file
+ * @param token Output: the word, cut to PNM_MAX_TOKEN - 1 bytes
+ * @param line_end Output: non-zero if the word ended the line
+ * @return 0 on success, -1 at the end of the file
+ */
+static int read_token(FILE* file, char* token, int* line_end)
+{
+    int ch;
+    do
+    {
+        ch = read_header_char(file);
+    } while (is_space(ch));
+    if (ch == EOF)
+    {
+        return -1;
+    }
+    int length = 0;
+    while (ch != EOF && !is_space(ch))
+    {
+        if (length < PNM_MAX_TOKEN - 1)
+        {
+            token[length++] = (char)ch;
+        }
+        ch = getc(file);
+    }
+    token[length] = 0;
+    *line_end = ch == '\n' || ch == '\r' || ch == EOF;
+    return 0;
+}
+
+/**
+ * @brief Parses a PAM header (after "P7")
+ * @return 0 on success, -1 on an invalid or unsupported header
+ */
+static int read_pam_header(pnm_stream* s)
+{
+    char token[PNM_MAX_TOKEN];
+    int line_end;
+    s->width = s->height = s->channels = s->maxval = -1;
+    while (read_token(s->file, token, &line_end) == 0)
+    {
+        if (strcmp(token, "ENDHDR") == 0)
+        {
+            return s->width > 0 && s->height > 0 && s->channels >= 1 && s->channels <= 4 &&
+                   s->maxval >= 1 && s->maxval <= 65535 ? 0 : -1;
+        }
+        if (strcmp(token, "TUPLTYPE") == 0)
+        {
+            // The channel count comes from DEPTH, the type name is informative
+            while (!line_end && read_token(s->file, token, &line_end) == 0)
+            {
+            }
+            continue;
+        }
+        int* field = strcmp(token, "WIDTH") == 0 ? &s->width
+                     : strcmp(token, "HEIGHT") == 0 ? &s->height
+                     : strcmp(token, "DEPTH") == 0 ? &s->channels
+                     : strcmp(token, "MAXVAL") == 0 ? &s->maxval : NULL;
+        if (!field || read_number(s->file, field) != 0)
+        {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Opens a Netpbm image for reading row by row
+ * @param s Stream to initialize, released with pnm_close()
+ * @param file File positioned at the start of the image (stays open after
+ *             pnm_close(), the caller closes it)
+ * @return 0 on success, -1 if the data is not a supported Netpbm image
+ *
+ * @details On success s->width, s->height and s->channels describe the rows
+ *          pnm_read_row() returns: 1 channel for P1, P2, P4 and P5, 3 for P3
+ *          and P6, the depth of a PAM.
+ */
+int pnm_open_read(pnm_stream* s, FILE* file)
+{
+    memset(s, 0, sizeof(*s));
+    s->file = file;
+    if (getc(file) != 'P')
+    {
+        return -1;
+    }
+    int type = getc(file);
+    if (type < '1' || type > '7')
+    {
+        return -1;
+    }
+    s->format = type - '0';
+
+    if (s->format == 7)
+    {
+        if (read_pam_header(s) != 0)
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        if (read_number(file, &s->width) != 0 || read_number(file, &s->height) != 0)
+        {
+            return -1;
+        }
+        s->maxval = 1;
+        if (s->format != 1 && s->format != 4 && read_number(file, &s->maxval) != 0)
+        {
+            return -1;
+        }
+        s->channels = s->format == 3 || s->format == 6 ? 3 : 1;
+        if (s->width <= 0 || s->height <= 0 || s->maxval < 1 || s->maxval > 65535)
+        {
+            return -1;
+        }
+    }
+    // The header alone must not be able to demand gigabytes before any pixel data is read
+    if ((unsigned long long)s->width * (unsigned long long)s->height >= PNM_PIXELS_MAX)
+    {
+        return -1;
+    }
+
+    // One row as stored in the file (raw formats)
+    size_t samples = image_size(s->width, 1, s->channels);
+    size_t bytes = s->format == 4 ? ((size_t)s->width + 7) / 8 : samples * (s->maxval > 255 ? 2 : 1);
+    s->buffer = samples ? (unsigned char*)malloc(bytes) : NULL;
+    return s->buffer ? 0 : -1;
+}
+
+/**
+ * @brief Scales a sample of the file to 8 bits
+ */
+static unsigned char scale_sample(unsigned v, int maxval)
+{
+    if (v >= (unsigned)maxval)
+    {
+        return 255;
+    }
+    return (unsigned char)((v * 255u + (unsigned)maxval / 2) / (unsigned)maxval);
+}
+
+/**
+ * @brief Reads the next row of an image opened with pnm_open_read()
+ * @param s Stream
+ * @param row Output: width * channels 8-bit samples
+ * @return 0 on success, -1 on truncated or invalid data
+ */
+int pnm_read_row(pnm_stream* s, unsigned char* row)
+{
+    if (s->row >= s->height)
+    {
+        return -1;
+    }
+    s->row++;
+    size_t samples = (size_t)s->width * s->channels;
+
+    if (s->format == 4)
+    {
+        // Packed bits, 1 is black
+        size_t bytes = ((size_t)s->width + 7) / 8;
+        if (fread(s->buffer, 1, bytes, s->file) != bytes)
+        {
+            return -1;
+        }
+        for (size_t x = 0; x < samples; x++)
+        {
+            row[x] = (s->buffer[x / 8] >> (7 - x % 8)) & 1 ? 0 : 255;
+        }
+        return 0;
+    }
+
+    if (s->format <= 3)
+    {
+        // Plain: decimal samples; P1 digits may be written without separators
+        for (size_t i = 0; i < samples; i++)
+        {
+            int v;
+            if (s->format == 1)
+            {
+                int ch;
+                do
+                {
+                    ch = read_header_char(s->file);
+                } while (is_space(ch));
+                if (ch != '0' && ch != '1')
+                {
+                    return -1;
+                }
+                row[i] = ch == '1' ? 0 : 255;
+                continue;
+            }
+            if (read_number(s->file, &v) != 0)
+            {
+                return -1;
+            }
+            row[i] = scale_sample((unsigned)v, s->maxval);
+        }
+        return 0;
+    }
+
+    if (s->maxval > 255)
+    {
+        // Raw 16-bit, most significant byte first
+        if (fread(s->buffer, 2, samples, s->file) != samples)
+        {
+            return -1;
+        }
+        for (size_t i = 0; i < samples; i++)
+        {
+            row[i] = scale_sample((unsigned)s->buffer[2 * i] << 8 | s->buffer[2 * i + 1], s->maxval);
+        }
+        return 0;
+    }
+
+    if (fread(row, 1, samples, s->file) != samples)
+    {
+        return -1;
+    }
+    if (s->maxval != 255)
+    {
+        for (size_t i = 0; i < samples; i++)
+        {
+            row[i] = scale_sample(row[i], s->maxval);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens a Netpbm image for writing row by row and writes its header
+ * @param s Stream to initialize, released with pnm_close()
+ * @param file Output file (stays open after pnm_close(), the caller closes it)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of channels of the rows passed to pnm_write_row() (1-4)
+ * @param format PNM_AUTO, PNM_PGM, PNM_PPM or PNM_PAM
+ * @return 0 on success, -1 on error
+ *
+ * @details PGM gets the luma of color rows, PPM repeats gray into RGB; both
+ *          drop alpha. PAM stores the rows as they are. PNM_AUTO picks PGM
+ *          for 1-2 channels and PPM for 3-4.
+ */
+int pnm_open_write(pnm_stream* s, FILE* file, int width, int height, int channels, int format)
+{
+    memset(s, 0, sizeof(*s));
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4)
+    {
+        return -1;
+    }
+    if (format == PNM_AUTO)
+    {
+        format = channels >= 3 ? PNM_PPM : PNM_PGM;
+    }
+    s->file = file;
+    s->width = width;
+    s->height = height;
+    s->channels = channels;
+    s->format = format;
+    s->maxval = 255;
+
+    int file_channels = format == PNM_PGM ? 1 : format == PNM_PPM ? 3 : channels;
+    size_t bytes = image_size(width, 1, file_channels);
+    s->buffer = bytes ? (unsigned char*)malloc(bytes) : NULL;
+    if (!s->buffer)
+    {
+        return -1;
+    }
+
+    int res;
+    if (format == PNM_PAM)
+    {
+        static const char* const tuple_types[4] = {"GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"};
+        res = fprintf(file, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n", width,
+                      height, channels, tuple_types[channels - 1]);
+    }
+    else
+    {
+        res = fprintf(file, "P%d\n%d %d\n255\n", format, width, height);
+    }
+    return res > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Writes the next row of an image opened with pnm_open_write()
+ * @param s Stream
+ * @param row width * channels samples
+ * @return 0 on success, -1 on a write error
+ */
+int pnm_write_row(pnm_stream* s, const unsigned char* row)
+{
+    size_t width = (size_t)s->width;
+    int c = s->channels;
+    const unsigned char* out = row;
+    size_t bytes = width * c;
+
+    if (s->format == PNM_PGM && c >= 3)
+    {
+        // BT.601 luma, 16-bit fixed point
+        for (size_t x = 0; x < width; x++)
+        {
+            const unsigned char* p = row + x * c;
+            s->buffer[x] = (unsigned char)((19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16);
+        }
+        out = s->buffer;
+        bytes = width;
+    }
+    else if (s->format == PNM_PGM && c == 2)
+    {
+        for (size_t x = 0; x < width; x++)
+        {
+            s->buffer[x] = row[x * 2];
+        }
+        out = s->buffer;
+        bytes = width;
+    }
+    else if (s->format == PNM_PPM && c != 3)
+    {
+        for (size_t x = 0; x < width; x++)
+        {
+            const unsigned char* p = row + x * c;
+            s->buffer[x * 3] = p[0];
+            s->buffer[x * 3 + 1] = c >= 3 ? p[1] : p[0];
+            s->buffer[x * 3 + 2] = c >= 3 ? p[2] : p[0];
+        }
+        out = s->buffer;
+        bytes = width * 3;
+    }
+
+    s->row++;
+    return fwrite(out, 1, bytes, s->file) == bytes ? 0 : -1;
+}
+
+/**
+ * @brief Releases the row buffer of a stream (the file is not closed)
+ * @param s Stream
+ */
+void pnm_close(pnm_stream* s)
+{
+    free(s->buffer);
+    s->buffer = NULL;
+}
+
+/**
+ * @brief Decodes a whole Netpbm image
+ * @param file File positioned at the start of the image
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free(), NULL if the data is not a valid
+ *         Netpbm image
+ */
+unsigned char* pnm_load(FILE* file, int* width, int* height, int* channels)
+{
+    pnm_stream s;
+    if (pnm_open_read(&s, file) != 0)
+    {
+        pnm_close(&s);
+        return NULL;
+    }
+    unsigned char* image = alloc_image(s.width, s.height, s.channels);
+    size_t row = (size_t)s.width * s.channels;
+    for (int y = 0; image && y < s.height; y++)
+    {
+        if (pnm_read_row(&s, image + (size_t)y * row) != 0)
+        {
+            free(image);
+            image = NULL;
+        }
+    }
+    if (image)
+    {
+        *width = s.width;
+        *height = s.height;
+        *channels = s.channels;
+    }
+    pnm_close(&s);
+    return image;
+}
+
+/**
+ * @brief Reads the size of a Netpbm image from its header
+ * @param file File positioned at the start of the image
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return 1 if the file is a supported Netpbm image, 0 otherwise
+ */
+int pnm_info(FILE* file, int* width, int* height, int* channels)
+{
+    pnm_stream s;
+    int ok = pnm_open_read(&s, file) == 0;
+    if (ok)
+    {
+        *width = s.width;
+        *height = s.height;
+        *channels = s.channels;
+    }
+    pnm_close(&s);
+    return ok;
+}
+
+/**
+ * @brief Checks whether data starts with a Netpbm magic number ("P1" to "P7")
+ * @param file File positioned at the start of the data
+ * @return 1 for Netpbm data, valid or not, 0 otherwise
+ */
+int pnm_test(FILE* file)
+{
+    int p = getc(file);
+    int type = getc(file);
+    return p == 'P' && type >= '1' && type <= '7' && is_space(getc(file));
+}
+
+/**
+ * @brief Writes an image as PGM, PPM or PAM
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @param format PNM_AUTO, PNM_PGM, PNM_PPM or PNM_PAM
+ * @return Non-zero on success, 0 on error
+ */
+int pnm_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride,
+              int format)
+{
+    pnm_stream s;
+    int ok = pnm_open_write(&s, file, width, height, channels, format) == 0;
+    for (int y = 0; ok && y < height; y++)
+    {
+        ok = pnm_write_row(&s, data + (size_t)y * stride) == 0;
+    }
+    pnm_close(&s);
+    return ok;
+}
@@ -0,0 +1,602 @@
+/**
+ * @file prefetch.c
+ * @brief Implementation of reading the next input files ahead of the workers
+ *
+ * @details In a batch the files are read while the workers decode, process
+ *          and encode earlier ones, so the cores do not wait for the disk.
+ *          On Linux the reads for up to `window` files are issued at once
+ *          through io_uring from a single thread; where io_uring is missing
+ *          (older kernels, seccomp filters, other systems) a few threads read
+ *          the files with stdio instead. A worker asking for a file that has
+ *          not been started yet reads it itself, so a slow prefetcher never
+ *          holds the batch up.
+ */
+#include "functions.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PREFETCH_IO_URING
+#endif
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef PREFETCH_IO_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PREFETCH_PENDING 0 ///< Not read yet
+#define PREFETCH_READING 1 ///< Read in progress
+#define PREFETCH_READY 2   ///< Read finished, the bytes (or NULL on error) wait for a worker
+#define PREFETCH_TAKEN 3   ///< Handed to a worker
+
+#define PREFETCH_THREADS 2          ///< Reader threads without io_uring
+#define PREFETCH_MAX_READ (1 << 30) ///< Largest single read request
+
+/**
+ * @brief Sleeps about a millisecond while waiting for a read or for room
+ */
+static void wait_briefly(void)
+{
+#ifdef _WIN32
+    Sleep(1);
+#else
+    struct timespec pause = {0, 1000000};
+    nanosleep(&pause, NULL);
+#endif
+}
+
+/**
+ * @brief Marks a file as being read if nobody has started it yet
+ * @return 1 if the caller should read the file, 0 if it is taken or done
+ */
+static int claim_file(prefetch_queue* queue, int index)
+{
+    int claimed = 0;
+    #pragma omp critical(prefetch)
+    {
+        if (queue->states[index] == PREFETCH_PENDING)
+        {
+            queue->states[index] = PREFETCH_READING;
+            claimed = 1;
+        }
+    }
+    return claimed;
+}
+
+/**
+ * @brief Publishes the bytes of a read file
+ * @param data File contents, NULL if the read failed (the worker reads it then)
+ */
+static void finish_file(prefetch_queue* queue, int index, unsigned char* data, size_t size)
+{
+    #pragma omp critical(prefetch)
+    {
+        queue->data[index] = data;
+        queue->sizes[index] = size;
+        queue->states[index] = PREFETCH_READY;
+    }
+}
+
+/**
+ * @brief Files that may be read now: those before the first file no worker has taken, plus the window
+ */
+static int read_limit(prefetch_queue* queue)
+{
+    int next;
+    #pragma omp atomic read
+    next = queue->next;
+    return next + queue->window < queue->count ? next + queue->window : queue->count;
+}
+
+/**
+ * @brief Reads a whole file with stdio
+ * @return Bytes released with free(), NULL on error or for an empty file
+ */
+static unsigned char* read_file(const char* path, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        return NULL;
+    }
+    unsigned char* data = NULL;
+    long length = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (length > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = (unsigned char*)malloc((size_t)length);
+        if (data && fread(data, 1, (size_t)length, file) != (size_t)length)
+        {
+            free(data);
+            data = NULL;
+        }
+        *size = (size_t)length;
+    }
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Reader thread of the stdio fallback: reads the files of the window in order
+ */
+static void run_threads(prefetch_queue* queue)
+{
+    for (int i = 0; i < queue->count; i++)
+    {
+        while (i >= read_limit(queue))
+        {
+            wait_briefly();
+        }
+        if (claim_file(queue, i))
+        {
+            size_t size = 0;
+            unsigned char* data = read_file(queue->paths[i], &size);
+            finish_file(queue, i, data, size);
+        }
+    }
+}
+
+#ifdef PREFETCH_IO_URING
+
+/**
+ * @brief Submission and completion rings shared with the kernel
+ */
+typedef struct
+{
+    int fd;                     ///< io_uring instance
+    unsigned entries;           ///< Submission queue size
+    unsigned* sq_head;          ///< First entry the kernel has not consumed
+    unsigned* sq_tail;          ///< Next entry to fill
+    unsigned* sq_mask;          ///< Ring index mask
+    unsigned* sq_array;         ///< Indices of the submitted entries
+    struct io_uring_sqe* sqes;  ///< Submission entries
+    unsigned* cq_head;          ///< Next completion to read
+    unsigned* cq_tail;          ///< End of the completions written by the kernel
+    unsigned* cq_mask;          ///< Ring index mask
+    struct io_uring_cqe* cqes;  ///< Completion entries
+    void* sq_ring;              ///< Mapping of the submission ring
+    size_t sq_ring_size;        ///< Its length
+    void* cq_ring;              ///< Mapping of the completion ring (same as sq_ring with a single mapping)
+    size_t cq_ring_size;        ///< Its length
+    size_t sqes_size;           ///< Length of the submission entries mapping
+} uring;
+
+/**
+ * @brief One file being read through the ring
+ */
+typedef struct
+{
+    int index;           ///< File in the queue, -1 for a free slot
+    int fd;              ///< Open file
+    unsigned char* data; ///< Destination buffer
+    size_t size;         ///< File size
+    size_t done;         ///< Bytes read so far
+} uring_read;
+
+/**
+ * @brief Releases the rings and closes the instance
+ */
+static void uring_close(uring* ring)
+{
+    if (ring->sqes)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring)
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+/**
+ * @brief Creates an io_uring instance without liburing
+ * @param entries Requests in flight at once
+ * @return Instance released with uring_close(), NULL if io_uring is unavailable
+ */
+static uring* uring_open(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    uring* ring = (uring*)calloc(1, sizeof(uring));
+    if (!ring)
+    {
+        close(fd);
+        return NULL;
+    }
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+
+    // Kernels with IORING_FEAT_SINGLE_MMAP share one mapping for both rings
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cq_ring_size > ring->sq_ring_size)
+    {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    void* sq = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                    IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+    {
+        uring_close(ring);
+        return NULL;
+    }
+    ring->sq_ring = sq;
+    void* cq = sq;
+    if (!single)
+    {
+        cq = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                  IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+        {
+            uring_close(ring);
+            return NULL;
+        }
+    }
+    ring->cq_ring = cq;
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        uring_close(ring);
+        return NULL;
+    }
+    ring->sqes = (struct io_uring_sqe*)sqes;
+
+    unsigned char* s = (unsigned char*)sq;
+    unsigned char* c = (unsigned char*)cq;
+    ring->sq_head = (unsigned*)(s + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(s + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(s + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(s + params.sq_off.array);
+    ring->cq_head = (unsigned*)(c + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(c + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(c + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(c + params.cq_off.cqes);
+    return ring;
+}
+
+/**
+ * @brief Queues a read of the rest of a file (submitted by the next uring_enter())
+ * @param slot Index of the read, returned as the completion's user data
+ */
+static void uring_queue_read(uring* ring, uring_read* read, unsigned slot)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    size_t length = read->size - read->done;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = read->fd;
+    sqe->addr = (unsigned long long)(uintptr_t)(read->data + read->done);
+    sqe->len = (unsigned)(length < PREFETCH_MAX_READ ? length : PREFETCH_MAX_READ);
+    sqe->off = read->done;
+    sqe->user_data = slot;
+    ring->sq_array[index] = index;
+    // The entry must be complete before the kernel sees the new tail
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Submits queued reads and waits for completions
+ * @return Number of requests the kernel took, -1 on error
+ */
+static int uring_enter(uring* ring, unsigned submit, unsigned wait)
+{
+    int res;
+    do
+    {
+        res = (int)syscall(__NR_io_uring_enter, ring->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0,
+                           NULL, 0);
+    } while (res < 0 && errno == EINTR);
+    return res;
+}
+
+/**
+ * @brief Reads the rest of a file with blocking reads (kernels without IORING_OP_READ)
+ * @return 1 if the whole file was read
+ */
+static int read_rest(uring_read* read)
+{
+    while (read->done < read->size)
+    {
+        size_t length = read->size - read->done;
+        if (length > PREFETCH_MAX_READ)
+        {
+            length = PREFETCH_MAX_READ;
+        }
+        ssize_t count = pread(read->fd, read->data + read->done, length, (off_t)read->done);
+        if (count <= 0 && !(count < 0 && errno == EINTR))
+        {
+            return 0;
+        }
+        read->done += count > 0 ? (size_t)count : 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Ends the read of a file and hands its bytes to the workers
+ * @param ok Non-zero if the whole file was read
+ */
+static void uring_finish(prefetch_queue* queue, uring_read* read, int ok)
+{
+    close(read->fd);
+    if (!ok)
+    {
+        free(read->data);
+        read->data = NULL;
+    }
+    finish_file(queue, read->index, read->data, read->size);
+    read->index = -1;
+}
+
+/**
+ * @brief Opens a file and prepares its read in a free slot
+ * @return 1 if a read was queued, 0 if the file is handed over as failed or taken
+ */
+static int uring_start(prefetch_queue* queue, uring* ring, uring_read* read, unsigned slot, int index)
+{
+    if (!claim_file(queue, index))
+    {
+        return 0;
+    }
+    int fd = open(queue->paths[index], O_RDONLY | O_NONBLOCK);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 ||
+        (unsigned long long)info.st_size > SIZE_MAX)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        finish_file(queue, index, NULL, 0);
+        return 0;
+    }
+    read->index = index;
+    read->fd = fd;
+    read->size = (size_t)info.st_size;
+    read->done = 0;
+    read->data = (unsigned char*)malloc(read->size);
+    if (!read->data)
+    {
+        uring_finish(queue, read, 0);
+        return 0;
+    }
+    uring_queue_read(ring, read, slot);
+    return 1;
+}
+
+/**
+ * @brief Prefetch loop with io_uring: keeps reads for the whole window in flight
+ * @return 0 when all files are done, -1 if the ring failed (the caller
+ *         finishes with the stdio readers, files in flight are handed over as failed)
+ */
+static int run_uring(prefetch_queue* queue, uring* ring)
+{
+    uring_read* reads = (uring_read*)malloc(ring->entries * sizeof(uring_read));
+    if (!reads)
+    {
+        return -1;
+    }
+    for (unsigned i = 0; i < ring->entries; i++)
+    {
+        reads[i].index = -1;
+    }
+
+    int cursor = 0;
+    unsigned in_flight = 0, queued = 0;
+    int res = 0;
+    while (cursor < queue->count || in_flight > 0)
+    {
+        // Start every file of the window there is a free slot for
+        int limit = read_limit(queue);
+        for (unsigned slot = 0; slot < ring->entries && cursor < limit; slot++)
+        {
+            if (reads[slot].index < 0 && uring_start(queue, ring, &reads[slot], slot, cursor++))
+            {
+                in_flight++;
+                queued++;
+            }
+        }
+        if (in_flight == 0)
+        {
+            if (cursor < queue->count)
+            {
+                wait_briefly();
+            }
+            continue;
+        }
+
+        if (uring_enter(ring, queued, 1) < 0)
+        {
+            res = -1;
+            break;
+        }
+        queued = 0;
+
+        // Completions: finished files go to the workers, short reads continue
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            uring_read* read = &reads[cqe->user_data];
+            if (cqe->res > 0)
+            {
+                read->done += (size_t)cqe->res;
+            }
+            if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP)
+            {
+                // IORING_OP_READ needs Linux 5.6
+                uring_finish(queue, read, read_rest(read));
+                in_flight--;
+            }
+            else if (read->done == read->size || cqe->res == 0 ||
+                     (cqe->res < 0 && cqe->res != -EINTR && cqe->res != -EAGAIN))
+            {
+                uring_finish(queue, read, read->done == read->size);
+                in_flight--;
+            }
+            else
+            {
+                uring_queue_read(ring, read, (unsigned)cqe->user_data);
+                queued++;
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    // After a ring error the reads still in flight are abandoned, the workers read those files
+    for (unsigned slot = 0; res != 0 && slot < ring->entries; slot++)
+    {
+        if (reads[slot].index >= 0)
+        {
+            uring_finish(queue, &reads[slot], 0);
+        }
+    }
+    free(reads);
+    return res;
+}
+
+#endif
+
+/**
+ * @brief Prepares reading a list of files ahead
+ * @param queue Queue to initialize, released with prefetch_close()
+ * @param paths Files in the order the workers take them (kept by the caller)
+ * @param count Number of files
+ * @param window Files read ahead of the first one no worker has taken
+ * @return 0 on success, -1 if memory allocation fails
+ */
+int prefetch_open(prefetch_queue* queue, char** paths, int count, int window)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->paths = paths;
+    queue->count = count;
+    queue->window = window > 0 ? window : 1;
+    queue->data = (unsigned char**)calloc(count > 0 ? count : 1, sizeof(unsigned char*));
+    queue->sizes = (size_t*)calloc(count > 0 ? count : 1, sizeof(size_t));
+    queue->states = (int*)calloc(count > 0 ? count : 1, sizeof(int));
+    if (!queue->data || !queue->sizes || !queue->states)
+    {
+        prefetch_close(queue);
+        return -1;
+    }
+#ifdef PREFETCH_IO_URING
+    queue->ring = uring_open((unsigned)queue->window);
+#endif
+    queue->readers = queue->ring ? 1 : PREFETCH_THREADS;
+    return 0;
+}
+
+/**
+ * @brief Reads files ahead until every file is read or taken
+ * @param queue Queue
+ *
+ * @details Called by queue->readers threads at the same time, next to the
+ *          workers. With io_uring one thread keeps all reads of the window
+ *          in flight; otherwise every reader reads the next unclaimed file
+ *          with stdio.
+ */
+void prefetch_run(prefetch_queue* queue)
+{
+#ifdef PREFETCH_IO_URING
+    if (queue->ring && run_uring(queue, (uring*)queue->ring) == 0)
+    {
+        return;
+    }
+#endif
+    run_threads(queue);
+}
+
+/**
+ * @brief Gives a worker the next file to process
+ * @param queue Queue
+ * @return Index of the file, -1 when all files are taken
+ */
+int prefetch_next(prefetch_queue* queue)
+{
+    int index;
+    #pragma omp atomic capture
+    index = queue->next++;
+    return index < queue->count ? index : -1;
+}
+
+/**
+ * @brief Takes the bytes of a file, waiting if its read is in progress
+ * @param queue Queue
+ * @param index File index from prefetch_next()
+ * @param size Output: number of bytes
+ * @return File contents released with free(), NULL if the file was not read
+ *         ahead (not started yet or failed), the caller then loads it from disk
+ */
+unsigned char* prefetch_take(prefetch_queue* queue, int index, size_t* size)
+{
+    unsigned char* data = NULL;
+    for (;;)
+    {
+        int state;
+        #pragma omp critical(prefetch)
+        {
+            state = queue->states[index];
+            if (state != PREFETCH_READING)
+            {
+                data = queue->data[index];
+                *size = queue->sizes[index];
+                queue->data[index] = NULL;
+                queue->states[index] = PREFETCH_TAKEN;
+            }
+        }
+        if (state != PREFETCH_READING)
+        {
+            return data;
+        }
+        wait_briefly();
+    }
+}
+
+/**
+ * @brief Releases a queue and the bytes no worker has taken
+ * @param queue Queue
+ */
+void prefetch_close(prefetch_queue* queue)
+{
+    for (int i = 0; queue->data && i < queue->count; i++)
+    {
+        free(queue->data[i]);
+    }
+    free(queue->data);
+    free(queue->sizes);
+    free(queue->states);
+#ifdef PREFETCH_IO_URING
+    if (queue->ring)
+    {
+        uring_close((uring*)queue->ring);
+    }
+#endif
+    memset(queue, 0, sizeof(*queue));
+}
@@ -0,0 +1,356 @@
+/**
+ * @file qoi.c
+ * @brief Implementation of the QOI ("Quite OK Image") format
+ *
+ * @details QOI is a lossless format for intermediate files: every pixel is
+ *          coded in one pass as a run of the previous pixel, a reference to
+ *          one of 64 recently seen colors, a small difference to the previous
+ *          pixel or the raw value. Writing and reading are several times
+ *          faster than PNG at a similar size for photos. Both directions
+ *          stream through a fixed buffer, so no file-sized copy is made.
+ */
+#include "functions.h"
+
+#define QOI_HEADER_SIZE 14         ///< Magic, width, height, channels, colorspace
+#define QOI_MAX_OP_SIZE 5          ///< Largest code of one pixel (QOI_OP_RGBA)
+#define QOI_BUFFER_SIZE 65536      ///< Bytes read or written per file access
+#define QOI_MAX_RUN 62             ///< Longest run of one QOI_OP_RUN
+#define QOI_PIXELS_MAX 400000000ul ///< Largest image accepted, as in the reference decoder
+
+#define QOI_OP_INDEX 0x00 ///< 00xxxxxx: color from the index
+#define QOI_OP_DIFF 0x40  ///< 01rrggbb: difference -2..1 per channel
+#define QOI_OP_LUMA 0x80  ///< 10gggggg rrrrbbbb: green difference and red/blue relative to it
+#define QOI_OP_RUN 0xC0   ///< 11xxxxxx: previous pixel repeated 1-62 times
+#define QOI_OP_RGB 0xFE   ///< New red, green and blue, same alpha
+#define QOI_OP_RGBA 0xFF  ///< New red, green, blue and alpha
+
+/// Stream end marker: 7 zero bytes and a one
+static const unsigned char qoi_padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+/**
+ * @brief One RGBA pixel
+ */
+typedef struct
+{
+    unsigned char r, g, b, a;
+} qoi_pixel;
+
+static int qoi_hash(qoi_pixel p)
+{
+    return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+}
+
+static int qoi_equal(qoi_pixel a, qoi_pixel b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static void put_u32(unsigned char* p, unsigned long v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static unsigned long get_u32(const unsigned char* p)
+{
+    return (unsigned long)p[0] << 24 | (unsigned long)p[1] << 16 | (unsigned long)p[2] << 8 | p[3];
+}
+
+/**
+ * @brief Writes an image as QOI
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4; gray is stored as RGB,
+ *                 gray with alpha as RGBA, since QOI has only those two)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @return Non-zero on success, 0 on error
+ */
+int qoi_write(FILE* file, int width, int height, int channels, const unsigned char* data, int stride)
+{
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4)
+    {
+        return 0;
+    }
+    unsigned char* buffer = (unsigned char*)malloc(QOI_BUFFER_SIZE);
+    if (!buffer)
+    {
+        return 0;
+    }
+
+    // Header; colorspace 0 is sRGB with linear alpha
+    int has_alpha = channels == 2 || channels == 4;
+    memcpy(buffer, "qoif", 4);
+    put_u32(buffer + 4, (unsigned long)width);
+    put_u32(buffer + 8, (unsigned long)height);
+    buffer[12] = (unsigned char)(has_alpha ? 4 : 3);
+    buffer[13] = 0;
+    size_t size = QOI_HEADER_SIZE;
+
+    qoi_pixel index[64];
+    memset(index, 0, sizeof(index));
+    qoi_pixel prev = {0, 0, 0, 255};
+    int run = 0;
+    int ok = 1;
+
+    for (int y = 0; ok && y < height; y++)
+    {
+        const unsigned char* row = data + (size_t)y * stride;
+        for (int x = 0; x < width; x++)
+        {
+            // Flushed before every pixel, so its codes always fit: a run ended
+            // by the pixel plus its own code, or a run reaching QOI_MAX_RUN
+            if (size > QOI_BUFFER_SIZE - 2 * QOI_MAX_OP_SIZE)
+            {
+                ok = fwrite(buffer, 1, size, file) == size;
+                size = 0;
+                if (!ok)
+                {
+                    break;
+                }
+            }
+
+            const unsigned char* s = row + (size_t)x * channels;
+            qoi_pixel p;
+            if (channels >= 3)
+            {
+                p.r = s[0];
+                p.g = s[1];
+                p.b = s[2];
+                p.a = channels == 4 ? s[3] : 255;
+            }
+            else
+            {
+                p.r = p.g = p.b = s[0];
+                p.a = channels == 2 ? s[1] : 255;
+            }
+
+            if (qoi_equal(p, prev))
+            {
+                if (++run == QOI_MAX_RUN)
+                {
+                    buffer[size++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run)
+            {
+                buffer[size++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            int hash = qoi_hash(p);
+            if (qoi_equal(index[hash], p))
+            {
+                buffer[size++] = (unsigned char)(QOI_OP_INDEX | hash);
+            }
+            else
+            {
+                index[hash] = p;
+                if (p.a == prev.a)
+                {
+                    // Differences wrap around like the decoder's byte arithmetic
+                    int dr = (signed char)(p.r - prev.r);
+                    int dg = (signed char)(p.g - prev.g);
+                    int db = (signed char)(p.b - prev.b);
+                    int dr_dg = dr - dg, db_dg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        buffer[size++] = (unsigned char)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+                    {
+                        buffer[size++] = (unsigned char)(QOI_OP_LUMA | (dg + 32));
+                        buffer[size++] = (unsigned char)((dr_dg + 8) << 4 | (db_dg + 8));
+                    }
+                    else
+                    {
+                        buffer[size++] = QOI_OP_RGB;
+                        buffer[size++] = p.r;
+                        buffer[size++] = p.g;
+                        buffer[size++] = p.b;
+                    }
+                }
+                else
+                {
+                    buffer[size++] = QOI_OP_RGBA;
+                    buffer[size++] = p.r;
+                    buffer[size++] = p.g;
+                    buffer[size++] = p.b;
+                    buffer[size++] = p.a;
+                }
+            }
+            prev = p;
+        }
+    }
+
+    if (ok)
+    {
+        // The last pixel left room for a run code, not for the padding as well
+        if (run)
+        {
+            buffer[size++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+        }
+        ok = fwrite(buffer, 1, size, file) == size &&
+             fwrite(qoi_padding, 1, sizeof(qoi_padding), file) == sizeof(qoi_padding);
+    }
+    free(buffer);
+    return ok;
+}
+
+/**
+ * @brief Reads the header of a QOI file
+ * @param file File positioned at its start, the position is left after the header
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels (3 or 4)
+ * @return 1 if the file is a valid QOI image, 0 otherwise
+ */
+int qoi_info(FILE* file, int* width, int* height, int* channels)
+{
+    unsigned char header[QOI_HEADER_SIZE];
+    if (fread(header, 1, QOI_HEADER_SIZE, file) != QOI_HEADER_SIZE || memcmp(header, "qoif", 4) != 0)
+    {
+        return 0;
+    }
+    unsigned long w = get_u32(header + 4);
+    unsigned long h = get_u32(header + 8);
+    // The header alone must not be able to demand gigabytes before any pixel data is read
+    if (w == 0 || h == 0 || w > INT_MAX || h > INT_MAX || h >= QOI_PIXELS_MAX / w ||
+        (header[12] != 3 && header[12] != 4) || header[13] > 1)
+    {
+        return 0;
+    }
+    *width = (int)w;
+    *height = (int)h;
+    *channels = header[12];
+    return 1;
+}
+
+/**
+ * @brief Decodes a QOI image
+ * @param file File positioned at its start
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels (3 or 4)
+ * @return Image data released with free() (or stbi_image_free()), NULL on
+ *         error or truncated data
+ */
+unsigned char* qoi_read(FILE* file, int* width, int* height, int* channels)
+{
+    int w, h, c;
+    if (!qoi_info(file, &w, &h, &c))
+    {
+        return NULL;
+    }
+    unsigned char* image = alloc_image(w, h, c);
+    // Room for the longest code past the valid bytes, zeroed so it never reads garbage
+    unsigned char* buffer = (unsigned char*)calloc(QOI_BUFFER_SIZE + QOI_MAX_OP_SIZE, 1);
+    if (!image || !buffer)
+    {
+        free(image);
+        free(buffer);
+        return NULL;
+    }
+
+    qoi_pixel index[64];
+    memset(index, 0, sizeof(index));
+    qoi_pixel p = {0, 0, 0, 255};
+    size_t pos = 0, end = 0;
+    int run = 0;
+    int ok = 1;
+    size_t total = image_size(w, h, c);
+
+    for (size_t i = 0; i < total; i += c)
+    {
+        if (run > 0)
+        {
+            run--;
+        }
+        else
+        {
+            if (end - pos < QOI_MAX_OP_SIZE)
+            {
+                // Refill: keep the unread bytes, append what the file has
+                memmove(buffer, buffer + pos, end - pos);
+                end -= pos;
+                pos = 0;
+                end += fread(buffer + end, 1, QOI_BUFFER_SIZE - end, file);
+                memset(buffer + end, 0, QOI_MAX_OP_SIZE);
+                if (pos == end)
+                {
+                    ok = 0;
+                    break;
+                }
+            }
+
+            int op = buffer[pos++];
+            if (op == QOI_OP_RGB)
+            {
+                p.r = buffer[pos];
+                p.g = buffer[pos + 1];
+                p.b = buffer[pos + 2];
+                pos += 3;
+            }
+            else if (op == QOI_OP_RGBA)
+            {
+                p.r = buffer[pos];
+                p.g = buffer[pos + 1];
+                p.b = buffer[pos + 2];
+                p.a = buffer[pos + 3];
+                pos += 4;
+            }
+            else if ((op & 0xC0) == QOI_OP_INDEX)
+            {
+                p = index[op];
+            }
+            else if ((op & 0xC0) == QOI_OP_DIFF)
+            {
+                p.r = (unsigned char)(p.r + ((op >> 4) & 3) - 2);
+                p.g = (unsigned char)(p.g + ((op >> 2) & 3) - 2);
+                p.b = (unsigned char)(p.b + (op & 3) - 2);
+            }
+            else if ((op & 0xC0) == QOI_OP_LUMA)
+            {
+                int second = buffer[pos++];
+                int dg = (op & 0x3F) - 32;
+                p.r = (unsigned char)(p.r + dg - 8 + (second >> 4));
+                p.g = (unsigned char)(p.g + dg);
+                p.b = (unsigned char)(p.b + dg - 8 + (second & 0x0F));
+            }
+            else
+            {
+                run = op & 0x3F;
+            }
+            if (pos > end)
+            {
+                ok = 0;
+                break;
+            }
+            index[qoi_hash(p)] = p;
+        }
+
+        image[i] = p.r;
+        image[i + 1] = p.g;
+        image[i + 2] = p.b;
+        if (c == 4)
+        {
+            image[i + 3] = p.a;
+        }
+    }
+
+    free(buffer);
+    if (!ok)
+    {
+        free(image);
+        return NULL;
+    }
+    *width = w;
+    *height = h;
+    *channels = c;
+    return image;
+}
@@ -0,0 +1,315 @@
+/**
+ * @file raw_image.c
+ * @brief Implementation of the raw pixel container for hand-offs between commands
+ *
+ * @details A .raw file is a 64-byte header followed by the pixels exactly as
+ *          they are in memory, starting 64-byte aligned. Nothing is encoded:
+ *          the writer copies the rows into a mapped output file and the loader
+ *          maps the file and gives the operations a pointer into it, so the
+ *          pixels are only read from disk when a filter touches them.
+ *
+ *          Header, all fields 32-bit little-endian:
+ *          | Offset | Field                                  |
+ *          |--------|----------------------------------------|
+ *          | 0      | magic "IPRW"                           |
+ *          | 4      | version (1)                            |
+ *          | 8      | width                                  |
+ *          | 12     | height                                 |
+ *          | 16     | channels (1-4)                         |
+ *          | 20     | stride: bytes between rows             |
+ *          | 24     | pixel type (1: 8-bit unsigned)         |
+ *          | 28     | offset of the pixels (multiple of 64)  |
+ *          | 32-63  | reserved, zero                         |
+ */
+#include "functions.h"
+
+#define RAW_HEADER_SIZE 64 ///< Header bytes, also the alignment of the pixels
+#define RAW_VERSION 1      ///< Only version so far
+#define RAW_TYPE_U8 1      ///< 8 bits per channel, the type all operations use
+
+/**
+ * @brief Fields of a raw header
+ */
+typedef struct
+{
+    int width;
+    int height;
+    int channels;
+    size_t stride;
+    size_t offset;
+} raw_header;
+
+static void put_u32_le(unsigned char* p, unsigned long v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static unsigned long get_u32_le(const unsigned char* p)
+{
+    return p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+/**
+ * @brief Checks and decodes a raw header
+ * @param p First RAW_HEADER_SIZE bytes of the file
+ * @param header Output: decoded fields
+ * @return 1 if the header is valid, 0 otherwise
+ */
+static int parse_header(const unsigned char* p, raw_header* header)
+{
+    if (memcmp(p, "IPRW", 4) != 0 || get_u32_le(p + 4) != RAW_VERSION || get_u32_le(p + 24) != RAW_TYPE_U8)
+    {
+        return 0;
+    }
+    unsigned long width = get_u32_le(p + 8);
+    unsigned long height = get_u32_le(p + 12);
+    unsigned long channels = get_u32_le(p + 16);
+    unsigned long stride = get_u32_le(p + 20);
+    unsigned long offset = get_u32_le(p + 28);
+    if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX || channels < 1 || channels > 4 ||
+        offset < RAW_HEADER_SIZE || offset % RAW_HEADER_SIZE != 0 || stride / channels < width)
+    {
+        return 0;
+    }
+    header->width = (int)width;
+    header->height = (int)height;
+    header->channels = (int)channels;
+    header->stride = stride;
+    header->offset = offset;
+    return 1;
+}
+
+/**
+ * @brief Fills the header of a file with packed rows
+ */
+static void put_header(unsigned char* p, int width, int height, int channels, size_t row)
+{
+    memset(p, 0, RAW_HEADER_SIZE);
+    memcpy(p, "IPRW", 4);
+    put_u32_le(p + 4, RAW_VERSION);
+    put_u32_le(p + 8, (unsigned long)width);
+    put_u32_le(p + 12, (unsigned long)height);
+    put_u32_le(p + 16, (unsigned long)channels);
+    put_u32_le(p + 20, (unsigned long)row);
+    put_u32_le(p + 24, RAW_TYPE_U8);
+    put_u32_le(p + 28, RAW_HEADER_SIZE);
+}
+
+/**
+ * @brief Saves an image as a raw pixel container through a mapped file
+ * @param path Output file path
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @return Non-zero on success, 0 on error
+ *
+ * @details Rows are stored packed, so the file loads without a copy. The file
+ *          is written under a temporary name and then renamed: a command may
+ *          overwrite its own input, which is still mapped while it runs.
+ */
+int raw_write(const char* path, int width, int height, int channels, const unsigned char* data, int stride)
+{
+    size_t row = image_size(width, 1, channels);
+    size_t pixels = image_size(width, height, channels);
+    if (!pixels || pixels > SIZE_MAX - RAW_HEADER_SIZE || row > 0xFFFFFFFFul)
+    {
+        return 0;
+    }
+
+    size_t length = strlen(path);
+    char* temp = (char*)malloc(length + 5);
+    if (!temp)
+    {
+        return 0;
+    }
+    memcpy(temp, path, length);
+    memcpy(temp + length, ".tmp", 5);
+
+    size_t size = RAW_HEADER_SIZE + pixels;
+    unsigned char* file = map_new_file(temp, size);
+    if (!file)
+    {
+        free(temp);
+        return 0;
+    }
+
+    put_header(file, width, height, channels, row);
+
+    if ((size_t)stride == row)
+    {
+        memcpy(file + RAW_HEADER_SIZE, data, pixels);
+    }
+    else
+    {
+        #pragma omp parallel for
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(file + RAW_HEADER_SIZE + (size_t)y * row, data + (size_t)y * stride, row);
+        }
+    }
+
+    int ok = unmap_file(file, size) == 0 && replace_file(temp, path) == 0;
+    if (!ok)
+    {
+        remove(temp);
+    }
+    free(temp);
+    return ok;
+}
+
+/**
+ * @brief Writes an image as a raw pixel container to a stream (e.g. stdout)
+ * @param file Output stream (left open)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels (1-4)
+ * @param data Image data
+ * @param stride Distance between rows in bytes
+ * @return Non-zero on success, 0 on error
+ */
+int raw_write_stream(FILE* file, int width, int height, int channels, const unsigned char* data, int stride)
+{
+    size_t row = image_size(width, 1, channels);
+    if (!image_size(width, height, channels) || row > 0xFFFFFFFFul)
+    {
+        return 0;
+    }
+    unsigned char header[RAW_HEADER_SIZE];
+    put_header(header, width, height, channels, row);
+    int ok = fwrite(header, 1, RAW_HEADER_SIZE, file) == RAW_HEADER_SIZE;
+    for (int y = 0; ok && y < height; y++)
+    {
+        ok = fwrite(data + (size_t)y * stride, 1, row, file) == row;
+    }
+    return ok;
+}
+
+/**
+ * @brief Reads the header of a raw pixel container
+ * @param file File positioned at its start
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return 1 if the file starts with a valid raw header, 0 otherwise
+ */
+int raw_info(FILE* file, int* width, int* height, int* channels)
+{
+    unsigned char bytes[RAW_HEADER_SIZE];
+    raw_header header;
+    if (fread(bytes, 1, RAW_HEADER_SIZE, file) != RAW_HEADER_SIZE || !parse_header(bytes, &header))
+    {
+        return 0;
+    }
+    *width = header.width;
+    *height = header.height;
+    *channels = header.channels;
+    return 1;
+}
+
+/**
+ * @brief Loads a raw pixel container by mapping it
+ * @param path Path to the file
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free_image(), NULL on error
+ *
+ * @details Packed files are returned as a pointer into a private mapping:
+ *          nothing is read until it is used, and pages an operation writes to
+ *          are copied, the file stays unchanged. Files with padded rows (or
+ *          when too many images are mapped) are copied into a packed buffer.
+ */
+unsigned char* raw_load(const char* path, int* width, int* height, int* channels)
+{
+    size_t size;
+    unsigned char* file = map_file(path, &size);
+    if (!file)
+    {
+        return NULL;
+    }
+
+    raw_header header;
+    size_t row = 0, pixels = 0;
+    int valid = size >= RAW_HEADER_SIZE && parse_header(file, &header);
+    if (valid)
+    {
+        // The last row only needs its pixels, not the full stride
+        row = image_size(header.width, 1, header.channels);
+        pixels = image_size(header.width, header.height, header.channels);
+        valid = pixels && header.offset <= size && size - header.offset >= row &&
+                (size - header.offset - row) / header.stride >= (size_t)(header.height - 1);
+    }
+    if (!valid)
+    {
+        unmap_file(file, size);
+        return NULL;
+    }
+
+    unsigned char* image = file + header.offset;
+    if (header.stride != row || track_mapped_image(image, file, size) != 0)
+    {
+        unsigned char* copy = alloc_image(header.width, header.height, header.channels);
+        if (copy)
+        {
+            for (int y = 0; y < header.height; y++)
+            {
+                memcpy(copy + (size_t)y * row, image + (size_t)y * header.stride, row);
+            }
+        }
+        unmap_file(file, size);
+        image = copy;
+    }
+
+    if (image)
+    {
+        *width = header.width;
+        *height = header.height;
+        *channels = header.channels;
+    }
+    return image;
+}
+
+/**
+ * @brief Reads a raw pixel container from a stream that cannot be mapped (e.g. stdin)
+ * @param file Stream positioned at the start of the file
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param channels Output: number of color channels
+ * @return Image data released with free(), NULL on error
+ */
+unsigned char* raw_read(FILE* file, int* width, int* height, int* channels)
+{
+    unsigned char bytes[RAW_HEADER_SIZE];
+    raw_header header;
+    if (fread(bytes, 1, RAW_HEADER_SIZE, file) != RAW_HEADER_SIZE || !parse_header(bytes, &header) ||
+        fseek(file, (long)(header.offset - RAW_HEADER_SIZE), SEEK_CUR) != 0)
+    {
+        return NULL;
+    }
+
+    unsigned char* image = alloc_image(header.width, header.height, header.channels);
+    size_t row = (size_t)header.width * header.channels;
+    for (int y = 0; image && y < header.height; y++)
+    {
+        // Padding at the end of a row is skipped, except after the last one
+        if (fread(image + (size_t)y * row, 1, row, file) != row ||
+            (y + 1 < header.height && header.stride > row &&
+             fseek(file, (long)(header.stride - row), SEEK_CUR) != 0))
+        {
+            free(image);
+            image = NULL;
+        }
+    }
+    if (image)
+    {
+        *width = header.width;
+        *height = header.height;
+        *channels = header.channels;
+    }
+    return image;
+}
@@ -0,0 +1,517 @@
+/**
+ * @file remap.c
+ * @brief Implementation of precomputed remap tables
+ *
+ * @details A remap table stores, for every destination pixel, the source
+ *          position it is sampled from in fixed point. It is built once for a
+ *          camera or a transform (any trigonometry and matrix math happens
+ *          there), saved to disk and applied to any number of images of the
+ *          same size as a pure gather.
+ *
+ * Map file layout (native byte order):
+ * - 4 bytes magic "IMAP"
+ * - 5 int32 values: version, width, height, source width, source height
+ * - width * height pairs of int32 source coordinates (x, y)
+ */
+#include "functions.h"
+
+#define REMAP_MAGIC "IMAP"  ///< Map file signature
+#define REMAP_VERSION 1     ///< Map file format version
+#define REMAP_CUBIC_BITS 11 ///< Precision of the fixed-point bicubic weights
+
+/**
+ * @brief Allocates an empty remap table
+ * @param table Table to initialize
+ * @param width Destination width in pixels
+ * @param height Destination height in pixels
+ * @param src_width Source width in pixels
+ * @param src_height Source height in pixels
+ * @return 0 on success, -1 on error
+ */
+static int remap_alloc(remap_table* table, int width, int height, int src_width, int src_height)
+{
+    table->coords = NULL;
+    size_t size = image_size(width, height, 2 * (int)sizeof(int32_t));
+    if (!size)
+    {
+        return -1;
+    }
+    table->coords = (int32_t*)malloc(size);
+    if (!table->coords)
+    {
+        return -1;
+    }
+    table->width = width;
+    table->height = height;
+    table->src_width = src_width;
+    table->src_height = src_height;
+    return 0;
+}
+
+/**
+ * @brief Stores one source position in a remap table
+ * @param table Remap table
+ * @param entry Destination pixel index
+ * @param sx Source x coordinate
+ * @param sy Source y coordinate
+ *
+ * @note Positions outside the source image are marked with REMAP_OUTSIDE and
+ *       get the background color
+ */
+static void remap_store(remap_table* table, size_t entry, double sx, double sy)
+{
+    int32_t* coord = table->coords + 2 * entry;
+    if (!(sx >= -0.5 && sx < table->src_width - 0.5 && sy >= -0.5 && sy < table->src_height - 0.5))
+    {
+        coord[0] = REMAP_OUTSIDE;
+        coord[1] = REMAP_OUTSIDE;
+        return;
+    }
+    coord[0] = (int32_t)floor(sx * (1 << REMAP_FRACTION_BITS) + 0.5);
+    coord[1] = (int32_t)floor(sy * (1 << REMAP_FRACTION_BITS) + 0.5);
+}
+
+/**
+ * @brief Builds a remap table from a projective transform
+ * @param table Output table, released with remap_free()
+ * @param matrix 3x3 row-major matrix mapping destination pixel (x, y, 1)
+ *               to homogeneous source coordinates (inverse mapping)
+ * @param width Destination width in pixels
+ * @param height Destination height in pixels
+ * @param src_width Source width in pixels
+ * @param src_height Source height in pixels
+ * @return 0 on success, -1 on error
+ */
+int remap_from_matrix(remap_table* table, const double* matrix, int width, int height,
+                      int src_width, int src_height)
+{
+    if (remap_alloc(table, width, height, src_width, src_height) != 0)
+    {
+        return -1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            double sw = matrix[6] * x + matrix[7] * y + matrix[8];
+            size_t entry = (size_t)y * width + x;
+            if (sw <= 1e-12)
+            {
+                remap_store(table, entry, -1, -1);
+                continue;
+            }
+            double sx = (matrix[0] * x + matrix[1] * y + matrix[2]) / sw;
+            double sy = (matrix[3] * x + matrix[4] * y + matrix[5]) / sw;
+            remap_store(table, entry, sx, sy);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Builds a remap table that corrects radial lens distortion
+ * @param table Output table, released with remap_free()
+ * @param width Image width in pixels (source and destination)
+ * @param height Image height in pixels (source and destination)
+ * @param k1 Second-order radial coefficient
+ * @param k2 Fourth-order radial coefficient
+ * @return 0 on success, -1 on error
+ *
+ * @details Destination pixel at distance r from the image center (r = 1 at
+ *          the corners) is taken from the source at distance
+ *          r * (1 + k1 * r^2 + k2 * r^4). Positive k1 corrects pincushion
+ *          distortion, negative k1 corrects barrel distortion.
+ */
+int remap_from_lens(remap_table* table, int width, int height, double k1, double k2)
+{
+    if (remap_alloc(table, width, height, width, height) != 0)
+    {
+        return -1;
+    }
+
+    double center_x = (width - 1) / 2.0;
+    double center_y = (height - 1) / 2.0;
+    double norm = sqrt(center_x * center_x + center_y * center_y);
+    if (norm == 0)
+    {
+        norm = 1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++)
+    {
+        double dy = (y - center_y) / norm;
+        for (int x = 0; x < width; x++)
+        {
+            double dx = (x - center_x) / norm;
+            double r2 = dx * dx + dy * dy;
+            double factor = 1 + k1 * r2 + k2 * r2 * r2;
+            remap_store(table, (size_t)y * width + x,
+                        center_x + dx * factor * norm, center_y + dy * factor * norm);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Releases the coordinates of a remap table
+ * @param table Remap table
+ */
+void remap_free(remap_table* table)
+{
+    free(table->coords);
+    table->coords = NULL;
+}
+
+/**
+ * @brief Saves a remap table to a file
+ * @param table Remap table
+ * @param path Output file path
+ * @return 0 on success, -1 on error
+ */
+int remap_save(const remap_table* table, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    int32_t header[5] = {REMAP_VERSION, table->width, table->height, table->src_width, table->src_height};
+    size_t entries = (size_t)table->width * table->height * 2;
+    int ok = fwrite(REMAP_MAGIC, 1, 4, file) == 4 &&
+             fwrite(header, sizeof(int32_t), 5, file) == 5 &&
+             fwrite(table->coords, sizeof(int32_t), entries, file) == entries;
+
+    if (fclose(file) != 0)
+    {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Loads a remap table saved by remap_save()
+ * @param table Output table, released with remap_free()
+ * @param path Map file path
+ * @return 0 on success, -1 on error
+ */
+int remap_load(remap_table* table, const char* path)
+{
+    table->coords = NULL;
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    char magic[4];
+    int32_t header[5];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, REMAP_MAGIC, 4) != 0 ||
+        fread(header, sizeof(int32_t), 5, file) != 5 || header[0] != REMAP_VERSION ||
+        header[1] <= 0 || header[2] <= 0 || header[3] <= 0 || header[4] <= 0)
+    {
+        fclose(file);
+        return -1;
+    }
+
+    // The coordinates must all be in the file before the table is allocated for them
+    long start = ftell(file);
+    long end = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (start < 0 || end < start || fseek(file, start, SEEK_SET) != 0 ||
+        (unsigned long long)header[1] * (unsigned long long)header[2] * 2 * sizeof(int32_t) >
+            (unsigned long long)(end - start) ||
+        remap_alloc(table, header[1], header[2], header[3], header[4]) != 0)
+    {
+        fclose(file);
+        return -1;
+    }
+
+    size_t entries = (size_t)table->width * table->height * 2;
+    int ok = fread(table->coords, sizeof(int32_t), entries, file) == entries;
+    fclose(file);
+    if (!ok)
+    {
+        remap_free(table);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Applies a remap table to image data
+ * @param src Source image data
+ * @param width Source width in pixels (must match the table)
+ * @param height Source height in pixels (must match the table)
+ * @param channels Number of color channels
+ * @param table Remap table
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Background pixel for positions outside the source
+ * @return Newly allocated image of the table size, NULL on error
+ *
+ * @details Bilinear weights come straight from the fractional bits. Bicubic
+ *          weights are tabulated once for every possible fraction, so the
+ *          per-pixel work is only integer multiply-adds. Taps beyond the
+ *          image borders repeat the edge pixels.
+ */
+unsigned char* remap_buffer(const unsigned char* src, int width, int height, int channels,
+                            const remap_table* table, int interpolation, const unsigned char* fill)
+{
+    if (width != table->src_width || height != table->src_height)
+    {
+        return NULL;
+    }
+
+    unsigned char* dst = alloc_image(table->width, table->height, channels);
+    if (!dst)
+    {
+        return NULL;
+    }
+
+    // Fixed-point Catmull-Rom weights for every fraction
+    const int fractions = 1 << REMAP_FRACTION_BITS;
+    int cubic[1 << REMAP_FRACTION_BITS][4];
+    if (interpolation == INTERP_BICUBIC)
+    {
+        for (int f = 0; f < fractions; f++)
+        {
+            float w[4];
+            cubic_weights((float)f / fractions, w);
+            int sum = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                cubic[f][i] = (int)floor(w[i] * (1 << REMAP_CUBIC_BITS) + 0.5f);
+                sum += cubic[f][i];
+            }
+            // Weights must add up exactly so flat areas stay flat
+            cubic[f][3] = (1 << REMAP_CUBIC_BITS) - sum;
+        }
+    }
+
+    size_t stride = (size_t)width * channels;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < table->height; y++)
+    {
+        const int32_t* coord = table->coords + (size_t)y * table->width * 2;
+        unsigned char* out = dst + (size_t)y * table->width * channels;
+
+        for (int x = 0; x < table->width; x++, coord += 2, out += channels)
+        {
+            if (coord[0] == REMAP_OUTSIDE)
+            {
+                memcpy(out, fill, channels);
+                continue;
+            }
+
+            if (interpolation == INTERP_NEAREST)
+            {
+                int ix = get_clamped((coord[0] + fractions / 2) >> REMAP_FRACTION_BITS, width);
+                int iy = get_clamped((coord[1] + fractions / 2) >> REMAP_FRACTION_BITS, height);
+                memcpy(out, src + (size_t)iy * stride + (size_t)ix * channels, channels);
+                continue;
+            }
+
+            int ix = coord[0] >> REMAP_FRACTION_BITS;
+            int iy = coord[1] >> REMAP_FRACTION_BITS;
+            int fx = coord[0] & (fractions - 1);
+            int fy = coord[1] & (fractions - 1);
+
+            if (interpolation == INTERP_BILINEAR)
+            {
+                const unsigned char* row0 = src + (size_t)get_clamped(iy, height) * stride;
+                const unsigned char* row1 = src + (size_t)get_clamped(iy + 1, height) * stride;
+                size_t x0 = (size_t)get_clamped(ix, width) * channels;
+                size_t x1 = (size_t)get_clamped(ix + 1, width) * channels;
+                for (int k = 0; k < channels; k++)
+                {
+                    int top = row0[x0 + k] * (fractions - fx) + row0[x1 + k] * fx;
+                    int bottom = row1[x0 + k] * (fractions - fx) + row1[x1 + k] * fx;
+                    out[k] = (unsigned char)((top * (fractions - fy) + bottom * fy +
+                                              (1 << (2 * REMAP_FRACTION_BITS - 1))) >> (2 * REMAP_FRACTION_BITS));
+                }
+                continue;
+            }
+
+            // Bicubic: 4x4 taps, clamped only near the borders
+            size_t columns[4];
+            const unsigned char* rows[4];
+            for (int i = 0; i < 4; i++)
+            {
+                columns[i] = (size_t)get_clamped(ix - 1 + i, width) * channels;
+                rows[i] = src + (size_t)get_clamped(iy - 1 + i, height) * stride;
+            }
+            const int* wx = cubic[fx];
+            const int* wy = cubic[fy];
+            for (int k = 0; k < channels; k++)
+            {
+                long long sum = 0;
+                for (int j = 0; j < 4; j++)
+                {
+                    const unsigned char* row = rows[j] + k;
+                    int horizontal = row[columns[0]] * wx[0] + row[columns[1]] * wx[1] +
+                                     row[columns[2]] * wx[2] + row[columns[3]] * wx[3];
+                    sum += (long long)horizontal * wy[j];
+                }
+                long long value = (sum + (1LL << (2 * REMAP_CUBIC_BITS - 1))) >> (2 * REMAP_CUBIC_BITS);
+                out[k] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * @brief Reads the size of an image and saves a remap table built for it
+ * @param input_path Path to an image from the camera or of the target size
+ * @param map_path Path to save the map file
+ * @param matrix Forward matrix (source to destination) for remap_from_matrix(),
+ *               NULL to build a lens correction map
+ * @param out_width Output width for matrix maps, 0 for the input width
+ * @param out_height Output height for matrix maps, 0 for the input height
+ * @param k1 Second-order radial coefficient for lens maps
+ * @param k2 Fourth-order radial coefficient for lens maps
+ * @return 0 on success, -1 on error
+ */
+static int create_map(char* input_path, char* map_path, const double* matrix,
+                      int out_width, int out_height, double k1, double k2)
+{
+    // Only the image size is needed, pixels are not decoded
+    int width, height, channels;
+    if (!image_info(input_path, &width, &height, &channels))
+    {
+        printf("Error loading image\n");
+        return -1;
+    }
+
+    remap_table table;
+    int res;
+    if (matrix)
+    {
+        double inverse[9];
+        if (invert_matrix3(matrix, inverse) != 0)
+        {
+            printf("Error: Transform matrix is singular!\n");
+            return -1;
+        }
+        res = remap_from_matrix(&table, inverse, out_width ? out_width : width,
+                                out_height ? out_height : height, width, height);
+    }
+    else
+    {
+        res = remap_from_lens(&table, width, height, k1, k2);
+    }
+    if (res != 0)
+    {
+        printf("Error: Memory allocation failed!\n");
+        return -1;
+    }
+
+    res = remap_save(&table, map_path);
+    remap_free(&table);
+    if (res != 0)
+    {
+        printf("Error saving map\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Saves a lens distortion correction map for images of one size
+ * @param input_path Path to an image from the camera
+ * @param map_path Path to save the map file
+ * @param k1 Second-order radial coefficient
+ * @param k2 Fourth-order radial coefficient
+ * @return 0 on success, -1 on error
+ */
+int lens_map(char* input_path, char* map_path, double k1, double k2)
+{
+    return create_map(input_path, map_path, NULL, 0, 0, k1, k2);
+}
+
+/**
+ * @brief Saves a projective transform as a map for images of one size
+ * @param input_path Path to an image of the source size
+ * @param map_path Path to save the map file
+ * @param matrix 3x3 row-major forward matrix (source pixel to destination pixel)
+ * @param out_width Output width in pixels, 0 for the input width
+ * @param out_height Output height in pixels, 0 for the input height
+ * @return 0 on success, -1 on error
+ */
+int warp_map(char* input_path, char* map_path, const double* matrix, int out_width, int out_height)
+{
+    if (out_width < 0 || out_height < 0)
+    {
+        printf("Error: Output size must not be negative!\n");
+        return -1;
+    }
+    return create_map(input_path, map_path, matrix, out_width, out_height, 0, 0);
+}
+
+/**
+ * @brief Applies a saved remap table to an image
+ * @param input_path Path to input image file
+ * @param output_path Path to save remapped image
+ * @param map_path Path to a map file created by lens_map() or warp_map()
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @return 0 on success, -1 on error
+ *
+ * @note Areas without source data are black (transparent for images with alpha)
+ */
+int remap_image(char* input_path, char* output_path, char* map_path, int interpolation)
+{
+    if (interpolation < INTERP_NEAREST || interpolation > INTERP_BICUBIC)
+    {
+        printf("Error: Unknown interpolation mode!\n");
+        return -1;
+    }
+
+    remap_table table;
+    if (remap_load(&table, map_path) != 0)
+    {
+        printf("Error loading map\n");
+        return -1;
+    }
+
+    // Load image
+    int width, height, channels;
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
+    if (!image)
+    {
+        remap_free(&table);
+        printf("Error loading image\n");
+        return -1;
+    }
+
+    if (width != table.src_width || height != table.src_height)
+    {
+        printf("Error: Map was built for %dx%d images!\n", table.src_width, table.src_height);
+        remap_free(&table);
+        free_image(image);
+        return -1;
+    }
+
+    unsigned char fill[4] = {0};
+    unsigned char* remapped = remap_buffer(image, width, height, channels, &table, interpolation, fill);
+    int out_width = table.width;
+    int out_height = table.height;
+    remap_free(&table);
+    free_image(image);
+    if (!remapped)
+    {
+        printf("Error: Memory allocation failed!\n");
+        return -1;
+    }
+
+    // Save remapped image
+    int res = save_image(output_path, out_width, out_height, channels, remapped, 0);
+    free(remapped);
+    return res;
+}
@@ -1,208 +1,947 @@
+/**
+ * @file resize.c
+ * @brief Implementation of image resizing with separable filters
+ */
 #include "functions.h"
 
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define RESAMPLE_BITS 14        ///< Precision of fixed-point filter weights
+#define INTERMEDIATE_SHIFT 8    ///< Drops weight bits so the horizontal pass result fits int16
+#define VERTICAL_CHUNK 1024     ///< Values accumulated at once by the vertical pass
+#define FIXED_PAD 4             ///< Edge pixels added on each side of a row for the fixed kernels
+#define MAX_SCALE 16.0          ///< Largest scale factor, larger numbers are most likely meant as a size
+
 /**
- * @brief Computes bicubic interpolation weight using Catmull-Rom spline
- * @param x Distance from the interpolation point
- * @return Weight value for the given distance
- * 
- * @details Implements the Catmull-Rom spline weighting function:
- * - Piecewise cubic polynomial with a = -0.5 (standard Catmull-Rom parameter)
- * - Smooth interpolation between points
- * - Zero weight beyond 2 units distance
- */
-static double bicubic_weight(double x) {
-    double a = -0.5; // Catmull-Rom spline parameter
-    double abs_x = fabs(x);
-    double res = 0.0;
-    
-    // First segment (0 <= |x| <= 1)
-    if (abs_x <= 1.0) 
-    {
-        res = (a + 2.0) * abs_x * abs_x * abs_x - (a + 3.0) * abs_x * abs_x + 1.0;
-    } 
-    // Second segment (1 < |x| < 2)
-    else if (abs_x < 2.0)
-    {
-        res =  a * abs_x * abs_x * abs_x - 5.0 * a * abs_x * abs_x + 8.0 * a * abs_x - 4.0 * a;
+ * @brief Filter taps of every output coordinate along one axis
+ */
+typedef struct
+{
+    int taps;        ///< Taps per output coordinate
+    int* first;      ///< First source index of every output coordinate
+    short* weights;  ///< taps weights per output coordinate, RESAMPLE_BITS fixed point
+} resample_table;
+
+/**
+ * @brief Constant horizontal kernel of an exact 2x or 0.5x scale
+ *
+ * @details Output pixel x of a 0.5x kernel reads source pixels 2x + offset[0]
+ *          and on. Output pixel 2k + p of a 2x kernel reads source pixels
+ *          k + offset[p] and on with the weights of phase p. The weights are
+ *          the ones build_table() computes for these scales (all exact in
+ *          RESAMPLE_BITS), so results are identical to the general path.
+ */
+typedef struct
+{
+    int filter;            ///< Filter the kernel stands for
+    int upscale;           ///< 1 for 2x (two phases), 0 for 0.5x (one phase)
+    int taps;              ///< Taps per output pixel
+    int offset[2];         ///< First source pixel per phase, relative to k or 2x
+    short weights[2][8];   ///< Weights per phase, RESAMPLE_BITS fixed point
+} fixed_kernel;
+
+static const fixed_kernel fixed_kernels[] = {
+    // Catmull-Rom: 0.5x [-3 -9 29 111 111 29 -9 -3] / 256, 2x [-3 29 111 -9] / 128 and mirrored
+    {FILTER_CATMULL_ROM, 0, 8, {-3, -3}, {{-3 * 64, -9 * 64, 29 * 64, 111 * 64, 111 * 64, 29 * 64, -9 * 64, -3 * 64}}},
+    {FILTER_CATMULL_ROM, 1, 4, {-2, -1}, {{-3 * 128, 29 * 128, 111 * 128, -9 * 128},
+                                          {-9 * 128, 111 * 128, 29 * 128, -3 * 128}}},
+    // Triangle: 0.5x [1 3 3 1] / 8, 2x [1 3] / 4 and mirrored
+    {FILTER_TRIANGLE, 0, 4, {-1, -1}, {{1 * 2048, 3 * 2048, 3 * 2048, 1 * 2048}}},
+    {FILTER_TRIANGLE, 1, 2, {-1, 0}, {{1 * 4096, 3 * 4096}, {3 * 4096, 1 * 4096}}},
+    // Box: 0.5x averages pixel pairs, 2x repeats pixels
+    {FILTER_BOX, 0, 2, {0, 0}, {{8192, 8192}}},
+    {FILTER_BOX, 1, 1, {0, 0}, {{16384}, {16384}}},
+};
+
+/**
+ * @brief Evaluates a resampling kernel
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @param x Distance from the sample center in source pixels (at scale 1)
+ * @return Unnormalized weight
+ */
+static double filter_kernel(int filter, double x)
+{
+    x = fabs(x);
+    switch (filter)
+    {
+    case FILTER_BOX:
+        return x <= 0.5 ? 1.0 : 0.0;
+    case FILTER_TRIANGLE:
+        return x < 1.0 ? 1.0 - x : 0.0;
+    case FILTER_LANCZOS3:
+        if (x < 1e-8)
+        {
+            return 1.0;
+        }
+        if (x >= 3.0)
+        {
+            return 0.0;
+        }
+        return 3.0 * sin(PI * x) * sin(PI * x / 3.0) / (PI * PI * x * x);
+    default:
+        // Catmull-Rom (a = -0.5)
+        if (x < 1.0)
+        {
+            return (1.5 * x - 2.5) * x * x + 1.0;
+        }
+        if (x < 2.0)
+        {
+            return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+        }
+        return 0.0;
     }
-    return res;
 }
 
 /**
- * @brief Performs bicubic interpolation for a single channel
- * @param src Source image data
- * @param width Image width in pixels
- * @param height Image height in pixels
- * @param x X-coordinate to interpolate (floating point)
- * @param y Y-coordinate to interpolate (floating point)
- * @param channel Color channel to interpolate (0-R, 1-G, 2-B, etc.)
- * @param channels Total number of color channels
- * @return Interpolated pixel value
- * 
- * @details Uses 4x4 neighborhood around the target point:
- * 1. Calculates weights for each neighbor using bicubic_weight()
- * 2. Clamps coordinates to image boundaries
- * 3. Computes weighted sum of pixel values
- * 4. Normalizes by total weight
- */
-static double bicubic_interpolate(unsigned char* src, int width, int height, double x, double y, int channel, int channels) 
-{   
-    // Determine the 4x4 neighborhood
-    int x0 = (int) floor(x) - 1;
-    int y0 = (int) floor(y) - 1;
-    double dx = x - floor(x);
-    double dy = y - floor(y);
-
-    double value = 0.0;
-    double sum_weights = 0.0;
-
-    // Iterate over 4x4 neighborhood
-    for (int j = -1; j <= 2; j++)
-    {
-        for (int i = -1; i <= 2; i++) 
-        {
-            // Calculate neighbor coordinates
-            int xi = x0 + i;
-            int yj = y0 + j;
-
-             // Clamp to image boundaries
-            if(xi < 0)
+ * @brief Returns the support radius of a resampling kernel
+ * @param filter Filter identifier
+ * @return Distance beyond which the kernel is zero
+ */
+static double filter_support(int filter)
+{
+    switch (filter)
+    {
+    case FILTER_BOX: return 0.5;
+    case FILTER_TRIANGLE: return 1.0;
+    case FILTER_LANCZOS3: return 3.0;
+    default: return 2.0;
+    }
+}
+
+/**
+ * @brief Builds the tap table for one axis
+ * @param table Output table, released with free_table()
+ * @param src_len Source length in pixels
+ * @param start Source coordinate of the first output pixel's left edge
+ * @param extent Source length mapped onto the output, src_len for the whole axis
+ * @param dst_len Destination length in pixels
+ * @param filter Resampling kernel
+ * @return 0 on success, -1 on allocation failure
+ *
+ * @details Pixel centers are aligned (half-pixel convention): output
+ *          coordinate x samples the source at start + (x + 0.5) * extent / dst_len - 0.5,
+ *          so the edges of the mapped span and of the output meet.
+ *
+ *          When downscaling, the kernel is stretched by the scale factor so
+ *          every source pixel contributes to the output (antialiasing), the
+ *          number of taps grows accordingly. When upscaling the kernel is
+ *          used as is.
+ *
+ *          Taps falling outside the source are folded onto the edge pixel, so
+ *          every window is a contiguous run of valid pixels and the passes
+ *          need no clamping. Weights are normalized and rounded so that they
+ *          sum exactly to 1 << RESAMPLE_BITS.
+ */
+static int build_table(resample_table* table, int src_len, double start, double extent,
+                       int dst_len, int filter)
+{
+    double ratio = extent / dst_len;
+    double scale = ratio > 1.0 ? ratio : 1.0;
+    double support = filter_support(filter) * scale;
+
+    // Widest window actually used: a kernel edge falling exactly on a pixel
+    // would add a zero tap to every output (catmull-rom at 2x: 5 instead of 4)
+    int taps = 1;
+    for (int x = 0; x < dst_len; x++)
+    {
+        double center = start + (x + 0.5) * ratio - 0.5;
+        int count = (int)floor(center + support) - (int)ceil(center - support) + 1;
+        if (count > taps) taps = count;
+    }
+    if (taps > src_len) taps = src_len;
+    table->taps = taps;
+    table->first = (int*)malloc((size_t)dst_len * sizeof(int));
+    table->weights = (short*)malloc((size_t)dst_len * taps * sizeof(short));
+    double* folded = (double*)malloc((size_t)taps * sizeof(double));
+    if (!table->first || !table->weights || !folded)
+    {
+        free(table->first);
+        free(table->weights);
+        free(folded);
+        return -1;
+    }
+
+    for (int x = 0; x < dst_len; x++)
+    {
+        double center = start + (x + 0.5) * ratio - 0.5;
+        int lo = (int)ceil(center - support);
+        int hi = (int)floor(center + support);
+
+        // Window of valid pixels the clamped taps land in
+        int first = lo;
+        if (first > src_len - taps) first = src_len - taps;
+        if (first < 0) first = 0;
+
+        double total = 0;
+        memset(folded, 0, (size_t)taps * sizeof(double));
+        for (int i = lo; i <= hi; i++)
+        {
+            double w = filter_kernel(filter, (i - center) / scale);
+            folded[get_clamped(i, src_len) - first] += w;
+            total += w;
+        }
+        if (total == 0)
+        {
+            // Box filter between two pixels at scale 1: take the nearest one
+            folded[get_clamped((int)floor(center + 0.5), src_len) - first] = 1.0;
+            total = 1.0;
+        }
+
+        // Round the running sum to fixed point and take the differences: the
+        // rounding error carries to the next tap instead of piling up on one,
+        // so taps too small to round up on their own (extreme downscales)
+        // still add up to their share, and the weights sum to exactly 1
+        short* weights = table->weights + (size_t)x * taps;
+        double cumulative = 0;
+        int assigned = 0;
+        for (int i = 0; i < taps; i++)
+        {
+            cumulative += folded[i] / total;
+            int next = i + 1 < taps ? (int)floor(cumulative * (1 << RESAMPLE_BITS) + 0.5) : 1 << RESAMPLE_BITS;
+            weights[i] = (short)(next - assigned);
+            assigned = next;
+        }
+        table->first[x] = first;
+    }
+
+    free(folded);
+    return 0;
+}
+
+/**
+ * @brief Releases a tap table
+ * @param table Tap table
+ */
+static void free_table(resample_table* table)
+{
+    free(table->first);
+    free(table->weights);
+}
+
+/**
+ * @brief Filters one 8-bit row horizontally into an intermediate row
+ * @param in Source row
+ * @param out Intermediate row, dst_width pixels
+ * @param columns Tap table of the output columns
+ * @param dst_width Destination width in pixels
+ * @param channels Number of color channels
+ *
+ * @note Called with a constant channel count from filter_row(), so the
+ *       channel loops unroll and the accumulators stay in registers
+ */
+static inline void filter_row_u8(const unsigned char* in, short* out, const resample_table* columns,
+                                 int dst_width, int channels)
+{
+    const int taps = columns->taps;
+    const short* w = columns->weights;
+    for (int x = 0; x < dst_width; x++, out += channels, w += taps)
+    {
+        const unsigned char* p = in + (size_t)columns->first[x] * channels;
+        int acc[4] = {0, 0, 0, 0};
+        for (int t = 0; t < taps; t++, p += channels)
+        {
+            for (int k = 0; k < channels; k++)
+            {
+                acc[k] += p[k] * w[t];
+            }
+        }
+        for (int k = 0; k < channels; k++)
+        {
+            out[k] = (short)((acc[k] + (1 << (INTERMEDIATE_SHIFT - 1))) >> INTERMEDIATE_SHIFT);
+        }
+    }
+}
+
+/**
+ * @brief Filters one intermediate row horizontally into an 8-bit row
+ * @param in Intermediate row
+ * @param out Destination row, dst_width pixels
+ * @param columns Tap table of the output columns
+ * @param dst_width Destination width in pixels
+ * @param channels Number of color channels
+ */
+static inline void filter_row_s16(const short* in, unsigned char* out, const resample_table* columns,
+                                  int dst_width, int channels)
+{
+    const int shift = 2 * RESAMPLE_BITS - INTERMEDIATE_SHIFT;
+    const int taps = columns->taps;
+    const short* w = columns->weights;
+    for (int x = 0; x < dst_width; x++, out += channels, w += taps)
+    {
+        const short* p = in + (size_t)columns->first[x] * channels;
+        int acc[4] = {0, 0, 0, 0};
+        for (int t = 0; t < taps; t++, p += channels)
+        {
+            for (int k = 0; k < channels; k++)
             {
-                xi = 0;
+                acc[k] += p[k] * w[t];
             }
-            else if(xi >= width)
+        }
+        for (int k = 0; k < channels; k++)
+        {
+            int value = (acc[k] + (1 << (shift - 1))) >> shift;
+            out[k] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+}
+
+/**
+ * @brief Filters one row horizontally
+ * @param in Source row (8-bit if to_intermediate, intermediate otherwise)
+ * @param out Destination row (intermediate if to_intermediate, 8-bit otherwise)
+ * @param columns Tap table of the output columns
+ * @param dst_width Destination width in pixels
+ * @param channels Number of color channels
+ * @param to_intermediate Non-zero for the first pass, zero for the second
+ */
+static void filter_row(const void* in, void* out, const resample_table* columns,
+                       int dst_width, int channels, int to_intermediate)
+{
+    if (to_intermediate)
+    {
+        switch (channels)
+        {
+        case 1: filter_row_u8(in, out, columns, dst_width, 1); break;
+        case 3: filter_row_u8(in, out, columns, dst_width, 3); break;
+        case 4: filter_row_u8(in, out, columns, dst_width, 4); break;
+        default: filter_row_u8(in, out, columns, dst_width, channels); break;
+        }
+    }
+    else
+    {
+        switch (channels)
+        {
+        case 1: filter_row_s16(in, out, columns, dst_width, 1); break;
+        case 3: filter_row_s16(in, out, columns, dst_width, 3); break;
+        case 4: filter_row_s16(in, out, columns, dst_width, 4); break;
+        default: filter_row_s16(in, out, columns, dst_width, channels); break;
+        }
+    }
+}
+
+/**
+ * @brief Returns the input line of a tap for filter_pairs()
+ * @param in_a Line of tap 0
+ * @param in_b Line of tap 1
+ * @param pair_stride Distance between the lines of taps t and t + 2 in elements
+ * @param t Tap index
+ * @param to_intermediate Non-zero for 8-bit lines, zero for intermediate lines
+ * @return Pointer to the first element of the line
+ */
+static inline const void* pair_line(const void* in_a, const void* in_b, size_t pair_stride, int t,
+                                    int to_intermediate)
+{
+    const void* base = t & 1 ? in_b : in_a;
+    size_t offset = (size_t)(t >> 1) * pair_stride;
+    return to_intermediate ? (const void*)((const unsigned char*)base + offset)
+                           : (const void*)((const short*)base + offset);
+}
+
+#ifdef USE_SSE2
+/**
+ * @brief Weighted sum of input lines, 8 elements at a time (SSE2)
+ * @param in_a Line of tap 0 (8-bit if to_intermediate, intermediate otherwise)
+ * @param in_b Line of tap 1
+ * @param pair_stride Distance between the lines of taps t and t + 2 in elements
+ * @param weights Tap weights
+ * @param taps Number of taps (input lines)
+ * @param out Output line (intermediate if to_intermediate, 8-bit otherwise)
+ * @param length Line length in elements
+ * @param to_intermediate Non-zero for the first pass, zero for the second
+ * @return Number of elements done (a multiple of 8), the rest is left to the caller
+ *
+ * @details Elements of two input lines are interleaved into 16-bit pairs, so one
+ *          madd multiplies both lines by their weights and adds them. Arithmetic
+ *          matches the scalar code exactly.
+ */
+static size_t filter_pairs_sse2(const void* in_a, const void* in_b, size_t pair_stride,
+                                const short* weights, int taps, void* out, size_t length,
+                                int to_intermediate)
+{
+    const int shift = to_intermediate ? INTERMEDIATE_SHIFT : 2 * RESAMPLE_BITS - INTERMEDIATE_SHIFT;
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    const __m128i zero = _mm_setzero_si128();
+    size_t end = length & ~(size_t)7;
+
+    for (size_t i = 0; i < end; i += 8)
+    {
+        __m128i acc_lo = round, acc_hi = round;
+        for (int t = 0; t < taps; t += 2)
+        {
+            // Second line of the pair gets weight 0 past the last tap
+            int second = t + 1 < taps;
+            size_t offset = (size_t)(t >> 1) * pair_stride + i;
+            __m128i a, b;
+            if (to_intermediate)
             {
-                xi = width - 1;
+                const unsigned char* row_a = (const unsigned char*)in_a + offset;
+                const unsigned char* row_b = (const unsigned char*)in_b + offset;
+                a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)row_a), zero);
+                b = second ? _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)row_b), zero) : zero;
             }
-        
-            if(yj < 0)
+            else
             {
-                yj = 0;
+                const short* row_a = (const short*)in_a + offset;
+                const short* row_b = (const short*)in_b + offset;
+                a = _mm_loadu_si128((const __m128i*)row_a);
+                b = second ? _mm_loadu_si128((const __m128i*)row_b) : zero;
             }
-            else if (yj >= height)
+            int pair = (weights[t] & 0xFFFF) | (second ? weights[t + 1] : 0) * 65536;
+            __m128i w = _mm_set1_epi32(pair);
+            acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+
+        __m128i packed = _mm_packs_epi32(_mm_srai_epi32(acc_lo, shift), _mm_srai_epi32(acc_hi, shift));
+        if (to_intermediate)
+        {
+            _mm_storeu_si128((__m128i*)((short*)out + i), packed);
+        }
+        else
+        {
+            _mm_storel_epi64((__m128i*)((unsigned char*)out + i), _mm_packus_epi16(packed, zero));
+        }
+    }
+
+    return end;
+}
+#endif
+
+/**
+ * @brief Weighted sum of input lines, element by element
+ * @param in_a Line of tap 0 (8-bit if to_intermediate, intermediate otherwise)
+ * @param in_b Line of tap 1
+ * @param pair_stride Distance between the lines of taps t and t + 2 in elements
+ * @param weights Tap weights
+ * @param taps Number of taps (input lines)
+ * @param out Output line (intermediate if to_intermediate, 8-bit otherwise)
+ * @param length Line length in elements (pixels * channels)
+ * @param to_intermediate Non-zero for the first pass, zero for the second
+ *
+ * @details Even taps read lines in_a, in_a + pair_stride, ... and odd taps
+ *          in_b, in_b + pair_stride, ... Image rows give the vertical pass
+ *          (see filter_column()); the fixed 2x / 0.5x kernels feed shifted
+ *          copies of one row to filter horizontally with the same code.
+ *
+ * @note Sums are accumulated in chunks that stay in L1 cache, the inner
+ *       loops run over contiguous memory
+ */
+static void filter_pairs(const void* in_a, const void* in_b, size_t pair_stride,
+                         const short* weights, int taps, void* out, size_t length, int to_intermediate)
+{
+    const int shift = to_intermediate ? INTERMEDIATE_SHIFT : 2 * RESAMPLE_BITS - INTERMEDIATE_SHIFT;
+    size_t done = 0;
+#ifdef USE_SSE2
+    done = filter_pairs_sse2(in_a, in_b, pair_stride, weights, taps, out, length, to_intermediate);
+#endif
+    for (size_t start = done; start < length; start += VERTICAL_CHUNK)
+    {
+        int acc[VERTICAL_CHUNK];
+        size_t count = length - start < VERTICAL_CHUNK ? length - start : VERTICAL_CHUNK;
+        for (size_t i = 0; i < count; i++)
+        {
+            acc[i] = 1 << (shift - 1);
+        }
+
+        for (int t = 0; t < taps; t++)
+        {
+            int w = weights[t];
+            const void* line = pair_line(in_a, in_b, pair_stride, t, to_intermediate);
+            if (to_intermediate)
+            {
+                const unsigned char* row = (const unsigned char*)line + start;
+                for (size_t i = 0; i < count; i++)
+                {
+                    acc[i] += row[i] * w;
+                }
+            }
+            else
+            {
+                const short* row = (const short*)line + start;
+                for (size_t i = 0; i < count; i++)
+                {
+                    acc[i] += row[i] * w;
+                }
+            }
+        }
+
+        if (to_intermediate)
+        {
+            short* row = (short*)out + start;
+            for (size_t i = 0; i < count; i++)
             {
-                yj = height - 1;
+                row[i] = (short)(acc[i] >> shift);
             }
+        }
+        else
+        {
+            unsigned char* row = (unsigned char*)out + start;
+            for (size_t i = 0; i < count; i++)
+            {
+                int value = acc[i] >> shift;
+                row[i] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Filters vertically: one output row from consecutive input rows
+ * @param in First input row (8-bit if to_intermediate, intermediate otherwise)
+ * @param stride Distance between input rows in elements
+ * @param weights Tap weights
+ * @param taps Number of taps (input rows)
+ * @param out Output row (intermediate if to_intermediate, 8-bit otherwise)
+ * @param length Row length in elements (pixels * channels)
+ * @param to_intermediate Non-zero for the first pass, zero for the second
+ */
+static void filter_column(const void* in, size_t stride, const short* weights, int taps,
+                          void* out, size_t length, int to_intermediate)
+{
+    const void* next = to_intermediate ? (const void*)((const unsigned char*)in + stride)
+                                       : (const void*)((const short*)in + stride);
+    filter_pairs(in, next, 2 * stride, weights, taps, out, length, to_intermediate);
+}
 
-            // Calculate weights in x and y directions
-            double wx = bicubic_weight(i - dx);
-            double wy = bicubic_weight(j - dy);
-            double weight = wx * wy;
+/**
+ * @brief Finds a fixed kernel for one axis
+ * @param filter Resampling filter
+ * @param src_len Source length in pixels
+ * @param start Start of the mapped source span
+ * @param extent Length of the mapped source span
+ * @param dst_len Destination length in pixels
+ * @return Kernel, NULL if the axis needs the general tap table
+ */
+static const fixed_kernel* find_fixed_kernel(int filter, int src_len, double start, double extent,
+                                             int dst_len)
+{
+    int upscale;
+    if (start != 0 || extent != src_len)
+    {
+        return NULL;
+    }
+    if (dst_len == 2 * (long long)src_len)
+    {
+        upscale = 1;
+    }
+    else if (src_len == 2 * (long long)dst_len)
+    {
+        upscale = 0;
+    }
+    else
+    {
+        return NULL;
+    }
 
-            // Add weighted contribution
-            int coords = (yj * width + xi) * channels + channel;
-            value += src[coords] * weight;
-            sum_weights += weight;
+    for (size_t i = 0; i < sizeof(fixed_kernels) / sizeof(fixed_kernels[0]); i++)
+    {
+        if (fixed_kernels[i].filter == filter && fixed_kernels[i].upscale == upscale)
+        {
+            return &fixed_kernels[i];
         }
     }
-    
-    // Return normalized value (avoid division by zero)
-    if(sum_weights != 0)
+    return NULL;
+}
+
+/**
+ * @brief Scratch elements fixed_row() needs for a row
+ * @param width Source width in pixels
+ * @param channels Number of color channels
+ * @return Number of shorts
+ */
+static size_t fixed_scratch_size(int width, int channels)
+{
+    // Padded row plus two phase rows, counted as 16-bit elements
+    return ((size_t)width + 2 * FIXED_PAD + 2 * (size_t)width) * channels;
+}
+
+/**
+ * @brief Copies pixels with a stride on either side
+ * @param dst First destination pixel
+ * @param dst_step Distance between destination pixels in bytes
+ * @param src First source pixel
+ * @param src_step Distance between source pixels in bytes
+ * @param count Number of pixels
+ * @param size Pixel size in bytes
+ *
+ * @note Called with a constant size from copy_pixels(), so every copy is a
+ *       couple of moves instead of a memcpy() call
+ */
+static inline void copy_pixels_sized(unsigned char* dst, size_t dst_step, const unsigned char* src,
+                                     size_t src_step, int count, size_t size)
+{
+    for (int i = 0; i < count; i++, dst += dst_step, src += src_step)
     {
-        return value / sum_weights;
+        memcpy(dst, src, size);
+    }
+}
+
+/**
+ * @brief Copies pixels with a stride on either side
+ * @param dst First destination pixel
+ * @param dst_step Distance between destination pixels in bytes
+ * @param src First source pixel
+ * @param src_step Distance between source pixels in bytes
+ * @param count Number of pixels
+ * @param size Pixel size in bytes
+ */
+static void copy_pixels(unsigned char* dst, size_t dst_step, const unsigned char* src,
+                        size_t src_step, int count, size_t size)
+{
+    switch (size)
+    {
+    case 1: copy_pixels_sized(dst, dst_step, src, src_step, count, 1); break;
+    case 2: copy_pixels_sized(dst, dst_step, src, src_step, count, 2); break;
+    case 3: copy_pixels_sized(dst, dst_step, src, src_step, count, 3); break;
+    case 4: copy_pixels_sized(dst, dst_step, src, src_step, count, 4); break;
+    case 6: copy_pixels_sized(dst, dst_step, src, src_step, count, 6); break;
+    case 8: copy_pixels_sized(dst, dst_step, src, src_step, count, 8); break;
+    default: copy_pixels_sized(dst, dst_step, src, src_step, count, size); break;
+    }
+}
+
+/**
+ * @brief Filters one row horizontally with a fixed kernel
+ * @param in Source row (8-bit if to_intermediate, intermediate otherwise)
+ * @param out Destination row (intermediate if to_intermediate, 8-bit otherwise)
+ * @param kernel Fixed kernel
+ * @param width Source width in pixels
+ * @param channels Number of color channels
+ * @param to_intermediate Non-zero for the first pass, zero for the second
+ * @param scratch Buffer of fixed_scratch_size() shorts
+ *
+ * @details The row is copied with FIXED_PAD clamped pixels on each side, so
+ *          no tap needs a bounds check. Seen as a run of elements, every
+ *          output phase is then a sum of shifted copies of that row:
+ *          - 2x: phase p of pixel k sums padded pixels k + offset[p] + t, i.e.
+ *            lines channels elements apart. Both phases are computed whole
+ *            and interleaved into the output.
+ *          - 0.5x: pixel x sums padded pixels 2x + offset + t. The padded row
+ *            is split into even and odd pixels, then taps alternate between
+ *            the two halves, each advancing one pixel per output pixel.
+ *          Both cases run through filter_pairs() and its SIMD loop.
+ */
+static void fixed_row(const void* in, void* out, const fixed_kernel* kernel, int width, int channels,
+                      int to_intermediate, short* scratch)
+{
+    const size_t element = to_intermediate ? 1 : sizeof(short);
+    const size_t pixel = (size_t)channels * element;
+    const int padded = width + 2 * FIXED_PAD;
+    const size_t length = (size_t)width * channels;
+    unsigned char* pad = (unsigned char*)scratch;
+
+    if (kernel->upscale)
+    {
+        // Clamped copy of the row
+        const unsigned char* last = (const unsigned char*)in + (size_t)(width - 1) * pixel;
+        copy_pixels(pad, pixel, (const unsigned char*)in, 0, FIXED_PAD, pixel);
+        memcpy(pad + FIXED_PAD * pixel, in, (size_t)width * pixel);
+        copy_pixels(pad + (size_t)(FIXED_PAD + width) * pixel, pixel, last, 0, FIXED_PAD, pixel);
+
+        // Both phases, one output pixel per source pixel each
+        unsigned char* phase[2];
+        phase[0] = (unsigned char*)(scratch + (size_t)padded * channels);
+        phase[1] = phase[0] + length * (to_intermediate ? sizeof(short) : 1);
+        for (int p = 0; p < 2; p++)
+        {
+            const unsigned char* base = pad + (size_t)(FIXED_PAD + kernel->offset[p]) * pixel;
+            filter_pairs(base, base + pixel, 2 * (size_t)channels, kernel->weights[p], kernel->taps,
+                         phase[p], length, to_intermediate);
+        }
+
+        // Interleave: pixel 2k from phase 0, pixel 2k + 1 from phase 1
+        size_t out_pixel = (size_t)channels * (to_intermediate ? sizeof(short) : 1);
+        copy_pixels((unsigned char*)out, 2 * out_pixel, phase[0], out_pixel, width, out_pixel);
+        copy_pixels((unsigned char*)out + out_pixel, 2 * out_pixel, phase[1], out_pixel, width, out_pixel);
+    }
+    else
+    {
+        // Even padded pixels first, then odd ones (FIXED_PAD is even, parity is kept)
+        unsigned char* even = pad;
+        unsigned char* odd = pad + (size_t)(padded / 2) * pixel;
+        const unsigned char* last = (const unsigned char*)in + (size_t)(width - 1) * pixel;
+        copy_pixels(even, pixel, (const unsigned char*)in, 0, FIXED_PAD / 2, pixel);
+        copy_pixels(odd, pixel, (const unsigned char*)in, 0, FIXED_PAD / 2, pixel);
+        copy_pixels(even + FIXED_PAD / 2 * pixel, pixel, (const unsigned char*)in, 2 * pixel, width / 2, pixel);
+        copy_pixels(odd + FIXED_PAD / 2 * pixel, pixel, (const unsigned char*)in + pixel, 2 * pixel, width / 2, pixel);
+        copy_pixels(even + (FIXED_PAD / 2 + width / 2) * pixel, pixel, last, 0, FIXED_PAD / 2, pixel);
+        copy_pixels(odd + (FIXED_PAD / 2 + width / 2) * pixel, pixel, last, 0, FIXED_PAD / 2, pixel);
+
+        // Tap t of pixel x is padded pixel 2x + b + t
+        int b = FIXED_PAD + kernel->offset[0];
+        const unsigned char* line_a = b & 1 ? odd + (size_t)(b >> 1) * pixel : even + (size_t)(b >> 1) * pixel;
+        const unsigned char* line_b = b & 1 ? even + (size_t)((b + 1) >> 1) * pixel : odd + (size_t)(b >> 1) * pixel;
+        filter_pairs(line_a, line_b, (size_t)channels, kernel->weights[0], kernel->taps,
+                     out, (size_t)(width / 2) * channels, to_intermediate);
+    }
+}
+
+/**
+ * @brief Resizes a rectangle of image data with a separable filter
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param area Source rectangle {x, y, width, height} in pixels, fractional
+ *             values allowed; NULL for the whole image
+ * @param dst_width Destination width in pixels
+ * @param dst_height Destination height in pixels
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @return Newly allocated resized image, NULL on error
+ *
+ * @details The rectangle is mapped onto the whole destination. Filter taps
+ *          outside it still read the pixels around it, and taps outside the
+ *          image are clamped to the edge.
+ *
+ *          Two passes with tap tables computed once per output column and
+ *          row, all channels of a pixel filtered together. The first pass
+ *          writes a 16-bit intermediate image (values scaled by
+ *          1 << (RESAMPLE_BITS - INTERMEDIATE_SHIFT)), the second pass reads
+ *          it and writes the result.
+ *
+ *          Horizontal filtering gathers pixels through the tap table and
+ *          costs more per tap than vertical filtering, which adds whole
+ *          contiguous rows. So when the height shrinks the vertical pass runs
+ *          first and the horizontal pass only sees dst_height rows; otherwise
+ *          the horizontal pass runs first on the source rows.
+ *
+ *          Widths scaled exactly by 2 or 0.5 with the box, triangle or
+ *          Catmull-Rom filter skip the gather: fixed_row() applies constant
+ *          weights to shifted copies of the row with the vertical SIMD code.
+ *          Vertically the tap table already gives every output row constant
+ *          weights over contiguous rows, so both directions share one loop.
+ */
+unsigned char* resample_area(const unsigned char* src, int width, int height, int channels,
+                             const double* area, int dst_width, int dst_height, int filter)
+{
+    double whole[4] = {0, 0, width, height};
+    if (!area)
+    {
+        area = whole;
+    }
+
+    // Exact 2x and 0.5x widths use constant weights instead of the tap table
+    const fixed_kernel* fixed = find_fixed_kernel(filter, width, area[0], area[2], dst_width);
+    resample_table columns = {0, NULL, NULL}, rows;
+    if (!fixed && build_table(&columns, width, area[0], area[2], dst_width, filter) != 0)
+    {
+        return NULL;
+    }
+    if (build_table(&rows, height, area[1], area[3], dst_height, filter) != 0)
+    {
+        free_table(&columns);
+        return NULL;
+    }
+
+    int vertical_first = dst_height < height;
+    size_t tmp_size = vertical_first ? image_size(width, dst_height, channels)
+                                     : image_size(dst_width, height, channels);
+    short* tmp = tmp_size ? (short*)malloc(tmp_size * sizeof(short)) : NULL;
+    unsigned char* dst = alloc_image(dst_width, dst_height, channels);
+    if (!tmp || !dst)
+    {
+        free(tmp);
+        free(dst);
+        free_table(&columns);
+        free_table(&rows);
+        return NULL;
+    }
+
+    size_t src_len = (size_t)width * channels;
+    size_t dst_len = (size_t)dst_width * channels;
+    int failed = 0;
+
+    if (vertical_first)
+    {
+        #pragma omp parallel
+        {
+            short* scratch = fixed ? (short*)malloc(fixed_scratch_size(width, channels) * sizeof(short)) : NULL;
+            if (fixed && !scratch)
+            {
+                #pragma omp atomic write
+                failed = 1;
+            }
+
+            #pragma omp for schedule(static)
+            for (int y = 0; y < dst_height; y++)
+            {
+                short* row = tmp + (size_t)y * src_len;
+                unsigned char* out = dst + (size_t)y * dst_len;
+                filter_column(src + (size_t)rows.first[y] * src_len, src_len,
+                              rows.weights + (size_t)y * rows.taps, rows.taps, row, src_len, 1);
+                if (!fixed)
+                {
+                    filter_row(row, out, &columns, dst_width, channels, 0);
+                }
+                else if (scratch)
+                {
+                    fixed_row(row, out, fixed, width, channels, 0, scratch);
+                }
+            }
+            free(scratch);
+        }
     }
     else
     {
-        return 0;
+        #pragma omp parallel
+        {
+            short* scratch = fixed ? (short*)malloc(fixed_scratch_size(width, channels) * sizeof(short)) : NULL;
+            if (fixed && !scratch)
+            {
+                #pragma omp atomic write
+                failed = 1;
+            }
+
+            #pragma omp for schedule(static)
+            for (int y = 0; y < height; y++)
+            {
+                const unsigned char* in = src + (size_t)y * src_len;
+                short* row = tmp + (size_t)y * dst_len;
+                if (!fixed)
+                {
+                    filter_row(in, row, &columns, dst_width, channels, 1);
+                }
+                else if (scratch)
+                {
+                    fixed_row(in, row, fixed, width, channels, 1, scratch);
+                }
+            }
+            free(scratch);
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < dst_height; y++)
+        {
+            filter_column(tmp + (size_t)rows.first[y] * dst_len, dst_len,
+                          rows.weights + (size_t)y * rows.taps, rows.taps,
+                          dst + (size_t)y * dst_len, dst_len, 0);
+        }
     }
+
+    if (failed)
+    {
+        free(dst);
+        dst = NULL;
+    }
+    free(tmp);
+    free_table(&columns);
+    free_table(&rows);
+    return dst;
 }
 
 /**
- * @brief Resizes image using bicubic interpolation
+ * @brief Resizes image data with a separable filter
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param dst_width Destination width in pixels
+ * @param dst_height Destination height in pixels
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @return Newly allocated resized image, NULL on error
+ */
+unsigned char* resample_buffer(const unsigned char* src, int width, int height, int channels,
+                               int dst_width, int dst_height, int filter)
+{
+    return resample_area(src, width, height, channels, NULL, dst_width, dst_height, filter);
+}
+
+/**
+ * @brief Parses a resampling filter name
+ * @param name "box", "triangle", "catmullrom" (or "bicubic") or "lanczos3"
+ * @return Filter identifier, -1 for an unknown name
+ */
+int parse_filter(const char* name)
+{
+    if (strcmp(name, "box") == 0) return FILTER_BOX;
+    if (strcmp(name, "triangle") == 0) return FILTER_TRIANGLE;
+    if (strcmp(name, "catmullrom") == 0 || strcmp(name, "bicubic") == 0) return FILTER_CATMULL_ROM;
+    if (strcmp(name, "lanczos3") == 0) return FILTER_LANCZOS3;
+    return -1;
+}
+
+/**
+ * @brief Resizes image with a selectable resampling filter
  * @param input_path Path to input image
  * @param output_path Path to save resized image
  * @param scale_x Horizontal scaling factor
  * @param scale_y Vertical scaling factor
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
  * @return 0 on success, -1 on error
  * 
  * @details Performs high-quality image resizing:
  * 1. Validates scaling factors
- * 2. Loads source image
- * 3. Creates destination buffer
- * 4. For each output pixel:
- *    - Calculates corresponding source coordinates
- *    - Performs bicubic interpolation for each channel
- *    - Clamps values to [0,255] range
- *    - Applies proper rounding
- * 5. Saves result image
- */
-int resize_bicubic(char* input_path, char* output_path, double scale_x, double scale_y) {
+ * 2. Loads source image, JPEGs reduced by 1/2, 1/4 or 1/8 during decoding
+ *    when the target is at least that much smaller
+ * 3. Resamples with resample_buffer(): separable filter with pixel centers
+ *    aligned, widened by the downscale factor so thumbnails do not alias
+ * 4. Saves result image
+ */
+int resize_image(char* input_path, char* output_path, double scale_x, double scale_y, int filter) {
     // Validate scaling factors
     if(scale_x <= 0 || scale_y <= 0)
     {
         printf("Scaling factors must be positive!\n");
         return -1;
     }
+    if (scale_x > MAX_SCALE || scale_y > MAX_SCALE)
+    {
+        // "-resize 800 600" would otherwise make an image 800 times wider
+        printf("Error: Scaling factors above %g are not supported! For a size in pixels use WxH, e.g. %gx%g\n",
+               MAX_SCALE, scale_x, scale_y);
+        return -1;
+    }
+    if (filter < FILTER_BOX || filter > FILTER_LANCZOS3)
+    {
+        printf("Error: Unknown resampling filter!\n");
+        return -1;
+    }
 
-    // Load source image
+    // The target size comes from the header, so downscaled JPEGs can be decoded reduced
     int width, height, channels;
-    unsigned char* image = stbi_load(input_path, &width, &height, &channels, 0);
-    if (!image) 
+    if (!image_info(input_path, &width, &height, &channels))
     {
         printf("Error loading image\n");
         return 1;
     }
 
-    // Calculate new dimensions
-    int new_width = (int)(width * scale_x);
-    int new_height = (int)(height * scale_y);
-    unsigned char* dst = (unsigned char*) malloc (sizeof(unsigned char) * new_width * new_height * channels);
-
-    // Process each output pixel
-    for (int y = 0; y < new_height; y++) 
+    // Calculate new dimensions (must stay representable as int)
+    double scaled_width = width * scale_x;
+    double scaled_height = height * scale_y;
+    if (scaled_width < 1 || scaled_height < 1 || scaled_width > INT_MAX || scaled_height > INT_MAX)
     {
-        for (int x = 0; x < new_width; x++) 
-        {
-            // Calculate corresponding source coordinates
-            double src_x = x / scale_x;
-            double src_y = y / scale_y;
-
-            // Interpolate each channel
-            for (int k = 0; k < channels; k++) 
-            {
-                double interpolated = bicubic_interpolate(image, width, height, src_x, src_y, k, channels);
-                // Clamp to valid pixel range
-                if(interpolated < 0)
-                {
-                    interpolated = 0;
-                }
-                else if(interpolated > 255)
-                {
-                    interpolated = 255;
-                }
-                // Round to nearest integer
-                dst[(y * new_width + x) * channels + k] = (unsigned char)(interpolated + 0.5);
-            }
-        }
+        printf("Error: Resulting image size is out of range!\n");
+        return -1;
     }
+    int new_width = (int)scaled_width;
+    int new_height = (int)scaled_height;
 
-    // Save result image
-    int res;
-    if (strstr(output_path, ".png")) 
-    {
-        res = stbi_write_png(output_path, new_width, new_height, channels, dst, new_width * channels);
-    } 
-    else if (strstr(output_path, ".jpg")) 
+    // Load source image, the resampler only covers what decoding left over
+    double area[4];
+    unsigned char* image = load_image_scaled(input_path, &width, &height, &channels,
+                                             new_width, new_height, area);
+    if (!image) 
     {
-        res = stbi_write_jpg(output_path, new_width, new_height, channels, dst, 100);
-    } 
-    else 
+        printf("Error loading image\n");
+        return 1;
+    }
+
+    unsigned char* dst = resample_area(image, width, height, channels, area, new_width, new_height, filter);
+    if (!dst)
     {
-        printf("Unsupported format. Use .png or .jpg\n");
-        stbi_image_free(image);
-        free(dst);
+        free_image(image);
+        printf("Error: Memory allocation failed!\n");
         return -1;
     }
 
+    // Save result image
+    int res = save_image(output_path, new_width, new_height, channels, dst, 0);
+
     // Clean up
-    stbi_image_free(image);
+    free_image(image);
     free(dst);
 
-    if (!res) 
-    {
-        printf("Error saving image\n");
-        return -1;
-    }
-
-    return 0;
+    return res;
 }
\ No newline at end of file
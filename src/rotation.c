@@ -5,103 +5,738 @@
 
 #include "functions.h"
 
+#define TRANSFORM_TILE 64 ///< Tile side (pixels) for blocked transposition
+
 /**
- * @brief Rotates an image by specified angle around its center
- * @param input_path Path to input image file
- * @param output_path Path to save rotated image
- * @param angle_degrees Rotation angle in degrees (positive = counter-clockwise)
- * @return 0 on success, -1 on error
- * 
- * @details Performs rigid rotation using nearest-neighbor interpolation:
- * 1. Calculates rotation center (image center)
- * 2. Converts angle to radians
- * 3. Creates blank output image
- * 4. For each pixel, computes new position via rotation matrix
- * 5. Copies pixels using nearest-neighbor approach
- * 
- * @note Uses simple nearest-neighbor interpolation (may cause aliasing)
+ * @brief Copies pixels along a source line with a fixed step
+ * @param dst Destination (contiguous pixels)
+ * @param src First source pixel
+ * @param step Distance between consecutive source pixels in bytes (may be negative)
+ * @param count Number of pixels to copy
+ * @param channels Number of color channels
+ *
+ * @note Common channel counts are spelled out so the copy becomes plain loads and stores
  */
-int rotate_image(char* input_path, char* output_path, double angle_degrees) 
+static void copy_strided(unsigned char* dst, const unsigned char* src, ptrdiff_t step, int count, int channels)
 {
-    // Load input image using stb_image
-    int width, height, channels;
-    unsigned char* image = stbi_load(input_path, &width, &height, &channels, 0);
-    if (!image) 
+    switch (channels)
     {
-        printf("Error loading image\n");
-        return -1;
+    case 1:
+        for (int i = 0; i < count; i++, src += step)
+        {
+            dst[i] = src[0];
+        }
+        break;
+    case 3:
+        for (int i = 0; i < count; i++, src += step, dst += 3)
+        {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+        break;
+    case 4:
+        for (int i = 0; i < count; i++, src += step, dst += 4)
+        {
+            memcpy(dst, src, 4);
+        }
+        break;
+    default:
+        for (int i = 0; i < count; i++, src += step, dst += channels)
+        {
+            memcpy(dst, src, channels);
+        }
+        break;
     }
+}
 
-    // Calculate image center coordinates (rotation pivot point)
-    double center_x = width / 2.0;
-    double center_y = height / 2.0;
+/**
+ * @brief Applies a lossless flip / transpose transform
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param transpose Non-zero to swap axes (destination is height x width)
+ * @param flip_x Non-zero to mirror source x coordinate
+ * @param flip_y Non-zero to mirror source y coordinate
+ * @return Newly allocated transformed image, NULL on error
+ *
+ * @details Every destination pixel (x', y') is taken from source pixel
+ *          (x, y) = transpose ? (y', x') : (x', y'), mirrored as requested.
+ *          These eight combinations cover all rotations by multiples of 90
+ *          degrees and all mirrors.
+ *
+ *          Without transposition each destination row is a source row read
+ *          forward or backward. With transposition destination rows walk down
+ *          source columns, so the image is processed in square tiles: the
+ *          source lines touched by one tile stay in cache while it is written.
+ */
+static unsigned char* transform_blocked(const unsigned char* src, int width, int height, int channels,
+                                        int transpose, int flip_x, int flip_y)
+{
+    int dst_width = transpose ? height : width;
+    int dst_height = transpose ? width : height;
+    unsigned char* dst = alloc_image(dst_width, dst_height, channels);
+    if (!dst)
+    {
+        return NULL;
+    }
+
+    ptrdiff_t pixel_step = flip_x ? -(ptrdiff_t)channels : (ptrdiff_t)channels;
+    ptrdiff_t row_step = (flip_y ? -(ptrdiff_t)width : (ptrdiff_t)width) * channels;
+    size_t dst_stride = (size_t)dst_width * channels;
+
+    // Destination x moves along source x, or along source y when transposing
+    ptrdiff_t step = transpose ? row_step : pixel_step;
+    int tile = transpose ? TRANSFORM_TILE : dst_width;
+    int tiles_y = (dst_height + TRANSFORM_TILE - 1) / TRANSFORM_TILE;
+
+    #pragma omp parallel for schedule(static)
+    for (int ty = 0; ty < tiles_y; ty++)
+    {
+        int y_end = (ty + 1) * TRANSFORM_TILE < dst_height ? (ty + 1) * TRANSFORM_TILE : dst_height;
+        for (int x0 = 0; x0 < dst_width; x0 += tile)
+        {
+            int count = x0 + tile < dst_width ? tile : dst_width - x0;
+            for (int y = ty * TRANSFORM_TILE; y < y_end; y++)
+            {
+                // Source coordinates of destination pixel (x0, y)
+                int sx = transpose ? y : x0;
+                int sy = transpose ? x0 : y;
+                if (flip_x) sx = width - 1 - sx;
+                if (flip_y) sy = height - 1 - sy;
+
+                const unsigned char* from = src + ((size_t)sy * width + sx) * channels;
+                copy_strided(dst + y * dst_stride + (size_t)x0 * channels, from, step, count, channels);
+            }
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * @brief Rotates an image by a multiple of 90 degrees without resampling
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param quarter_turns Number of clockwise quarter turns (any integer)
+ * @param out_width Output: width of the rotated image
+ * @param out_height Output: height of the rotated image
+ * @return Newly allocated rotated image, NULL on error
+ *
+ * @note Odd quarter turns swap width and height, nothing is cropped
+ */
+unsigned char* rotate_orthogonal(const unsigned char* src, int width, int height, int channels,
+                                 int quarter_turns, int* out_width, int* out_height)
+{
+    int turns = ((quarter_turns % 4) + 4) % 4;
+    unsigned char* dst;
+    switch (turns)
+    {
+    case 1: // dst(x, y) = src(y, h - 1 - x)
+        dst = transform_blocked(src, width, height, channels, 1, 0, 1);
+        break;
+    case 2: // dst(x, y) = src(w - 1 - x, h - 1 - y)
+        dst = transform_blocked(src, width, height, channels, 0, 1, 1);
+        break;
+    case 3: // dst(x, y) = src(w - 1 - y, x)
+        dst = transform_blocked(src, width, height, channels, 1, 1, 0);
+        break;
+    default:
+        dst = transform_blocked(src, width, height, channels, 0, 0, 0);
+        break;
+    }
+
+    *out_width = turns % 2 ? height : width;
+    *out_height = turns % 2 ? width : height;
+    return dst;
+}
+
+/**
+ * @brief Applies an EXIF orientation to image data without resampling
+ * @param src Source image data as stored in the file
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param orientation EXIF orientation tag value (1-8)
+ * @param out_width Output: width of the upright image
+ * @param out_height Output: height of the upright image
+ * @return Newly allocated upright image, NULL on error
+ *
+ * @details Orientations 5-8 swap width and height:
+ *          2 - mirror x, 3 - rotate 180, 4 - mirror y, 5 - transpose,
+ *          6 - rotate 90 clockwise, 7 - transverse, 8 - rotate 90 counterclockwise
+ */
+unsigned char* orient_image(const unsigned char* src, int width, int height, int channels,
+                            int orientation, int* out_width, int* out_height)
+{
+    // Transpose, flip_x and flip_y for orientations 1..8
+    static const unsigned char transforms[8][3] = {
+        {0, 0, 0}, {0, 1, 0}, {0, 1, 1}, {0, 0, 1},
+        {1, 0, 0}, {1, 0, 1}, {1, 1, 1}, {1, 1, 0}
+    };
+    if (orientation < 1 || orientation > 8)
+    {
+        orientation = 1;
+    }
+    const unsigned char* t = transforms[orientation - 1];
 
-    // Convert angle from degrees to radians and precompute trig values
+    *out_width = t[0] ? height : width;
+    *out_height = t[0] ? width : height;
+    return transform_blocked(src, width, height, channels, t[0], t[1], t[2]);
+}
+
+/**
+ * @brief Computes the output size of a rotation
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param angle_degrees Rotation angle in degrees
+ * @param expand Non-zero for the bounding box of the rotated image,
+ *               zero to keep the source size
+ * @param out_width Output: destination width
+ * @param out_height Output: destination height
+ */
+static void rotated_size(int width, int height, double angle_degrees, int expand, int* out_width, int* out_height)
+{
+    *out_width = width;
+    *out_height = height;
+    if (expand)
+    {
+        double angle_rad = angle_degrees * PI / 180.0;
+        double box_width = fabs(width * cos(angle_rad)) + fabs(height * sin(angle_rad));
+        double box_height = fabs(width * sin(angle_rad)) + fabs(height * cos(angle_rad));
+        *out_width = (int)ceil(box_width - 1e-6);
+        *out_height = (int)ceil(box_height - 1e-6);
+    }
+}
+
+/**
+ * @brief Rotates image data by an arbitrary angle using inverse mapping
+ * @param src Source image data
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param angle_degrees Rotation angle in degrees (positive = clockwise on screen)
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param expand Non-zero to grow the canvas to the bounding box of the rotated image,
+ *               zero to keep the original size (corners are cut off)
+ * @param fill Background pixel in the source channel layout, NULL for zeros
+ * @param out_width Output: width of the rotated image
+ * @param out_height Output: height of the rotated image
+ * @return Newly allocated rotated image, NULL on error
+ *
+ * @details Rotation around the image center expressed as a warp_buffer()
+ *          matrix mapping destination pixels back to the source:
+ *          [sx]   [ cos  sin][x - cx']   [cx]
+ *          [sy] = [-sin  cos][y - cy'] + [cy]
+ */
+unsigned char* rotate_buffer(const unsigned char* src, int width, int height, int channels,
+                             double angle_degrees, int interpolation, int expand,
+                             const unsigned char* fill, int* out_width, int* out_height)
+{
     double angle_rad = angle_degrees * PI / 180.0;
     double cos_angle = cos(angle_rad);
     double sin_angle = sin(angle_rad);
 
-    // Allocate and initialize output image buffer (filled with zeros/black)
-    unsigned char* rotated_image = (unsigned char*)malloc(width * height * channels);
-    memset(rotated_image, 0, width * height * channels);
+    int dst_width, dst_height;
+    rotated_size(width, height, angle_degrees, expand, &dst_width, &dst_height);
+
+    // Rotation centers at the middle of the pixel grids
+    double center_x = (width - 1) / 2.0;
+    double center_y = (height - 1) / 2.0;
+    double dst_center_x = (dst_width - 1) / 2.0;
+    double dst_center_y = (dst_height - 1) / 2.0;
+
+    double matrix[9] = {
+        cos_angle, sin_angle, center_x - cos_angle * dst_center_x - sin_angle * dst_center_y,
+        -sin_angle, cos_angle, center_y + sin_angle * dst_center_x - cos_angle * dst_center_y,
+        0, 0, 1
+    };
+
+    unsigned char zero[4] = {0};
+    unsigned char* dst = warp_buffer(src, width, height, channels, matrix, dst_width, dst_height,
+                                     interpolation, fill ? fill : zero);
+    if (!dst)
+    {
+        return NULL;
+    }
+
+    *out_width = dst_width;
+    *out_height = dst_height;
+    return dst;
+}
+
+/**
+ * @brief Clamps an index to [0, length]
+ * @param index Input index
+ * @param length Upper bound
+ * @return Clamped index
+ */
+static int clamp_index(int index, int length)
+{
+    return index < 0 ? 0 : (index > length ? length : index);
+}
+
+/**
+ * @brief Integer filter taps for 1D resampling at a fixed fractional position
+ * @param position Source position of the sample
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param first Output: index of the first source tap
+ * @param weights Output: tap weights in 1/256 units, summing to 256
+ * @return Number of taps (1, 2 or 4)
+ */
+static int line_taps(double position, int interpolation, int* first, int* weights)
+{
+    if (interpolation == INTERP_NEAREST)
+    {
+        *first = (int)floor(position + 0.5);
+        weights[0] = 256;
+        return 1;
+    }
+
+    int base = (int)floor(position);
+    double t = position - base;
+    if (interpolation == INTERP_BILINEAR)
+    {
+        *first = base;
+        weights[1] = (int)(t * 256 + 0.5);
+        weights[0] = 256 - weights[1];
+        return 2;
+    }
+
+    float w[4];
+    cubic_weights((float)t, w);
+    *first = base - 1;
+    weights[0] = (int)floor(w[0] * 256 + 0.5f);
+    weights[2] = (int)floor(w[2] * 256 + 0.5f);
+    weights[3] = (int)floor(w[3] * 256 + 0.5f);
+    weights[1] = 256 - weights[0] - weights[2] - weights[3];
+    return 4;
+}
 
-    // Perform rotation using inverse mapping (destination-to-source)
-    for (int y = 0; y < height; y++) 
+/**
+ * @brief Blends taps of one output pixel where some taps lie outside the line
+ * @param src Source line
+ * @param step Distance between source pixels in bytes
+ * @param length Number of source pixels
+ * @param first Index of the first tap
+ * @param taps Number of taps
+ * @param weights Tap weights in 1/256 units
+ * @param channels Number of color channels
+ * @param fill Pixel used for taps outside the line
+ * @param dst Output pixel
+ */
+static void blend_edge_taps(const unsigned char* src, ptrdiff_t step, int length, int first, int taps,
+                            const int* weights, int channels, const unsigned char* fill, unsigned char* dst)
+{
+    for (int k = 0; k < channels; k++)
     {
-        for (int x = 0; x < width; x++) 
+        int sum = 128;
+        for (int t = 0; t < taps; t++)
         {
-            // Convert to coordinates relative to center
-            double dx = x - center_x;
-            double dy = y - center_y;
+            int j = first + t;
+            int value = (j < 0 || j >= length) ? fill[k] : src[j * step + k];
+            sum += value * weights[t];
+        }
+        sum >>= 8;
+        dst[k] = (unsigned char)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+    }
+}
+
+/**
+ * @brief Resamples a line of pixels shifted by a constant offset (one shear row)
+ * @param src Source line
+ * @param src_length Number of source pixels
+ * @param offset Source position of destination pixel 0
+ * @param dst Destination line
+ * @param dst_length Number of destination pixels
+ * @param channels Number of color channels
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Pixel used outside the source line
+ *
+ * @details Every destination pixel has the same fractional position, so the
+ *          weights are computed once per line. The line is split into the
+ *          part reading only inside the source and the edges that mix in fill.
+ */
+static void shear_line(const unsigned char* src, int src_length, double offset,
+                       unsigned char* dst, int dst_length, int channels, int interpolation,
+                       const unsigned char* fill)
+{
+    int first, weights[4];
+    int taps = line_taps(offset, interpolation, &first, weights);
 
-            // Apply rotation matrix:
-            // [x'] = [cosθ -sinθ][x]
-            // [y']   [sinθ  cosθ][y]
-            int new_x = (int)(dx * cos_angle - dy * sin_angle + center_x);
-            int new_y = (int)(dx * sin_angle + dy * cos_angle + center_y);
+    // Destination pixels touching the source at all, and those whose taps are all inside
+    int touch_start = clamp_index(-first - taps + 1, dst_length);
+    int touch_end = clamp_index(src_length - first, dst_length);
+    if (touch_end < touch_start) touch_end = touch_start;
+    int inner_start = clamp_index(-first, dst_length);
+    int inner_end = clamp_index(src_length - taps + 1 - first, dst_length);
+    if (inner_start < touch_start) inner_start = touch_start;
+    if (inner_end > touch_end) inner_end = touch_end;
+    if (inner_end < inner_start) inner_start = inner_end = touch_start;
+
+    // Pixels beyond the source get the fill, the few at its edges are blended
+    fill_pixels(dst, touch_start, channels, fill);
+    fill_pixels(dst + (size_t)touch_end * channels, dst_length - touch_end, channels, fill);
+    for (int i = touch_start; i < inner_start; i++)
+    {
+        blend_edge_taps(src, channels, src_length, first + i, taps, weights, channels, fill, dst + (size_t)i * channels);
+    }
+    for (int i = inner_end; i < touch_end; i++)
+    {
+        blend_edge_taps(src, channels, src_length, first + i, taps, weights, channels, fill, dst + (size_t)i * channels);
+    }
 
-            // Verify new coordinates are within image bounds
-            if (new_x >= 0 && new_x < width && new_y >= 0 && new_y < height) 
+    const unsigned char* in = src + (ptrdiff_t)(first + inner_start) * channels;
+    unsigned char* out = dst + (size_t)inner_start * channels;
+    size_t count = (size_t)(inner_end - inner_start) * channels;
+    if (taps == 1)
+    {
+        memcpy(out, in, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++, in++)
+    {
+        int sum = 128 + in[0] * weights[0] + in[channels] * weights[1];
+        if (taps == 4)
+        {
+            sum += in[2 * channels] * weights[2] + in[3 * channels] * weights[3];
+        }
+        sum >>= 8;
+        out[i] = (unsigned char)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+    }
+}
+
+/**
+ * @brief Computes one row of a vertical shear
+ * @param src Source image
+ * @param width Image width
+ * @param src_height Source height
+ * @param channels Number of color channels
+ * @param first First source row tapped by each column for destination row 0
+ * @param weights Tap weights of each column (4 entries per column)
+ * @param taps Number of taps (1, 2 or 4)
+ * @param y Destination row
+ * @param fill Pixel used outside the source
+ * @param out Destination row
+ *
+ * @details Taps and weights depend only on the column, so they are computed
+ *          once for the whole image. Along a row the source rows read change
+ *          slowly, and consecutive destination rows reuse the same source
+ *          rows shifted by one, so the reads stay in cache.
+ */
+static void shear_column_row(const unsigned char* src, int width, int src_height, int channels,
+                             const int* first, const int* weights, int taps, int y,
+                             const unsigned char* fill, unsigned char* out)
+{
+    size_t stride = (size_t)width * channels;
+    for (int x = 0; x < width; x++, out += channels)
+    {
+        int top = first[x] + y;
+        const int* w = &weights[x * 4];
+
+        // Column does not reach this row: background
+        if (top + taps <= 0 || top >= src_height)
+        {
+            memcpy(out, fill, channels);
+            continue;
+        }
+        // Column edge: some taps outside
+        if (top < 0 || top + taps > src_height)
+        {
+            blend_edge_taps(src + (size_t)x * channels, (ptrdiff_t)stride, src_height, top,
+                            taps, w, channels, fill, out);
+            continue;
+        }
+
+        const unsigned char* in = src + (size_t)top * stride + (size_t)x * channels;
+        switch (taps)
+        {
+        case 1:
+            memcpy(out, in, channels);
+            break;
+        case 2:
+            for (int k = 0; k < channels; k++)
+            {
+                out[k] = (unsigned char)((128 + in[k] * w[0] + in[stride + k] * w[1]) >> 8);
+            }
+            break;
+        default:
+            for (int k = 0; k < channels; k++)
             {
-                // Copy all channels using nearest-neighbor interpolation
-                for (int k = 0; k < channels; k++) 
-                {
-                    int new_pos = (new_y * width + new_x) * channels + k;
-                    int orig_pos = (y * width + x) * channels + k;
-                    rotated_image[new_pos] = image[orig_pos];
-                }
+                int sum = (128 + in[k] * w[0] + in[stride + k] * w[1]
+                           + in[2 * stride + k] * w[2] + in[3 * stride + k] * w[3]) >> 8;
+                out[k] = (unsigned char)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
             }
-            // Else: leaves pixel as black (from memset initialization)
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Rotates image data using three successive shears (Paeth)
+ * @param src Source image data
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @param angle_degrees Rotation angle in degrees (positive = clockwise on screen)
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param expand Non-zero to fit the canvas to the rotated image
+ * @param fill Background pixel in the source channel layout, NULL for zeros
+ * @param out_width Output: width of the rotated image
+ * @param out_height Output: height of the rotated image
+ * @return Newly allocated rotated image, NULL on error
+ *
+ * @details The rotation matrix is split into shears
+ *          [c -s]   [1 a] [1 0] [1 a]
+ *          [s  c] = [0 1] [b 1] [0 1],  a = -tan(angle / 2), b = sin(angle)
+ *          Horizontal shears shift whole rows, vertical ones whole columns,
+ *          each by a constant amount, so every pass is a 1D resample with
+ *          fixed weights per line that streams through memory. The second
+ *          and third passes are fused row by row, so only one intermediate
+ *          image is stored. Quarter turns
+ *          are removed first by rotate_orthogonal(), keeping the remaining
+ *          angle within +-45 degrees where the shears stay small.
+ *
+ *          Output geometry is the same as rotate_buffer(), results differ
+ *          only by interpolation rounding.
+ */
+unsigned char* rotate_shear_buffer(const unsigned char* src, int width, int height, int channels,
+                                   double angle_degrees, int interpolation, int expand,
+                                   const unsigned char* fill, int* out_width, int* out_height)
+{
+    unsigned char zero[4] = {0};
+    if (!fill)
+    {
+        fill = zero;
+    }
+
+    int dst_width, dst_height;
+    rotated_size(width, height, angle_degrees, expand, &dst_width, &dst_height);
+
+    // Take out whole quarter turns exactly
+    double turns = floor(angle_degrees / 90.0 + 0.5);
+    double residual = (angle_degrees - turns * 90.0) * PI / 180.0;
+    const unsigned char* base = src;
+    unsigned char* turned = NULL;
+    int base_width = width, base_height = height;
+    if (fmod(turns, 4.0) != 0)
+    {
+        turned = rotate_orthogonal(src, width, height, channels, (int)fmod(turns, 4.0), &base_width, &base_height);
+        if (!turned)
+        {
+            return NULL;
         }
+        base = turned;
+    }
+
+    double a = -tan(residual / 2);
+    double b = sin(residual);
+
+    // Intermediate sizes hold the whole sheared image plus interpolation margin.
+    // The second one has the parity of the output height, so its rows line up
+    // with output rows in the last pass.
+    int width1 = base_width + (int)ceil(fabs(a) * (base_height - 1)) + 4;
+    int height2 = base_height + (int)ceil(fabs(b) * (width1 - 1)) + 4;
+    if ((height2 - dst_height) % 2 != 0)
+    {
+        height2++;
+    }
+
+    unsigned char* pass1 = alloc_image(width1, base_height, channels);
+    unsigned char* dst = alloc_image(dst_width, dst_height, channels);
+    int* first = (int*)malloc((size_t)width1 * sizeof(int));
+    int* weights = (int*)malloc((size_t)width1 * 4 * sizeof(int));
+    if (!pass1 || !dst || !first || !weights)
+    {
+        free(pass1);
+        free(dst);
+        free(first);
+        free(weights);
+        free(turned);
+        return NULL;
+    }
+
+    double center_x = (base_width - 1) / 2.0;
+    double center_y = (base_height - 1) / 2.0;
+    double center1_x = (width1 - 1) / 2.0;
+    double center2_y = (height2 - 1) / 2.0;
+    double dst_center_x = (dst_width - 1) / 2.0;
+    double dst_center_y = (dst_height - 1) / 2.0;
+
+    // Pass 1: x1 = x + a * y, rows shift
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < base_height; y++)
+    {
+        double offset = -center1_x - a * (y - center_y) + center_x;
+        shear_line(base + (size_t)y * base_width * channels, base_width, offset,
+                   pass1 + (size_t)y * width1 * channels, width1, channels, interpolation, fill);
+    }
+
+    // Pass 2: y2 = y1 + b * x1, columns shift. Taps of every column are fixed.
+    int taps = 1;
+    for (int x = 0; x < width1; x++)
+    {
+        double offset = -center2_y + b * (center1_x - x) + center_y;
+        taps = line_taps(offset, interpolation, &first[x], &weights[x * 4]);
     }
 
-    // Save rotated image in specified format
-    int res;
-    if (strstr(output_path, ".png")) 
+    // Pass 3: x = x2 + a * y2, rows shift. Output rows map to whole rows of
+    // pass 2, so each row of pass 2 is produced right before it is consumed
+    // and never stored as a full image.
+    int row_shift = (height2 - dst_height) / 2;
+    int failed = 0;
+    #pragma omp parallel
     {
-        res = stbi_write_png(output_path, width, height, channels, rotated_image, width * channels);
-    } 
-    else if (strstr(output_path, ".jpg")) 
+        unsigned char* row2 = (unsigned char*)malloc((size_t)width1 * channels);
+        if (!row2)
+        {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < dst_height; y++)
+        {
+            unsigned char* out = dst + (size_t)y * dst_width * channels;
+            int y2 = y + row_shift;
+            if (!row2 || y2 < 0 || y2 >= height2)
+            {
+                fill_pixels(out, dst_width, channels, fill);
+                continue;
+            }
+            shear_column_row(pass1, width1, base_height, channels, first, weights, taps, y2, fill, row2);
+
+            double offset = -dst_center_x - a * (y - dst_center_y) + center1_x;
+            shear_line(row2, width1, offset, out, dst_width, channels, interpolation, fill);
+        }
+        free(row2);
+    }
+
+    free(pass1);
+    free(first);
+    free(weights);
+    free(turned);
+
+    if (failed)
     {
-        res = stbi_write_jpg(output_path, width, height, channels, rotated_image, 100);
-    } 
-    else 
+        free(dst);
+        return NULL;
+    }
+
+    *out_width = dst_width;
+    *out_height = dst_height;
+    return dst;
+}
+
+/**
+ * @brief Rotates an image by specified angle around its center
+ * @param input_path Path to input image file
+ * @param output_path Path to save rotated image
+ * @param angle_degrees Rotation angle in degrees (positive = clockwise on screen)
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param background NULL to keep the original size with black corners, otherwise
+ *                   the canvas grows to fit the whole rotated image and empty
+ *                   areas get this color ("transparent", "RRGGBB" or "RRGGBBAA")
+ * @param method ROTATE_DIRECT for inverse mapping, ROTATE_SHEAR for three shears
+ * @return 0 on success, -1 on error
+ * 
+ * @details Multiples of 90 degrees are done exactly by rotate_orthogonal():
+ * width and height are swapped and no pixel is resampled.
+ *
+ * Other angles are done around the image center by rotate_buffer(), or by
+ * rotate_shear_buffer() which streams through memory and suits very large images.
+ * A background with transparency adds an alpha channel to images without
+ * one (gray becomes gray + alpha, RGB becomes RGBA).
+ */
+int rotate_image(char* input_path, char* output_path, double angle_degrees, int interpolation, char* background,
+                 int method) 
+{
+    if (interpolation < INTERP_NEAREST || interpolation > INTERP_BICUBIC)
     {
-        printf("Unsupported format. Use .png or .jpg\n");
-        stbi_image_free(image);
-        free(rotated_image);
+        printf("Error: Unknown interpolation mode!\n");
         return -1;
     }
 
-    // Clean up allocated memory
-    stbi_image_free(image);
-    free(rotated_image);
+    unsigned char background_rgba[4] = {0, 0, 0, 255};
+    if (background && parse_color(background, background_rgba) != 0)
+    {
+        printf("Error: Invalid background color!\n");
+        return -1;
+    }
 
-    if (!res) 
+    // Load input image using stb_image
+    int width, height, channels;
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
+    if (!image) 
     {
-        printf("Error saving image\n");
+        printf("Error loading image\n");
         return -1;
     }
 
-    return 0;
+    int out_width = width;
+    int out_height = height;
+    unsigned char* rotated_image;
+
+    // Exact path for multiples of 90 degrees
+    double quarter_turns = angle_degrees / 90.0;
+    if (fabs(quarter_turns - floor(quarter_turns + 0.5)) < 1e-9)
+    {
+        int turns = (int)fmod(floor(quarter_turns + 0.5), 4.0);
+        rotated_image = rotate_orthogonal(image, width, height, channels, turns, &out_width, &out_height);
+        if (!rotated_image)
+        {
+            free_image(image);
+            printf("Error: Memory allocation failed!\n");
+            return -1;
+        }
+    }
+    else
+    {
+        // A see-through background needs an alpha channel in the output
+        if (background && background_rgba[3] < 255 && (channels == 1 || channels == 3))
+        {
+            unsigned char* with_alpha = add_alpha_channel(image, width, height, channels);
+            free_image(image);
+            if (!with_alpha)
+            {
+                printf("Error: Memory allocation failed!\n");
+                return -1;
+            }
+            image = with_alpha;
+            channels++;
+        }
+
+        unsigned char fill[4];
+        color_to_pixel(background_rgba, channels, fill);
+        if (method == ROTATE_SHEAR)
+        {
+            rotated_image = rotate_shear_buffer(image, width, height, channels, angle_degrees, interpolation,
+                                                background != NULL, background ? fill : NULL,
+                                                &out_width, &out_height);
+        }
+        else
+        {
+            rotated_image = rotate_buffer(image, width, height, channels, angle_degrees, interpolation,
+                                          background != NULL, background ? fill : NULL,
+                                          &out_width, &out_height);
+        }
+        if (!rotated_image)
+        {
+            free_image(image);
+            printf("Error: Memory allocation failed!\n");
+            return -1;
+        }
+    }
+
+    // Save rotated image in the format given by the extension
+    int res = save_image(output_path, out_width, out_height, channels, rotated_image, 0);
+
+    // Clean up allocated memory
+    free_image(image);
+    free(rotated_image);
+
+    return res;
 }
\ No newline at end of file
@@ -11,6 +11,54 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "../libs/stb_image_write.h"
 
+/**
+ * @brief Computes the byte size of an image buffer with overflow checking
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @return width * height * channels, or 0 if a dimension is not positive
+ *         or the product does not fit in size_t
+ *
+ * @note All buffer sizes and offsets are computed in size_t, so images above
+ *       2^31 bytes (gigapixel scans) are addressed correctly
+ */
+size_t image_size(int width, int height, int channels)
+{
+    if (width <= 0 || height <= 0 || channels <= 0)
+    {
+        return 0;
+    }
+
+    size_t pixels = (size_t)width;
+    if (pixels > SIZE_MAX / (size_t)height)
+    {
+        return 0;
+    }
+    pixels *= (size_t)height;
+    if (pixels > SIZE_MAX / (size_t)channels)
+    {
+        return 0;
+    }
+    return pixels * (size_t)channels;
+}
+
+/**
+ * @brief Allocates an image buffer with overflow checking
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels
+ * @return Pointer to uninitialized buffer, NULL on overflow or allocation failure
+ */
+unsigned char* alloc_image(int width, int height, int channels)
+{
+    size_t size = image_size(width, height, channels);
+    if (!size)
+    {
+        return NULL;
+    }
+    return (unsigned char*)malloc(size);
+}
+
 /**
  * @brief Handles coordinate clamping for image boundaries
  * @param cord Input coordinate (may be out of bounds)
@@ -33,6 +81,25 @@ int get_cord(int cord, int max_len)
         return cord;  // Return unchanged if within bounds
 }
 
+/**
+ * @brief Clamps a coordinate to the image by repeating edge pixels
+ * @param cord Input coordinate (may be out of bounds)
+ * @param max_len Length along the corresponding axis
+ * @return Coordinate within [0, max_len-1] range
+ *
+ * @note Unlike get_cord(), works for any distance outside the image,
+ *       which interpolation near borders needs
+ */
+int get_clamped(int cord, int max_len)
+{
+    if(cord < 0)
+        return 0;
+    else if (cord >= max_len)
+        return max_len - 1;
+    else
+        return cord;
+}
+
 /**
  * @brief Converts color image to grayscale
  * @param image Pointer to image data (RGB or RGBA)
@@ -42,35 +109,27 @@ int get_cord(int cord, int max_len)
  * @return Pointer to grayscale image (same buffer)
  * 
  * @details Performs conversion by:
- * 1. Creating temporary copy of original image
- * 2. Calculating luminance via channel averaging
- * 3. Applying rounded division for proper grayscale values
- * 4. Setting all channels to same grayscale value
+ * 1. Calculating luminance via channel averaging
+ * 2. Applying rounded division for proper grayscale values
+ * 3. Setting all channels to same grayscale value
  * 
  * @note Uses simple averaging (equal weights for all channels)
- * @warning Allocates temporary memory - caller must free original buffer
+ * @note Works in place: every pixel is read completely before it is written,
+ *       so no copy of the image is needed
  */
 unsigned char* gradation_gray(unsigned char* image, int height, int width, int channels)
 {   
-    // Create temporary copy of original image
-    unsigned char* temp = (unsigned char*)malloc(height * width * channels);
-    if (!temp) 
-    {
-        printf("Error: Memory allocation failed!\n");
-        return NULL;
-    }
-    memcpy(temp, image, height * width * channels);
-
     // Process each pixel
     for(int i = 0; i < height; i++)
     {
         for(int j = 0; j < width; j++)
         {   
             // Calculate sum of all color channels
+            unsigned char* pixel = image + ((size_t)i * width + j) * channels;
             int sum = 0;
             for(int k = 0; k < channels; k++)
             {
-                sum += temp[(i * width + j) * channels + k];
+                sum += pixel[k];
             }
 
             // Compute grayscale value with proper rounding
@@ -80,12 +139,111 @@ unsigned char* gradation_gray(unsigned char* image, int height, int width, int c
             // Set all channels to grayscale value
             for(int k = 0; k < channels; k++)
             {
-                image[(i * width + j) * channels + k] = gray_value;
+                pixel[k] = gray_value;
             }
         }
     }
 
-    // Free temporary buffer
-    free(temp);
     return image;  // Return modified original buffer
+}
+
+/**
+ * @brief Parses a color given as text
+ * @param text "transparent", "RRGGBB" or "RRGGBBAA" (hex digits, optional leading '#')
+ * @param rgba Output color, 4 bytes
+ * @return 0 on success, -1 on invalid text
+ */
+int parse_color(const char* text, unsigned char* rgba)
+{
+    if (strcmp(text, "transparent") == 0)
+    {
+        memset(rgba, 0, 4);
+        return 0;
+    }
+
+    if (text[0] == '#')
+    {
+        text++;
+    }
+    size_t length = strlen(text);
+    if (length != 6 && length != 8)
+    {
+        return -1;
+    }
+
+    rgba[3] = 255;
+    for (size_t i = 0; i < length; i += 2)
+    {
+        int value = 0;
+        for (size_t j = i; j < i + 2; j++)
+        {
+            char c = text[j];
+            value *= 16;
+            if (c >= '0' && c <= '9') value += c - '0';
+            else if (c >= 'a' && c <= 'f') value += c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value += c - 'A' + 10;
+            else return -1;
+        }
+        rgba[i / 2] = (unsigned char)value;
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts an RGBA color to a pixel of the given channel layout
+ * @param rgba Color, 4 bytes
+ * @param channels 1 (gray), 2 (gray + alpha), 3 (RGB) or 4 (RGBA)
+ * @param pixel Output pixel, channels bytes
+ *
+ * @note Gray is the rounded channel average, as in gradation_gray()
+ */
+void color_to_pixel(const unsigned char* rgba, int channels, unsigned char* pixel)
+{
+    unsigned char gray = (unsigned char)((rgba[0] + rgba[1] + rgba[2] + 1) / 3);
+    switch (channels)
+    {
+    case 1:
+        pixel[0] = gray;
+        break;
+    case 2:
+        pixel[0] = gray;
+        pixel[1] = rgba[3];
+        break;
+    case 3:
+        memcpy(pixel, rgba, 3);
+        break;
+    default:
+        memcpy(pixel, rgba, 4);
+        break;
+    }
+}
+
+/**
+ * @brief Creates a copy of an image with an opaque alpha channel appended
+ * @param image Image data with 1 (gray) or 3 (RGB) channels
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param channels Number of color channels of the input
+ * @return Newly allocated image with channels + 1 channels, NULL on error
+ */
+unsigned char* add_alpha_channel(const unsigned char* image, int width, int height, int channels)
+{
+    unsigned char* result = alloc_image(width, height, channels + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    size_t pixels = (size_t)width * height;
+    const unsigned char* src = image;
+    unsigned char* dst = result;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        for (int k = 0; k < channels; k++)
+        {
+            *dst++ = *src++;
+        }
+        *dst++ = 255;
+    }
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+/**
+ * @file std_streams.c
+ * @brief Implementation of image input from stdin and output to stdout
+ *
+ * @details "-" as the input or output path makes imgproc work in pipes.
+ *          stdin is read once into memory and handed to the loader as a
+ *          seekable stream, since format detection and the decoders look at
+ *          the header more than once. Named pipes given as input paths
+ *          (e.g. bash process substitution) are held in memory the same way.
+ *          Image data on stdout must not mix with messages, so once stdout
+ *          carries an image everything printed with printf goes to stderr.
+ */
+#include "functions.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define STDIN_READ_SIZE 65536 ///< Bytes read from a pipe per call
+
+static char* input_path;          ///< Input held in memory: "-" for stdin or a pipe path
+static unsigned char* input_data; ///< All bytes of that input, NULL if it could not be read
+static size_t input_size;         ///< Bytes in input_data
+static FILE* image_output;        ///< Stream to the original stdout
+
+/**
+ * @brief Reads a stream to its end
+ * @param source Stream to read
+ * @param size Output: number of bytes read
+ * @return Bytes released with free(), NULL on a read or allocation error or
+ *         if the stream is empty
+ */
+static unsigned char* read_all(FILE* source, size_t* size)
+{
+    unsigned char* bytes = NULL;
+    size_t used = 0, capacity = 0;
+    for (;;)
+    {
+        if (used + STDIN_READ_SIZE > capacity)
+        {
+            size_t grown = capacity ? capacity * 2 : 4 * STDIN_READ_SIZE;
+            unsigned char* data = (unsigned char*)realloc(bytes, grown);
+            if (!data)
+            {
+                free(bytes);
+                return NULL;
+            }
+            bytes = data;
+            capacity = grown;
+        }
+        size_t count = fread(bytes + used, 1, STDIN_READ_SIZE, source);
+        used += count;
+        if (count < STDIN_READ_SIZE)
+        {
+            break;
+        }
+    }
+    if (ferror(source) || used == 0)
+    {
+        free(bytes);
+        return NULL;
+    }
+    *size = used;
+    return bytes;
+}
+
+/**
+ * @brief Opens an input image, or stdin for "-"
+ * @param path Path to the image file, "-" for stdin
+ * @return Seekable stream, closed with fclose(); NULL if the file cannot be
+ *         opened or a pipe is empty
+ *
+ * @details Regular files are opened as they are. stdin and streams that
+ *          cannot be rewound (named pipes, devices) are read to their end on
+ *          the first call and kept, so the same input can be opened again
+ *          (e.g. for image_info() and then for loading); only the last such
+ *          input is kept. On Windows, which has no memory streams, the bytes
+ *          go through an anonymous temporary file.
+ */
+FILE* open_image_stream(const char* path)
+{
+    if (!input_path || strcmp(input_path, path) != 0)
+    {
+        FILE* source = stdin;
+        if (strcmp(path, "-") != 0)
+        {
+            source = fopen(path, "rb");
+            if (!source || fseek(source, 0, SEEK_SET) == 0)
+            {
+                return source;
+            }
+        }
+#ifdef _WIN32
+        else
+        {
+            _setmode(_fileno(stdin), _O_BINARY);
+        }
+#endif
+
+        free(input_path);
+        free(input_data);
+        input_data = read_all(source, &input_size);
+        if (source != stdin)
+        {
+            fclose(source);
+        }
+        // The path is remembered even when reading failed: a pipe cannot be read twice
+        size_t length = strlen(path) + 1;
+        input_path = (char*)malloc(length);
+        if (input_path)
+        {
+            memcpy(input_path, path, length);
+        }
+    }
+    if (!input_data)
+    {
+        return NULL;
+    }
+
+#ifdef _WIN32
+    FILE* file = tmpfile();
+    if (file && (fwrite(input_data, 1, input_size, file) != input_size || fseek(file, 0, SEEK_SET) != 0))
+    {
+        fclose(file);
+        file = NULL;
+    }
+    return file;
+#else
+    return fmemopen(input_data, input_size, "rb");
+#endif
+}
+
+/**
+ * @brief Gives the stream for image data on stdout
+ * @return Binary stream to the original stdout (flushed, never closed by the
+ *         caller); NULL on error
+ *
+ * @details On the first call the original stdout is duplicated for the image
+ *          and the stdout descriptor is pointed at stderr, so messages of the
+ *          operations no longer end up inside the image. main() calls it
+ *          before running an operation whose output is "-".
+ */
+FILE* image_stdout(void)
+{
+    if (image_output)
+    {
+        return image_output;
+    }
+    fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+    if (fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0)
+    {
+        return NULL;
+    }
+    _setmode(fd, _O_BINARY);
+    image_output = _fdopen(fd, "wb");
+#else
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    {
+        return NULL;
+    }
+    image_output = fdopen(fd, "wb");
+#endif
+    return image_output;
+}
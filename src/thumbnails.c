@@ -0,0 +1,369 @@
+/**
+ * @file thumbnails.c
+ * @brief Implementation of resizing to target boxes and thumbnail ladders
+ */
+#include "functions.h"
+
+#define BOX_FIT 0   ///< Scale to fit inside the box, keep aspect ratio
+#define BOX_FILL 1  ///< Scale to cover the box, keep aspect ratio, crop the overflow
+#define BOX_EXACT 2 ///< Stretch to the box size
+
+#define MAX_LADDER 32        ///< Maximum number of sizes in one ladder
+#define LADDER_MIN_RATIO 2.0 ///< A level may be derived from a previous one at least this much larger
+
+/**
+ * @brief Target box of one output size
+ */
+typedef struct
+{
+    int width;       ///< Box width, 0 to follow the aspect ratio
+    int height;      ///< Box height, 0 to follow the aspect ratio
+    int mode;        ///< BOX_FIT, BOX_FILL or BOX_EXACT
+    int scaled_w;    ///< Width of the whole image scaled for this box
+    int scaled_h;    ///< Height of the whole image scaled for this box
+    int out_w;       ///< Output width (smaller than scaled_w if cropped)
+    int out_h;       ///< Output height (smaller than scaled_h if cropped)
+    unsigned char* pixels; ///< Whole scaled image, scaled_w x scaled_h
+} thumb_box;
+
+/**
+ * @brief Parses a box given as text
+ * @param text "WxH", "WxH:fit", "WxH:fill", "WxH:exact" or "W"
+ *             (0 or a missing size follows the aspect ratio)
+ * @param box Output box
+ * @return 0 on success, -1 on invalid text
+ */
+static int parse_box(const char* text, thumb_box* box)
+{
+    char* end;
+    long width = strtol(text, &end, 10);
+    long height = 0;
+    if (end == text)
+    {
+        return -1;
+    }
+    if (*end == 'x' || *end == 'X')
+    {
+        const char* start = end + 1;
+        height = strtol(start, &end, 10);
+        if (end == start)
+        {
+            return -1;
+        }
+    }
+
+    box->mode = BOX_FIT;
+    if (*end == ':')
+    {
+        end++;
+        if (strcmp(end, "fit") == 0) box->mode = BOX_FIT;
+        else if (strcmp(end, "fill") == 0) box->mode = BOX_FILL;
+        else if (strcmp(end, "exact") == 0) box->mode = BOX_EXACT;
+        else return -1;
+    }
+    else if (*end != '\0')
+    {
+        return -1;
+    }
+
+    if (width < 0 || height < 0 || width > INT_MAX || height > INT_MAX || (width == 0 && height == 0))
+    {
+        return -1;
+    }
+    box->width = (int)width;
+    box->height = (int)height;
+    box->pixels = NULL;
+    return 0;
+}
+
+/**
+ * @brief Computes the scaled and output sizes of a box for an image
+ * @param box Box, sizes are filled in
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @return 0 on success, -1 if a size is out of range
+ */
+static int layout_box(thumb_box* box, int width, int height)
+{
+    double scale_x = (double)box->width / width;
+    double scale_y = (double)box->height / height;
+
+    // A missing side follows the other one
+    if (box->width == 0) scale_x = scale_y;
+    if (box->height == 0) scale_y = scale_x;
+    if (box->mode == BOX_FIT && box->width && box->height)
+    {
+        scale_x = scale_y = scale_x < scale_y ? scale_x : scale_y;
+    }
+    else if (box->mode == BOX_FILL && box->width && box->height)
+    {
+        scale_x = scale_y = scale_x > scale_y ? scale_x : scale_y;
+    }
+
+    double scaled_w = floor(width * scale_x + 0.5);
+    double scaled_h = floor(height * scale_y + 0.5);
+    if (scaled_w > INT_MAX || scaled_h > INT_MAX)
+    {
+        return -1;
+    }
+    box->scaled_w = scaled_w < 1 ? 1 : (int)scaled_w;
+    box->scaled_h = scaled_h < 1 ? 1 : (int)scaled_h;
+
+    // Exact and fit boxes output the whole scaled image, fill boxes crop to the box
+    box->out_w = box->scaled_w;
+    box->out_h = box->scaled_h;
+    if (box->mode == BOX_FILL && box->width && box->height)
+    {
+        if (box->out_w > box->width) box->out_w = box->width;
+        if (box->out_h > box->height) box->out_h = box->height;
+    }
+    return 0;
+}
+
+/**
+ * @brief Saves the output of a box, cropping it to the center if needed
+ * @param box Box with scaled pixels
+ * @param channels Number of color channels
+ * @param output_path Path to save the image
+ * @return 0 on success, -1 on error
+ */
+static int save_box(const thumb_box* box, int channels, const char* output_path)
+{
+    // Crop is a view into the scaled image: offset start, full row stride
+    int x0 = (box->scaled_w - box->out_w) / 2;
+    int y0 = (box->scaled_h - box->out_h) / 2;
+    int stride = box->scaled_w * channels;
+    const unsigned char* start = box->pixels + (size_t)y0 * stride + (size_t)x0 * channels;
+
+    return save_image(output_path, box->out_w, box->out_h, channels, start, stride);
+}
+
+/**
+ * @brief Scales an image for every box of a ladder
+ * @param image Decoded source image
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param area Part of the source covered by the image (see load_image_scaled()),
+ *             NULL for all of it
+ * @param boxes Boxes with layout done, pixels are filled in
+ * @param count Number of boxes
+ * @param filter Resampling filter
+ * @return 0 on success, -1 on allocation failure
+ *
+ * @details Boxes are processed from the largest to the smallest. Each one is
+ *          resampled from the smallest image produced so far that is still at
+ *          least LADDER_MIN_RATIO times larger along both axes, so most levels
+ *          read a small image instead of the full source. The antialiasing
+ *          filter of the previous level is far above the new cutoff
+ *          frequency, so the result is practically the same as resampling
+ *          the source directly.
+ */
+static int scale_ladder(const unsigned char* image, int width, int height, int channels,
+                        const double* area, thumb_box* boxes, int count, int filter)
+{
+    // Order by scaled area, largest first
+    int order[MAX_LADDER];
+    for (int i = 0; i < count; i++)
+    {
+        int j = i;
+        double area = (double)boxes[i].scaled_w * boxes[i].scaled_h;
+        while (j > 0 && (double)boxes[order[j - 1]].scaled_w * boxes[order[j - 1]].scaled_h < area)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        thumb_box* box = &boxes[order[i]];
+
+        // Smallest suitable level so far, the source if none is large enough
+        const unsigned char* from = image;
+        const double* from_area = area;
+        int from_w = width, from_h = height;
+        for (int j = 0; j < i; j++)
+        {
+            const thumb_box* level = &boxes[order[j]];
+            if (level->scaled_w >= LADDER_MIN_RATIO * box->scaled_w &&
+                level->scaled_h >= LADDER_MIN_RATIO * box->scaled_h &&
+                (double)level->scaled_w * level->scaled_h < (double)from_w * from_h)
+            {
+                from = level->pixels;
+                from_area = NULL;
+                from_w = level->scaled_w;
+                from_h = level->scaled_h;
+            }
+        }
+
+        box->pixels = resample_area(from, from_w, from_h, channels, from_area,
+                                    box->scaled_w, box->scaled_h, filter);
+        if (!box->pixels)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Builds the output path of a ladder level
+ * @param output_path Base output path, e.g. "thumbs/photo.jpg"
+ * @param box Level box
+ * @param path Output buffer
+ * @param size Size of the output buffer
+ * @return 0 on success, -1 if the path does not fit
+ *
+ * @note The output size is inserted before the extension: "thumbs/photo_256x171.jpg"
+ */
+static int level_path(const char* output_path, const thumb_box* box, char* path, size_t size)
+{
+    const char* dot = strrchr(output_path, '.');
+    const char* slash = strrchr(output_path, '/');
+    const char* backslash = strrchr(output_path, '\\');
+    if (!dot || (slash && slash > dot) || (backslash && backslash > dot))
+    {
+        dot = output_path + strlen(output_path);
+    }
+
+    int written = snprintf(path, size, "%.*s_%dx%d%s", (int)(dot - output_path), output_path,
+                           box->out_w, box->out_h, dot);
+    return written < 0 || (size_t)written >= size ? -1 : 0;
+}
+
+/**
+ * @brief Resizes an image to fit, fill or match a target box
+ * @param input_path Path to input image
+ * @param output_path Path to save resized image
+ * @param spec Target box: "WxH" or "WxH:fit" (fit inside, keep aspect ratio),
+ *             "WxH:fill" (cover and crop to exactly WxH), "WxH:exact" (stretch),
+ *             0 or a missing size follows the aspect ratio
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @return 0 on success, -1 on error
+ */
+int resize_to_box(char* input_path, char* output_path, char* spec, int filter)
+{
+    return thumbnail_ladder(input_path, output_path, spec, filter, 0);
+}
+
+/**
+ * @brief Produces several resized versions of an image from a single decode
+ * @param input_path Path to input image
+ * @param output_path Base output path, the size of every level is inserted
+ *                    before the extension ("photo.jpg" -> "photo_256x171.jpg")
+ * @param specs Comma-separated target boxes, each as accepted by resize_to_box()
+ * @param filter FILTER_BOX, FILTER_TRIANGLE, FILTER_CATMULL_ROM or FILTER_LANCZOS3
+ * @param add_suffix Non-zero to add the size to the file names (needed for
+ *                   more than one box), zero to save to output_path as is
+ * @return 0 on success, -1 on error
+ *
+ * @details The source is decoded once, JPEGs at the smallest 1/2, 1/4 or
+ *          1/8 reduction that still covers the largest level. Smaller levels
+ *          are resampled from larger ones where quality allows (see scale_ladder()).
+ */
+int thumbnail_ladder(char* input_path, char* output_path, char* specs, int filter, int add_suffix)
+{
+    if (filter < FILTER_BOX || filter > FILTER_LANCZOS3)
+    {
+        printf("Error: Unknown resampling filter!\n");
+        return -1;
+    }
+
+    // Parse boxes
+    thumb_box boxes[MAX_LADDER];
+    int count = 0;
+    const char* spec = specs;
+    while (*spec)
+    {
+        const char* comma = strchr(spec, ',');
+        size_t length = comma ? (size_t)(comma - spec) : strlen(spec);
+        char text[64];
+        if (count == MAX_LADDER || length >= sizeof(text))
+        {
+            printf("Error: Too many or too long sizes!\n");
+            return -1;
+        }
+        memcpy(text, spec, length);
+        text[length] = '\0';
+        if (parse_box(text, &boxes[count]) != 0)
+        {
+            printf("Error: Invalid size '%s'! Use WxH[:fit|:fill|:exact]\n", text);
+            return -1;
+        }
+        count++;
+        spec += length;
+        if (*spec == ',')
+        {
+            spec++;
+        }
+    }
+    if (count == 0 || (count > 1 && !add_suffix))
+    {
+        printf("Error: Expected one size!\n");
+        return -1;
+    }
+
+    // Box sizes follow the full image, read from the header
+    int width, height, channels;
+    if (!image_info(input_path, &width, &height, &channels))
+    {
+        printf("Error loading image\n");
+        return -1;
+    }
+
+    int max_w = 0, max_h = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (layout_box(&boxes[i], width, height) != 0)
+        {
+            printf("Error: Resulting image size is out of range!\n");
+            return -1;
+        }
+        if (boxes[i].scaled_w > max_w) max_w = boxes[i].scaled_w;
+        if (boxes[i].scaled_h > max_h) max_h = boxes[i].scaled_h;
+    }
+
+    // Decode JPEGs only as large as the largest level needs
+    double area[4];
+    unsigned char* image = load_image_scaled(input_path, &width, &height, &channels, max_w, max_h, area);
+    if (!image)
+    {
+        printf("Error loading image\n");
+        return -1;
+    }
+
+    int res = scale_ladder(image, width, height, channels, area, boxes, count, filter);
+    free_image(image);
+    if (res != 0)
+    {
+        printf("Error: Memory allocation failed!\n");
+    }
+
+    // Save every level
+    for (int i = 0; i < count && res == 0; i++)
+    {
+        char path[4096];
+        if (!add_suffix)
+        {
+            res = save_box(&boxes[i], channels, output_path);
+        }
+        else if (level_path(output_path, &boxes[i], path, sizeof(path)) != 0)
+        {
+            printf("Error: Output path is too long!\n");
+            res = -1;
+        }
+        else
+        {
+            res = save_box(&boxes[i], channels, path);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        free(boxes[i].pixels);
+    }
+    return res;
+}
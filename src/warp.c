@@ -0,0 +1,730 @@
+/**
+ * @file warp.c
+ * @brief Implementation of affine and perspective image warping
+ *
+ * @details Every geometric transform (rotation, scaling, shearing, perspective)
+ *          is done by inverse mapping: each destination pixel looks up its
+ *          source position through a 3x3 matrix and samples it there.
+ */
+#include "functions.h"
+
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define WARP_TILE_WIDTH 256 ///< Tile width (pixels) processed by one thread at a time
+#define WARP_TILE_HEIGHT 32 ///< Tile height (pixels) processed by one thread at a time
+
+/**
+ * @brief Finds the pixels of a row whose source coordinate lies in a range
+ * @param a Source coordinate of pixel 0
+ * @param b Source coordinate increment per pixel
+ * @param lo Lowest allowed source coordinate (inclusive)
+ * @param hi Highest allowed source coordinate (exclusive)
+ * @param count Number of pixels in the row
+ * @param start Input/output: first pixel of the span
+ * @param end Input/output: one past the last pixel of the span
+ *
+ * @details The span found is intersected with [start, end), so calling it
+ *          once per axis gives the pixels valid for both coordinates.
+ *          Bounds are tightened by a small margin so that coordinates
+ *          accumulated incrementally along the row stay inside the range.
+ */
+static void coordinate_span(double a, double b, double lo, double hi, int count, int* start, int* end)
+{
+    const double margin = 1e-6;
+    lo += margin;
+    hi -= margin;
+
+    int first = 0;
+    int last = count;
+    if (fabs(b) < 1e-12)
+    {
+        if (a < lo || a >= hi)
+        {
+            last = 0;
+        }
+    }
+    else
+    {
+        double x1 = (lo - a) / b;
+        double x2 = (hi - a) / b;
+        if (x1 > x2)
+        {
+            double t = x1;
+            x1 = x2;
+            x2 = t;
+        }
+        double f = ceil(x1);
+        double l = ceil(x2);
+        first = f < 0 ? 0 : (f > count ? count : (int)f);
+        last = l < 0 ? 0 : (l > count ? count : (int)l);
+
+        // Correct rounding at the ends of the span
+        while (first < last && (a + b * first < lo || a + b * first >= hi)) first++;
+        while (last > first && (a + b * (last - 1) < lo || a + b * (last - 1) >= hi)) last--;
+    }
+
+    if (first > *start) *start = first;
+    if (last < *end) *end = last;
+    if (*end < *start) *end = *start;
+}
+
+/**
+ * @brief Computes Catmull-Rom weights for the 4 taps around a sample
+ * @param t Fractional position between tap 1 and tap 2, in [0,1)
+ * @param w Output weights for taps at distances 1+t, t, 1-t, 2-t
+ */
+void cubic_weights(float t, float* w)
+{
+    w[0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+    w[1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+    w[2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+    w[3] = (0.5f * t - 0.5f) * t * t;
+}
+
+/**
+ * @brief Samples one pixel near the image border
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param sx Source x coordinate
+ * @param sy Source y coordinate
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Pixel used for taps outside the image, NULL to repeat edge pixels
+ * @param dst Output pixel
+ *
+ * @note Slow path for the few pixels near image borders, where some taps
+ *       fall outside the image. Those taps take the fill pixel, so warped
+ *       edges blend smoothly into the background. Gives the same result as
+ *       the row samplers wherever all taps are inside.
+ */
+static void sample_border(const unsigned char* src, int width, int height, int channels,
+                          double sx, double sy, int interpolation, const unsigned char* fill,
+                          unsigned char* dst)
+{
+    if (interpolation == INTERP_NEAREST)
+    {
+        int x = get_clamped((int)floor(sx + 0.5), width);
+        int y = get_clamped((int)floor(sy + 0.5), height);
+        memcpy(dst, src + ((size_t)y * width + x) * channels, channels);
+        return;
+    }
+
+    int x0 = (int)floor(sx);
+    int y0 = (int)floor(sy);
+
+    // Pointers to the source pixels of a 4x4 footprint starting at (x0 - 1, y0 - 1)
+    const unsigned char* taps[4][4];
+    for (int j = 0; j < 4; j++)
+    {
+        int y = y0 - 1 + j;
+        for (int i = 0; i < 4; i++)
+        {
+            int x = x0 - 1 + i;
+            if (!fill)
+            {
+                taps[j][i] = src + ((size_t)get_clamped(y, height) * width + get_clamped(x, width)) * channels;
+            }
+            else if (x < 0 || x >= width || y < 0 || y >= height)
+            {
+                taps[j][i] = fill;
+            }
+            else
+            {
+                taps[j][i] = src + ((size_t)y * width + x) * channels;
+            }
+        }
+    }
+
+    if (interpolation == INTERP_BILINEAR)
+    {
+        int fx = (int)((sx - x0) * 128);
+        int fy = (int)((sy - y0) * 128);
+        for (int k = 0; k < channels; k++)
+        {
+            int top = taps[1][1][k] * (128 - fx) + taps[1][2][k] * fx;
+            int bottom = taps[2][1][k] * (128 - fx) + taps[2][2][k] * fx;
+            dst[k] = (unsigned char)((top * (128 - fy) + bottom * fy + 8192) >> 14);
+        }
+        return;
+    }
+
+    float wx[4], wy[4];
+    cubic_weights((float)(sx - x0), wx);
+    cubic_weights((float)(sy - y0), wy);
+    for (int k = 0; k < channels; k++)
+    {
+        float sum = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            float row_sum = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                row_sum += taps[j][i][k] * wx[i];
+            }
+            sum += row_sum * wy[j];
+        }
+        dst[k] = sum <= 0 ? 0 : (sum >= 255 ? 255 : (unsigned char)(sum + 0.5f));
+    }
+}
+
+/**
+ * @brief Fills a run of pixels with one color
+ * @param dst First pixel
+ * @param count Number of pixels
+ * @param channels Number of color channels
+ * @param fill Pixel value
+ */
+void fill_pixels(unsigned char* dst, int count, int channels, const unsigned char* fill)
+{
+    for (int i = 0; i < count; i++, dst += channels)
+    {
+        memcpy(dst, fill, channels);
+    }
+}
+
+/**
+ * @brief Nearest-neighbor sampling along a destination row span
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param channels Number of color channels
+ * @param sx Source x coordinate of the first pixel
+ * @param sy Source y coordinate of the first pixel
+ * @param dx Source x increment per destination pixel
+ * @param dy Source y increment per destination pixel
+ * @param count Number of pixels
+ * @param dst First destination pixel
+ *
+ * @note The span must be precomputed so that every sample lies inside the
+ *       image: the loop does no bounds checks. Coordinates are shifted by
+ *       0.5 once so that truncation rounds to the nearest pixel.
+ */
+static void nearest_row(const unsigned char* src, int width, int channels,
+                        double sx, double sy, double dx, double dy, int count, unsigned char* dst)
+{
+    sx += 0.5;
+    sy += 0.5;
+    for (int i = 0; i < count; i++, sx += dx, sy += dy, dst += channels)
+    {
+        const unsigned char* p = src + ((size_t)(int)sy * width + (int)sx) * channels;
+        memcpy(dst, p, channels);
+    }
+}
+
+/**
+ * @brief Bilinear sampling along a destination row span (scalar)
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param channels Number of color channels
+ * @param sx Source x coordinate of the first pixel
+ * @param sy Source y coordinate of the first pixel
+ * @param dx Source x increment per destination pixel
+ * @param dy Source y increment per destination pixel
+ * @param count Number of pixels
+ * @param dst First destination pixel
+ *
+ * @details Weights use 7 fractional bits, so every intermediate result fits
+ *          a signed 16-bit lane and the SIMD variant gives identical output.
+ * @note No bounds checks: the span guarantees 0 <= sx < width - 1 and
+ *       0 <= sy < height - 1.
+ */
+static void bilinear_row(const unsigned char* src, int width, int channels,
+                         double sx, double sy, double dx, double dy, int count, unsigned char* dst)
+{
+    size_t stride = (size_t)width * channels;
+    for (int i = 0; i < count; i++, sx += dx, sy += dy, dst += channels)
+    {
+        int x0 = (int)sx;
+        int y0 = (int)sy;
+        int fx = (int)((sx - x0) * 128);
+        int fy = (int)((sy - y0) * 128);
+        const unsigned char* p = src + (size_t)y0 * stride + (size_t)x0 * channels;
+        for (int k = 0; k < channels; k++)
+        {
+            int top = p[k] * (128 - fx) + p[channels + k] * fx;
+            int bottom = p[stride + k] * (128 - fx) + p[stride + channels + k] * fx;
+            dst[k] = (unsigned char)((top * (128 - fy) + bottom * fy + 8192) >> 14);
+        }
+    }
+}
+
+#ifdef USE_SSE2
+/**
+ * @brief Bilinear sampling along a destination row span (SSE2, 3 or 4 channels)
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param channels Number of color channels (3 or 4)
+ * @param sx Source x coordinate of the first pixel
+ * @param sy Source y coordinate of the first pixel
+ * @param dx Source x increment per destination pixel
+ * @param dy Source y increment per destination pixel
+ * @param count Number of pixels
+ * @param dst First destination pixel
+ *
+ * @details Each pair of neighbouring source pixels is loaded as one 64-bit
+ *          value and widened to 16-bit lanes. Horizontal blending is a
+ *          multiply and a shifted add, vertical blending a single madd.
+ *          Arithmetic matches bilinear_row() exactly.
+ */
+static void bilinear_row_sse2(const unsigned char* src, int width, int channels,
+                              double sx, double sy, double dx, double dy, int count, unsigned char* dst)
+{
+    size_t stride = (size_t)width * channels;
+    size_t pair = 2 * (size_t)channels;
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi32(8192);
+
+    for (int i = 0; i < count; i++, sx += dx, sy += dy, dst += channels)
+    {
+        int x0 = (int)sx;
+        int y0 = (int)sy;
+        int fx = (int)((sx - x0) * 128);
+        int fy = (int)((sy - y0) * 128);
+        const unsigned char* p = src + (size_t)y0 * stride + (size_t)x0 * channels;
+
+        long long top_bytes = 0, bottom_bytes = 0;
+        memcpy(&top_bytes, p, pair);
+        memcpy(&bottom_bytes, p + stride, pair);
+        __m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&top_bytes), zero);
+        __m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&bottom_bytes), zero);
+
+        // Left pixel lanes get 128 - fx, right pixel lanes get fx
+        __m128i wx;
+        if (channels == 4)
+        {
+            wx = _mm_setr_epi16(128 - fx, 128 - fx, 128 - fx, 128 - fx, fx, fx, fx, fx);
+            top = _mm_mullo_epi16(top, wx);
+            bottom = _mm_mullo_epi16(bottom, wx);
+            top = _mm_add_epi16(top, _mm_srli_si128(top, 8));
+            bottom = _mm_add_epi16(bottom, _mm_srli_si128(bottom, 8));
+        }
+        else
+        {
+            wx = _mm_setr_epi16(128 - fx, 128 - fx, 128 - fx, fx, fx, fx, 0, 0);
+            top = _mm_mullo_epi16(top, wx);
+            bottom = _mm_mullo_epi16(bottom, wx);
+            top = _mm_add_epi16(top, _mm_srli_si128(top, 6));
+            bottom = _mm_add_epi16(bottom, _mm_srli_si128(bottom, 6));
+        }
+
+        // Interleave rows and blend vertically with one multiply-add
+        __m128i wy = _mm_set1_epi32(((unsigned int)fy << 16) | (unsigned int)(128 - fy));
+        __m128i sum = _mm_madd_epi16(_mm_unpacklo_epi16(top, bottom), wy);
+        sum = _mm_srai_epi32(_mm_add_epi32(sum, round), 14);
+        sum = _mm_packs_epi32(sum, sum);
+        sum = _mm_packus_epi16(sum, sum);
+
+        int result = _mm_cvtsi128_si32(sum);
+        memcpy(dst, &result, channels);
+    }
+}
+#endif
+
+/**
+ * @brief Bicubic (Catmull-Rom) sampling along a destination row span
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param channels Number of color channels
+ * @param sx Source x coordinate of the first pixel
+ * @param sy Source y coordinate of the first pixel
+ * @param dx Source x increment per destination pixel
+ * @param dy Source y increment per destination pixel
+ * @param count Number of pixels
+ * @param dst First destination pixel
+ *
+ * @note No bounds checks: the span guarantees 1 <= sx < width - 2 and
+ *       1 <= sy < height - 2.
+ */
+static void bicubic_row(const unsigned char* src, int width, int channels,
+                        double sx, double sy, double dx, double dy, int count, unsigned char* dst)
+{
+    size_t stride = (size_t)width * channels;
+    for (int i = 0; i < count; i++, sx += dx, sy += dy, dst += channels)
+    {
+        int x0 = (int)sx;
+        int y0 = (int)sy;
+        float wx[4], wy[4];
+        cubic_weights((float)(sx - x0), wx);
+        cubic_weights((float)(sy - y0), wy);
+
+        const unsigned char* p = src + (size_t)(y0 - 1) * stride + (size_t)(x0 - 1) * channels;
+        for (int k = 0; k < channels; k++)
+        {
+            float sum = 0;
+            const unsigned char* row = p + k;
+            for (int j = 0; j < 4; j++, row += stride)
+            {
+                float row_sum = row[0] * wx[0] + row[channels] * wx[1]
+                              + row[2 * channels] * wx[2] + row[3 * channels] * wx[3];
+                sum += row_sum * wy[j];
+            }
+            dst[k] = sum <= 0 ? 0 : (sum >= 255 ? 255 : (unsigned char)(sum + 0.5f));
+        }
+    }
+}
+
+/**
+ * @brief Samples a single pixel with the row samplers
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param sx Source x coordinate
+ * @param sy Source y coordinate
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Background pixel, NULL to repeat edge pixels
+ * @param dst Output pixel
+ *
+ * @note Used by perspective warps, where the source step is not constant
+ *       along a row
+ */
+static void sample_pixel(const unsigned char* src, int width, int height, int channels,
+                         double sx, double sy, int interpolation, const unsigned char* fill,
+                         unsigned char* dst)
+{
+    // Outside the image: background
+    if (fill && (sx < -0.5 || sx >= width - 0.5 || sy < -0.5 || sy >= height - 0.5))
+    {
+        memcpy(dst, fill, channels);
+        return;
+    }
+
+    if (interpolation == INTERP_NEAREST)
+    {
+        if (sx >= -0.5 && sx < width - 0.5 && sy >= -0.5 && sy < height - 0.5)
+        {
+            nearest_row(src, width, channels, sx, sy, 0, 0, 1, dst);
+            return;
+        }
+    }
+    else if (interpolation == INTERP_BILINEAR)
+    {
+        if (sx >= 0 && sx < width - 1 && sy >= 0 && sy < height - 1)
+        {
+            bilinear_row(src, width, channels, sx, sy, 0, 0, 1, dst);
+            return;
+        }
+    }
+    else if (sx >= 1 && sx < width - 2 && sy >= 1 && sy < height - 2)
+    {
+        bicubic_row(src, width, channels, sx, sy, 0, 0, 1, dst);
+        return;
+    }
+
+    sample_border(src, width, height, channels, sx, sy, interpolation, fill, dst);
+}
+
+/**
+ * @brief Samples one affine row segment
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param sx Source x coordinate of the first pixel
+ * @param sy Source y coordinate of the first pixel
+ * @param dx Source x increment per destination pixel
+ * @param dy Source y increment per destination pixel
+ * @param count Number of pixels
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Background pixel, NULL to repeat edge pixels
+ * @param zero_fill Non-zero if the destination already holds the background
+ * @param out First destination pixel
+ *
+ * @details The segment is split into spans computed once:
+ *          - pixels whose source lies outside the image get the background
+ *          - pixels near the border are sampled by sample_border()
+ *          - the interior is sampled by a row routine without bounds checks
+ */
+static void warp_affine_segment(const unsigned char* src, int width, int height, int channels,
+                                double sx, double sy, double dx, double dy, int count,
+                                int interpolation, const unsigned char* fill, int zero_fill,
+                                unsigned char* out)
+{
+    // Source coordinates needed around a sample by each interpolation
+    double inner_lo = 0, inner_hi_x = width - 1, inner_hi_y = height - 1;
+    if (interpolation == INTERP_NEAREST)
+    {
+        inner_lo = -0.5;
+        inner_hi_x = width - 0.5;
+        inner_hi_y = height - 0.5;
+    }
+    else if (interpolation == INTERP_BICUBIC)
+    {
+        inner_lo = 1;
+        inner_hi_x = width - 2;
+        inner_hi_y = height - 2;
+    }
+
+    // Pixels mapping anywhere inside the source image (all of them when
+    // edge pixels are repeated)
+    int outer_start = 0, outer_end = count;
+    if (fill)
+    {
+        coordinate_span(sx, dx, -0.5, width - 0.5, count, &outer_start, &outer_end);
+        coordinate_span(sy, dy, -0.5, height - 0.5, count, &outer_start, &outer_end);
+    }
+
+    // Pixels whose whole interpolation footprint is inside the image
+    int inner_start = outer_start, inner_end = outer_end;
+    coordinate_span(sx, dx, inner_lo, inner_hi_x, count, &inner_start, &inner_end);
+    coordinate_span(sy, dy, inner_lo, inner_hi_y, count, &inner_start, &inner_end);
+
+    // Areas outside the source get the background (already there for zeros)
+    if (fill && !zero_fill)
+    {
+        fill_pixels(out, outer_start, channels, fill);
+        fill_pixels(out + (size_t)outer_end * channels, count - outer_end, channels, fill);
+    }
+
+    // Border pixels blend with the background
+    for (int x = outer_start; x < outer_end; x++)
+    {
+        if (x == inner_start)
+        {
+            x = inner_end;
+            if (x >= outer_end)
+            {
+                break;
+            }
+        }
+        sample_border(src, width, height, channels, sx + dx * x, sy + dy * x,
+                      interpolation, fill, out + (size_t)x * channels);
+    }
+
+    // Interior span without any bounds checks
+    int inner_count = inner_end - inner_start;
+    if (inner_count <= 0)
+    {
+        return;
+    }
+    double start_x = sx + dx * inner_start;
+    double start_y = sy + dy * inner_start;
+    unsigned char* dst = out + (size_t)inner_start * channels;
+    if (interpolation == INTERP_NEAREST)
+    {
+        nearest_row(src, width, channels, start_x, start_y, dx, dy, inner_count, dst);
+    }
+    else if (interpolation == INTERP_BICUBIC)
+    {
+        bicubic_row(src, width, channels, start_x, start_y, dx, dy, inner_count, dst);
+    }
+#ifdef USE_SSE2
+    else if (channels == 3 || channels == 4)
+    {
+        bilinear_row_sse2(src, width, channels, start_x, start_y, dx, dy, inner_count, dst);
+    }
+#endif
+    else
+    {
+        bilinear_row(src, width, channels, start_x, start_y, dx, dy, inner_count, dst);
+    }
+}
+
+/**
+ * @brief Inverts a 3x3 matrix
+ * @param m Matrix in row-major order
+ * @param inverse Output matrix in row-major order
+ * @return 0 on success, -1 if the matrix is singular
+ */
+int invert_matrix3(const double* m, double* inverse)
+{
+    double c00 = m[4] * m[8] - m[5] * m[7];
+    double c01 = m[5] * m[6] - m[3] * m[8];
+    double c02 = m[3] * m[7] - m[4] * m[6];
+    double det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+    if (fabs(det) < 1e-12)
+    {
+        return -1;
+    }
+
+    inverse[0] = c00 / det;
+    inverse[1] = (m[2] * m[7] - m[1] * m[8]) / det;
+    inverse[2] = (m[1] * m[5] - m[2] * m[4]) / det;
+    inverse[3] = c01 / det;
+    inverse[4] = (m[0] * m[8] - m[2] * m[6]) / det;
+    inverse[5] = (m[2] * m[3] - m[0] * m[5]) / det;
+    inverse[6] = c02 / det;
+    inverse[7] = (m[1] * m[6] - m[0] * m[7]) / det;
+    inverse[8] = (m[0] * m[4] - m[1] * m[3]) / det;
+    return 0;
+}
+
+/**
+ * @brief Warps image data through a projective transform
+ * @param src Source image data
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param channels Number of color channels
+ * @param matrix 3x3 row-major matrix mapping destination pixel (x, y, 1)
+ *               to homogeneous source coordinates (inverse mapping)
+ * @param dst_width Destination width in pixels
+ * @param dst_height Destination height in pixels
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @param fill Background pixel in the source channel layout for areas
+ *             outside the source, NULL to repeat edge pixels instead
+ * @return Newly allocated warped image, NULL on error
+ *
+ * @details The destination is split into tiles shared among threads, so the
+ *          source area read by one thread stays compact. Inside a tile:
+ *          - affine matrices (last row 0 0 1) step the source position by a
+ *            constant per pixel and use span-split row samplers
+ *          - perspective matrices step numerators and denominator by
+ *            constants and divide once per pixel
+ *
+ * @note With an all-zero background the buffer comes zeroed from calloc
+ *       and empty areas are not touched at all
+ */
+unsigned char* warp_buffer(const unsigned char* src, int width, int height, int channels,
+                           const double* matrix, int dst_width, int dst_height,
+                           int interpolation, const unsigned char* fill)
+{
+    // Normalize so that the bottom-right element is 1
+    double m[9];
+    double scale = matrix[8] != 0 ? matrix[8] : 1.0;
+    for (int i = 0; i < 9; i++)
+    {
+        m[i] = matrix[i] / scale;
+    }
+    int affine = m[6] == 0 && m[7] == 0;
+
+    int zero_fill = 0;
+    if (fill)
+    {
+        zero_fill = 1;
+        for (int k = 0; k < channels; k++)
+        {
+            if (fill[k] != 0) zero_fill = 0;
+        }
+    }
+
+    size_t size = image_size(dst_width, dst_height, channels);
+    if (!size)
+    {
+        return NULL;
+    }
+    unsigned char* dst = zero_fill ? (unsigned char*)calloc(size, 1) : (unsigned char*)malloc(size);
+    if (!dst)
+    {
+        return NULL;
+    }
+
+    size_t stride = (size_t)dst_width * channels;
+    int tiles_x = (dst_width + WARP_TILE_WIDTH - 1) / WARP_TILE_WIDTH;
+    int tiles_y = (dst_height + WARP_TILE_HEIGHT - 1) / WARP_TILE_HEIGHT;
+    long long tiles = (long long)tiles_x * tiles_y;
+
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (long long tile = 0; tile < tiles; tile++)
+    {
+        int x_start = (int)(tile % tiles_x) * WARP_TILE_WIDTH;
+        int y_start = (int)(tile / tiles_x) * WARP_TILE_HEIGHT;
+        int x_end = x_start + WARP_TILE_WIDTH < dst_width ? x_start + WARP_TILE_WIDTH : dst_width;
+        int y_end = y_start + WARP_TILE_HEIGHT < dst_height ? y_start + WARP_TILE_HEIGHT : dst_height;
+        int count = x_end - x_start;
+
+        for (int y = y_start; y < y_end; y++)
+        {
+            unsigned char* out = dst + (size_t)y * stride + (size_t)x_start * channels;
+
+            // Homogeneous source position of the first pixel of the segment
+            double sx = m[0] * x_start + m[1] * y + m[2];
+            double sy = m[3] * x_start + m[4] * y + m[5];
+
+            if (affine)
+            {
+                warp_affine_segment(src, width, height, channels, sx, sy, m[0], m[3], count,
+                                    interpolation, fill, zero_fill, out);
+                continue;
+            }
+
+            double sw = m[6] * x_start + m[7] * y + m[8];
+            for (int x = 0; x < count; x++, sx += m[0], sy += m[3], sw += m[6], out += channels)
+            {
+                // Points behind the projection center have no source
+                if (sw <= 1e-12)
+                {
+                    if (fill)
+                    {
+                        memcpy(out, fill, channels);
+                    }
+                    else
+                    {
+                        memset(out, 0, channels);
+                    }
+                    continue;
+                }
+                sample_pixel(src, width, height, channels, sx / sw, sy / sw, interpolation, fill, out);
+            }
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * @brief Warps an image through an affine or perspective transform
+ * @param input_path Path to input image file
+ * @param output_path Path to save warped image
+ * @param matrix 3x3 row-major matrix mapping source pixel (x, y, 1) to the
+ *               destination (forward mapping, inverted internally). For an
+ *               affine transform the last row is 0 0 1.
+ * @param out_width Output width in pixels, 0 for the input width
+ * @param out_height Output height in pixels, 0 for the input height
+ * @param interpolation INTERP_NEAREST, INTERP_BILINEAR or INTERP_BICUBIC
+ * @return 0 on success, -1 on error
+ *
+ * @details Areas of the output without source data are black (transparent
+ *          for images with alpha). A chain of rotation, scaling, translation
+ *          and cropping can be given as one matrix and costs a single
+ *          resampling pass.
+ */
+int warp_image(char* input_path, char* output_path, const double* matrix,
+               int out_width, int out_height, int interpolation)
+{
+    if (interpolation < INTERP_NEAREST || interpolation > INTERP_BICUBIC)
+    {
+        printf("Error: Unknown interpolation mode!\n");
+        return -1;
+    }
+    if (out_width < 0 || out_height < 0)
+    {
+        printf("Error: Output size must not be negative!\n");
+        return -1;
+    }
+
+    double inverse[9];
+    if (invert_matrix3(matrix, inverse) != 0)
+    {
+        printf("Error: Transform matrix is singular!\n");
+        return -1;
+    }
+
+    // Load image
+    int width, height, channels;
+    unsigned char* image = load_image(input_path, &width, &height, &channels);
+    if (!image)
+    {
+        printf("Error loading image\n");
+        return -1;
+    }
+
+    if (out_width == 0) out_width = width;
+    if (out_height == 0) out_height = height;
+
+    unsigned char fill[4] = {0};
+    unsigned char* warped = warp_buffer(image, width, height, channels, inverse,
+                                        out_width, out_height, interpolation, fill);
+    free_image(image);
+    if (!warped)
+    {
+        printf("Error: Memory allocation failed!\n");
+        return -1;
+    }
+
+    // Save warped image
+    int res = save_image(output_path, out_width, out_height, channels, warped, 0);
+    free(warped);
+    return res;
+}